@@ -4,7 +4,9 @@
 
 #include <bench/bench.h>
 
+#include <crypto/aes.h>
 #include <crypto/sha256.h>
+#include <crypto/sha512.h>
 #include <key.h>
 #include <validation.h>
 #include <util.h>
@@ -55,6 +57,8 @@ int main(int argc, char** argv)
     }
 
     SHA256AutoDetect();
+    SHA512AutoDetect();
+    AESAutoDetect();
     RandomInit();
     ECC_Start();
     SetupEnvironment();
@@ -5,8 +5,10 @@
 #include <bench/bench.h>
 #include <coins.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <wallet/crypter.h>
 
+#include <algorithm>
 #include <vector>
 
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
@@ -85,3 +87,138 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+
+static const size_t NUM_CACHE_COINS = 10000;
+
+static std::vector<COutPoint> CacheOutpoints()
+{
+    FastRandomContext rng(true);
+    std::vector<COutPoint> outpoints;
+    for (size_t i = 0; i < NUM_CACHE_COINS; ++i) {
+        outpoints.emplace_back(rng.rand256(), rng.randrange(4));
+    }
+    return outpoints;
+}
+
+static Coin CacheCoin()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CTxOut out(50 * CENT, GetScriptForDestination(key.GetPubKey().GetID()));
+    return Coin(std::move(out), 1, false);
+}
+
+// Insert new coins into an empty cache, as connecting a block does.
+static void CCoinsCacheInsert(benchmark::State& state)
+{
+    const std::vector<COutPoint> outpoints = CacheOutpoints();
+    const Coin coin = CacheCoin();
+    CCoinsView base;
+    while (state.KeepRunning()) {
+        CCoinsViewCache cache(&base);
+        for (const COutPoint& outpoint : outpoints) {
+            cache.AddCoin(outpoint, Coin(coin), false);
+        }
+    }
+}
+
+// Look up cached coins in random order.
+static void CCoinsCacheLookup(benchmark::State& state)
+{
+    std::vector<COutPoint> outpoints = CacheOutpoints();
+    const Coin coin = CacheCoin();
+    CCoinsView base;
+    CCoinsViewCache cache(&base);
+    for (const COutPoint& outpoint : outpoints) {
+        cache.AddCoin(outpoint, Coin(coin), false);
+    }
+    std::shuffle(outpoints.begin(), outpoints.end(), FastRandomContext(true));
+    while (state.KeepRunning()) {
+        for (const COutPoint& outpoint : outpoints) {
+            bool found = cache.HaveCoinInCache(outpoint);
+            assert(found);
+        }
+    }
+}
+
+// Insert new coins into a child cache and flush them into its parent, as
+// a block's view is flushed into the tip cache.
+static void CCoinsCacheFlush(benchmark::State& state)
+{
+    const std::vector<COutPoint> outpoints = CacheOutpoints();
+    const Coin coin = CacheCoin();
+    CCoinsView base;
+    while (state.KeepRunning()) {
+        CCoinsViewCache parent(&base);
+        CCoinsViewCache child(&parent);
+        for (const COutPoint& outpoint : outpoints) {
+            child.AddCoin(outpoint, Coin(coin), false);
+        }
+        bool flushed = child.Flush();
+        assert(flushed);
+    }
+}
+
+// Read cached coins through a child cache, as the inputs of a block are
+// read from the tip cache.
+static void CCoinsCacheAccess(benchmark::State& state)
+{
+    std::vector<COutPoint> outpoints = CacheOutpoints();
+    const Coin coin = CacheCoin();
+    CCoinsView base;
+    CCoinsViewCache parent(&base);
+    for (const COutPoint& outpoint : outpoints) {
+        parent.AddCoin(outpoint, Coin(coin), false);
+    }
+    std::shuffle(outpoints.begin(), outpoints.end(), FastRandomContext(true));
+    while (state.KeepRunning()) {
+        CCoinsViewCache child(&parent);
+        for (const COutPoint& outpoint : outpoints) {
+            bool found = !child.AccessCoin(outpoint).IsSpent();
+            assert(found);
+        }
+    }
+}
+
+/** Base view that keeps (empty) rolling statistics, like the coins database. */
+class CCoinsViewBenchStats : public CCoinsView
+{
+public:
+    bool GetRollingStats(CRollingCoinsStats &stats) const override { stats = CRollingCoinsStats(); return true; }
+};
+
+// Make the coin changes of a block in a child cache and read back the rolling
+// statistics, as ConnectTip does before flushing: a fifth of the parent's
+// coins are spent, and as many new coins are created again, one in six of
+// which is spent within the same block.
+static void CCoinsCacheConnectBlock(benchmark::State& state)
+{
+    const std::vector<COutPoint> outpoints = CacheOutpoints();
+    std::vector<COutPoint> created = CacheOutpoints();
+    created.resize(NUM_CACHE_COINS / 5);
+    const Coin coin = CacheCoin();
+    CCoinsViewBenchStats base;
+    CCoinsViewCache parent(&base);
+    for (const COutPoint& outpoint : outpoints) {
+        parent.AddCoin(outpoint, Coin(coin), false);
+    }
+    while (state.KeepRunning()) {
+        CCoinsViewCache child(&parent);
+        for (size_t i = 0; i < created.size(); ++i) {
+            Coin spent;
+            bool found = child.SpendCoin(outpoints[i], &spent);
+            assert(found);
+            child.AddCoin(created[i], Coin(coin), false);
+            if (i % 6 == 5) child.SpendCoin(created[i - 1]);
+        }
+        CRollingCoinsStats stats;
+        bool have_stats = child.GetRollingStats(stats);
+        assert(have_stats);
+    }
+}
+
+BENCHMARK(CCoinsCacheInsert, 50);
+BENCHMARK(CCoinsCacheLookup, 100);
+BENCHMARK(CCoinsCacheFlush, 50);
+BENCHMARK(CCoinsCacheAccess, 50);
+BENCHMARK(CCoinsCacheConnectBlock, 50);
@@ -8,6 +8,7 @@
 #include <validation.h>
 #include <streams.h>
 #include <consensus/validation.h>
+#include <hash.h>
 
 namespace block_bench {
 #include <bench/data/block413567.raw.h>
@@ -52,5 +53,46 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
     }
 }
 
+static std::vector<CMutableTransaction> BenchBlockTransactions()
+{
+    CDataStream stream((const char*)block_bench::block413567,
+            (const char*)&block_bench::block413567[sizeof(block_bench::block413567)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+    std::vector<CMutableTransaction> txs;
+    for (const auto& tx : block.vtx) {
+        txs.emplace_back(*tx);
+    }
+    return txs;
+}
+
+// Compute the txid and wtxid of every transaction in a block, one transaction
+// at a time, as CTransaction's constructor does.
+static void BlockTransactionHashesSerial(benchmark::State& state)
+{
+    const std::vector<CMutableTransaction> txs = BenchBlockTransactions();
+    while (state.KeepRunning()) {
+        for (const auto& mtx : txs) {
+            uint256 txid = mtx.GetHash();
+            uint256 wtxid = SerializeHash(mtx, SER_GETHASH, 0);
+            assert(!txid.IsNull() && !wtxid.IsNull());
+        }
+    }
+}
+
+// Same, but with all messages of the block handed to the multi-buffer engine.
+static void BlockTransactionHashesBatch(benchmark::State& state)
+{
+    const std::vector<CMutableTransaction> txs = BenchBlockTransactions();
+    std::vector<uint256> txids, wtxids;
+    while (state.KeepRunning()) {
+        ComputeTransactionHashes(txs, txids, wtxids);
+        assert(txids.size() == txs.size());
+    }
+}
+
 BENCHMARK(DeserializeBlockTest, 130);
 BENCHMARK(DeserializeAndCheckBlockTest, 160);
+BENCHMARK(BlockTransactionHashesSerial, 160);
+BENCHMARK(BlockTransactionHashesBatch, 160);
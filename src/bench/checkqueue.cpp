@@ -6,6 +6,7 @@
 #include <util.h>
 #include <validation.h>
 #include <checkqueue.h>
+#include <crypto/sha256.h>
 #include <prevector.h>
 #include <vector>
 #include <boost/thread/thread.hpp>
@@ -60,3 +61,54 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.join_all();
 }
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+
+// Scaling of the queue with the number of worker threads, on checks that each
+// do a few microseconds of hashing (a fraction of a signature check, so that
+// queue overhead still shows). With more threads than cores this measures the
+// cost of oversubscription instead.
+static void CCheckQueueScaling(benchmark::State& state, int threads)
+{
+    struct HashJob {
+        unsigned char data[64] = {0};
+        bool operator()()
+        {
+            for (int i = 0; i < 16; ++i) {
+                CSHA256().Write(data, sizeof(data)).Finalize(data);
+            }
+            return true;
+        }
+        void swap(HashJob& x) { std::swap(data, x.data); }
+    };
+    CCheckQueue<HashJob> queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    // The master joins in on Wait(), so it counts as one of the threads.
+    for (auto x = 0; x < threads - 1; ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<HashJob> control(&queue);
+        for (size_t b = 0; b < BATCHES; ++b) {
+            std::vector<HashJob> vChecks(BATCH_SIZE);
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+static void CCheckQueueScaling1Thread(benchmark::State& state) { CCheckQueueScaling(state, 1); }
+static void CCheckQueueScaling2Threads(benchmark::State& state) { CCheckQueueScaling(state, 2); }
+static void CCheckQueueScaling4Threads(benchmark::State& state) { CCheckQueueScaling(state, 4); }
+static void CCheckQueueScaling8Threads(benchmark::State& state) { CCheckQueueScaling(state, 8); }
+static void CCheckQueueScaling16Threads(benchmark::State& state) { CCheckQueueScaling(state, 16); }
+static void CCheckQueueScaling32Threads(benchmark::State& state) { CCheckQueueScaling(state, 32); }
+static void CCheckQueueScaling64Threads(benchmark::State& state) { CCheckQueueScaling(state, 64); }
+
+BENCHMARK(CCheckQueueScaling1Thread, 20);
+BENCHMARK(CCheckQueueScaling2Threads, 20);
+BENCHMARK(CCheckQueueScaling4Threads, 20);
+BENCHMARK(CCheckQueueScaling8Threads, 20);
+BENCHMARK(CCheckQueueScaling16Threads, 20);
+BENCHMARK(CCheckQueueScaling32Threads, 20);
+BENCHMARK(CCheckQueueScaling64Threads, 20);
@@ -0,0 +1,69 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <fs.h>
+#include <random.h>
+#include <txdb.h>
+#include <util.h>
+
+#include <memory>
+
+static const int NUM_FLUSH_COINS = 50000;
+
+/** A coins database in a temporary data directory, and a map of dirty coins to flush into it. */
+class CoinsDBFixture
+{
+public:
+    fs::path m_path;
+    std::unique_ptr<CCoinsViewDB> m_db;
+    CCoinsMap m_coins;
+
+    explicit CoinsDBFixture(size_t shards)
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        m_path = fs::temp_directory_path() / strprintf("bench_bitcoin_%lu_%i", (unsigned long)GetTime(), (int)GetRand(1 << 30));
+        fs::create_directories(m_path);
+        gArgs.ForceSetArg("-datadir", m_path.string());
+        ClearDatadirCache();
+        m_db.reset(new CCoinsViewDB(8 << 20, false, true));
+        bool ok = m_db->Reshard(shards);
+        assert(ok);
+
+        FastRandomContext rng(true);
+        const CScript script = CScript() << OP_DUP << OP_HASH160 << rng.randbytes(20) << OP_EQUALVERIFY << OP_CHECKSIG;
+        for (int i = 0; i < NUM_FLUSH_COINS; ++i) {
+            CCoinsCacheEntry& entry = m_coins.try_emplace(COutPoint(rng.rand256(), rng.randrange(4))).first->second;
+            entry.coin = Coin(CTxOut(rng.randrange(50 * COIN), script), 1, false);
+            entry.flags = CCoinsCacheEntry::DIRTY;
+        }
+    }
+
+    ~CoinsDBFixture()
+    {
+        m_db.reset();
+        gArgs.ForceSetArg("-datadir", "");
+        ClearDatadirCache();
+        fs::remove_all(m_path);
+    }
+};
+
+// Write a flush of new coins to the chainstate database. CCoinsViewDB leaves
+// the map in place, so each run writes the same coins again.
+static void CoinsDBFlush(benchmark::State& state, size_t shards)
+{
+    CoinsDBFixture fixture(shards);
+    while (state.KeepRunning()) {
+        bool ok = fixture.m_db->BatchWrite(fixture.m_coins, GetRandHash(), CRollingCoinsStats());
+        assert(ok);
+    }
+}
+
+static void CoinsDBFlushUnsharded(benchmark::State& state) { CoinsDBFlush(state, 1); }
+static void CoinsDBFlush4Shards(benchmark::State& state) { CoinsDBFlush(state, 4); }
+
+BENCHMARK(CoinsDBFlushUnsharded, 2);
+BENCHMARK(CoinsDBFlush4Shards, 2);
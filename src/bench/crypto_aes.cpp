@@ -0,0 +1,61 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <crypto/aes.h>
+
+#include <vector>
+
+/* Number of keys unlocked per iteration, each a 32-byte secret padded to 48 bytes as in the wallet */
+static const size_t UNLOCK_KEYS = 1000;
+static const int CRYPTED_KEY_SIZE = 48;
+
+/* Decrypt every key with its own AES256CBCDecrypt, as CCrypter does per key. */
+static void AES256CBCUnlockKeys(benchmark::State& state)
+{
+    std::vector<unsigned char> master(AES256_KEYSIZE, 0x11);
+    std::vector<unsigned char> ivs(UNLOCK_KEYS * AES_BLOCKSIZE, 0x22);
+    std::vector<unsigned char> in(UNLOCK_KEYS * CRYPTED_KEY_SIZE, 0x33);
+    std::vector<unsigned char> out(UNLOCK_KEYS * CRYPTED_KEY_SIZE);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < UNLOCK_KEYS; i++) {
+            AES256CBCDecrypt dec(master.data(), &ivs[i * AES_BLOCKSIZE], true);
+            dec.Decrypt(&in[i * CRYPTED_KEY_SIZE], CRYPTED_KEY_SIZE, &out[i * CRYPTED_KEY_SIZE]);
+        }
+    }
+}
+
+/* Decrypt all keys through one AES256CBCBatchDecrypt, as CCryptoKeyStore::Unlock does. */
+static void AES256CBCUnlockKeysBatch(benchmark::State& state)
+{
+    std::vector<unsigned char> master(AES256_KEYSIZE, 0x11);
+    std::vector<unsigned char> ivs(UNLOCK_KEYS * AES_BLOCKSIZE, 0x22);
+    std::vector<unsigned char> in(UNLOCK_KEYS * CRYPTED_KEY_SIZE, 0x33);
+    std::vector<unsigned char> out(UNLOCK_KEYS * CRYPTED_KEY_SIZE);
+    std::vector<AESCBCMessage> msgs(UNLOCK_KEYS);
+    for (size_t i = 0; i < UNLOCK_KEYS; i++) {
+        msgs[i] = {&ivs[i * AES_BLOCKSIZE], &in[i * CRYPTED_KEY_SIZE], CRYPTED_KEY_SIZE, &out[i * CRYPTED_KEY_SIZE], 0};
+    }
+    while (state.KeepRunning()) {
+        AES256CBCBatchDecrypt(master.data(), true).Decrypt(msgs);
+    }
+}
+
+/* Run an AES benchmark with AES-NI disabled or (where available) enabled. */
+static void AESUsing(benchmark::State& state, bool use_aesni, void (*bench)(benchmark::State&))
+{
+    AESAutoDetect(use_aesni);
+    bench(state);
+    AESAutoDetect();
+}
+
+static void AES256CBCUnlockKeys_CTAES(benchmark::State& state) { AESUsing(state, false, AES256CBCUnlockKeys); }
+static void AES256CBCUnlockKeys_AESNI(benchmark::State& state) { AESUsing(state, true, AES256CBCUnlockKeys); }
+static void AES256CBCUnlockKeysBatch_CTAES(benchmark::State& state) { AESUsing(state, false, AES256CBCUnlockKeysBatch); }
+static void AES256CBCUnlockKeysBatch_AESNI(benchmark::State& state) { AESUsing(state, true, AES256CBCUnlockKeysBatch); }
+
+BENCHMARK(AES256CBCUnlockKeys_CTAES, 20);
+BENCHMARK(AES256CBCUnlockKeys_AESNI, 200);
+BENCHMARK(AES256CBCUnlockKeysBatch_CTAES, 20);
+BENCHMARK(AES256CBCUnlockKeysBatch_AESNI, 500);
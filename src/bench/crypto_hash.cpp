@@ -42,6 +42,19 @@ static void SHA256(benchmark::State& state)
         CSHA256().Write(in.data(), in.size()).Finalize(hash);
 }
 
+/* Run a hashing benchmark with SHA256AutoDetect() restricted to the given backends.
+ * On CPUs lacking a backend this measures the best remaining one. */
+static void SHA256Using(benchmark::State& state, sha256_implementation::UseImplementation use, void (*bench)(benchmark::State&))
+{
+    SHA256AutoDetect(use);
+    bench(state);
+    SHA256AutoDetect();
+}
+
+static void SHA256_STANDARD(benchmark::State& state) { SHA256Using(state, sha256_implementation::STANDARD, SHA256); }
+static void SHA256_SSE4(benchmark::State& state) { SHA256Using(state, sha256_implementation::USE_SSE4, SHA256); }
+static void SHA256_SHANI(benchmark::State& state) { SHA256Using(state, sha256_implementation::USE_SHANI, SHA256); }
+
 static void SHA256_32b(benchmark::State& state)
 {
     std::vector<uint8_t> in(32,0);
@@ -52,6 +65,19 @@ static void SHA256_32b(benchmark::State& state)
     }
 }
 
+static void SHA256D64_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64 * 1024, 0);
+    while (state.KeepRunning()) {
+        SHA256D64(in.data(), in.data(), 1024);
+    }
+}
+
+static void SHA256D64_1024_STANDARD(benchmark::State& state) { SHA256Using(state, sha256_implementation::STANDARD, SHA256D64_1024); }
+static void SHA256D64_1024_SSE4(benchmark::State& state) { SHA256Using(state, sha256_implementation::USE_SSE4, SHA256D64_1024); }
+static void SHA256D64_1024_AVX2(benchmark::State& state) { SHA256Using(state, sha256_implementation::USE_SSE4_AND_AVX2, SHA256D64_1024); }
+static void SHA256D64_1024_SHANI(benchmark::State& state) { SHA256Using(state, sha256_implementation::USE_SSE4_AND_SHANI, SHA256D64_1024); }
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -60,6 +86,42 @@ static void SHA512(benchmark::State& state)
         CSHA512().Write(in.data(), in.size()).Finalize(hash);
 }
 
+/* Child derivations hashed per iteration in the BIP32 benchmarks */
+static const unsigned int BIP32_CHILDREN = 1000;
+
+static void BIP32Hash_1000(benchmark::State& state)
+{
+    ChainCode cc;
+    unsigned char data[32] = {0};
+    std::vector<uint8_t> out(64 * BIP32_CHILDREN);
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < BIP32_CHILDREN; i++) {
+            BIP32Hash(cc, 0x80000000 + i, 0, data, &out[64 * i]);
+        }
+    }
+}
+
+static void BIP32HashMulti_1000(benchmark::State& state)
+{
+    ChainCode cc;
+    unsigned char data[32] = {0};
+    std::vector<uint8_t> out(64 * BIP32_CHILDREN);
+    while (state.KeepRunning()) {
+        BIP32HashMulti(cc, 0x80000000, BIP32_CHILDREN, 0, data, out.data());
+    }
+}
+
+/* Run a benchmark with SHA512AutoDetect() restricted to the scalar or (where available) the AVX2 backend. */
+static void SHA512Using(benchmark::State& state, bool use_avx2, void (*bench)(benchmark::State&))
+{
+    SHA512AutoDetect(use_avx2);
+    bench(state);
+    SHA512AutoDetect();
+}
+
+static void BIP32HashMulti_1000_STANDARD(benchmark::State& state) { SHA512Using(state, false, BIP32HashMulti_1000); }
+static void BIP32HashMulti_1000_AVX2(benchmark::State& state) { SHA512Using(state, true, BIP32HashMulti_1000); }
+
 static void SipHash_32b(benchmark::State& state)
 {
     uint256 x;
@@ -90,9 +152,20 @@ static void FastRandom_1bit(benchmark::State& state)
 BENCHMARK(RIPEMD160, 440);
 BENCHMARK(SHA1, 570);
 BENCHMARK(SHA256, 340);
+BENCHMARK(SHA256_STANDARD, 340);
+BENCHMARK(SHA256_SSE4, 340);
+BENCHMARK(SHA256_SHANI, 340);
 BENCHMARK(SHA512, 330);
+BENCHMARK(BIP32Hash_1000, 150);
+BENCHMARK(BIP32HashMulti_1000_STANDARD, 150);
+BENCHMARK(BIP32HashMulti_1000_AVX2, 150);
 
 BENCHMARK(SHA256_32b, 4700 * 1000);
+BENCHMARK(SHA256D64_1024, 7400);
+BENCHMARK(SHA256D64_1024_STANDARD, 7400);
+BENCHMARK(SHA256D64_1024_SSE4, 7400);
+BENCHMARK(SHA256D64_1024_AVX2, 7400);
+BENCHMARK(SHA256D64_1024_SHANI, 7400);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
@@ -0,0 +1,97 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <fs.h>
+#include <pow.h>
+#include <random.h>
+#include <txdb.h>
+#include <util.h>
+
+#include <memory>
+
+static const int NUM_HEADERS = 20000;
+
+/** A block tree database in a temporary data directory, holding a chain of NUM_HEADERS regtest headers. */
+class BlockTreeFixture
+{
+public:
+    fs::path m_path;
+    std::unique_ptr<CBlockTreeDB> m_db;
+    std::vector<std::unique_ptr<CBlockIndex>> m_index;
+    std::vector<uint256> m_hashes;
+
+    BlockTreeFixture()
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        m_path = fs::temp_directory_path() / strprintf("bench_bitcoin_%lu_%i", (unsigned long)GetTime(), (int)GetRand(1 << 30));
+        fs::create_directories(m_path);
+        gArgs.ForceSetArg("-datadir", m_path.string());
+        ClearDatadirCache();
+        fs::create_directories(GetBlocksDir());
+        m_db.reset(new CBlockTreeDB(1 << 20, false, true));
+
+        const Consensus::Params& params = Params().GetConsensus();
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.nTime = 1500000000;
+        header.nBits = UintToArith256(params.powLimit).GetCompact();
+        m_hashes.reserve(NUM_HEADERS);
+        for (int i = 0; i < NUM_HEADERS; ++i) {
+            header.hashPrevBlock = i > 0 ? m_hashes.back() : uint256();
+            header.hashMerkleRoot = GetRandHash();
+            header.nTime++;
+            while (!CheckProofOfWork(header.GetHash(), header.nBits, params)) ++header.nNonce;
+            m_hashes.push_back(header.GetHash());
+            m_index.emplace_back(new CBlockIndex(header));
+            CBlockIndex* pindex = m_index.back().get();
+            pindex->phashBlock = &m_hashes.back();
+            pindex->pprev = i > 0 ? m_index[i - 1].get() : nullptr;
+            pindex->nHeight = i;
+            pindex->nStatus = BLOCK_VALID_TREE;
+        }
+
+        // Start the headers file, then append the entries as a flush would.
+        std::vector<std::pair<uint256, CDiskBlockIndex>> entries;
+        m_db->LoadBlockIndexGuts(params, entries, 1);
+        std::vector<CBlockIndex*> vBlocks;
+        for (const auto& pindex : m_index) vBlocks.push_back(pindex.get());
+        m_db->WriteBatchSync({}, 0, vBlocks);
+    }
+
+    ~BlockTreeFixture()
+    {
+        m_db.reset();
+        gArgs.ForceSetArg("-datadir", "");
+        ClearDatadirCache();
+        fs::remove_all(m_path);
+    }
+};
+
+// Startup read of the block index from its LevelDB database, as LoadBlockIndexDB did.
+static void LoadBlockIndexFromDatabase(benchmark::State& state)
+{
+    BlockTreeFixture fixture;
+    while (state.KeepRunning()) {
+        std::vector<std::pair<uint256, CDiskBlockIndex>> entries;
+        bool ok = fixture.m_db->ReadBlockIndexDB(Params().GetConsensus(), entries, 1);
+        assert(ok && entries.size() == NUM_HEADERS);
+    }
+}
+
+// The same entries read from the flat headers file.
+static void LoadBlockIndexFromHeadersFile(benchmark::State& state)
+{
+    BlockTreeFixture fixture;
+    while (state.KeepRunning()) {
+        std::vector<std::pair<uint256, CDiskBlockIndex>> entries;
+        bool ok = fixture.m_db->ReadHeadersFile(Params().GetConsensus(), entries, 1);
+        assert(ok && entries.size() == NUM_HEADERS);
+    }
+}
+
+BENCHMARK(LoadBlockIndexFromDatabase, 5);
+BENCHMARK(LoadBlockIndexFromHeadersFile, 5);
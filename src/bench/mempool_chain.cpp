@@ -0,0 +1,68 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <policy/policy.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <vector>
+
+static void AddTx(const CTransactionRef& tx, CTxMemPool& pool)
+{
+    LockPoints lp;
+    pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(tx, 1000LL, 0, 1, false, 4, lp));
+}
+
+//! A chain of transactions, each spending the only output of the one before.
+static std::vector<CTransactionRef> CreateChain(size_t length)
+{
+    std::vector<CTransactionRef> chain;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx.vout[0].nValue = 10 * COIN;
+    for (size_t i = 0; i < length; ++i) {
+        chain.push_back(MakeTransactionRef(tx));
+        tx.vin[0].prevout = COutPoint(chain.back()->GetHash(), 0);
+        tx.vout[0].nValue -= 1000;
+    }
+    return chain;
+}
+
+// Add a chain of 25 transactions, the default ancestor limit, so that every
+// addition walks all ancestors; then evict it from the root.
+static void MempoolChain25(benchmark::State& state)
+{
+    const std::vector<CTransactionRef> chain = CreateChain(DEFAULT_ANCESTOR_LIMIT);
+    CTxMemPool pool;
+    while (state.KeepRunning()) {
+        for (const CTransactionRef& tx : chain) {
+            AddTx(tx, pool);
+        }
+        pool.removeRecursive(*chain.front());
+    }
+}
+
+// Confirm the same chain one transaction per block, so that each removal
+// updates the ancestor state of all remaining descendants.
+static void MempoolChain25Blocks(benchmark::State& state)
+{
+    const std::vector<CTransactionRef> chain = CreateChain(DEFAULT_ANCESTOR_LIMIT);
+    CTxMemPool pool;
+    unsigned int height = 1;
+    while (state.KeepRunning()) {
+        for (const CTransactionRef& tx : chain) {
+            AddTx(tx, pool);
+        }
+        for (const CTransactionRef& tx : chain) {
+            pool.removeForBlock({tx}, height++);
+        }
+    }
+}
+
+BENCHMARK(MempoolChain25, 1000);
+BENCHMARK(MempoolChain25Blocks, 1000);
@@ -130,4 +130,78 @@ static void MempoolEviction(benchmark::State& state)
     }
 }
 
+// Evict a package whose root has many descendants, so that trimming is
+// dominated by walking the descendant graph rather than by the index updates.
+static void MempoolEvictionDescendants(benchmark::State& state)
+{
+    const size_t width = 50;
+
+    CMutableTransaction root;
+    root.vin.resize(1);
+    root.vin[0].scriptSig = CScript() << OP_1;
+    root.vout.resize(width);
+    for (CTxOut& out : root.vout) {
+        out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        out.nValue = COIN;
+    }
+
+    std::vector<CTransactionRef> txs;
+    txs.push_back(MakeTransactionRef(root));
+    for (size_t i = 0; i < width; ++i) {
+        CMutableTransaction child;
+        child.vin.resize(1);
+        child.vin[0].prevout = COutPoint(txs.front()->GetHash(), i);
+        child.vin[0].scriptSig = CScript() << OP_2;
+        child.vout.resize(1);
+        child.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+        child.vout[0].nValue = COIN / 2;
+        txs.push_back(MakeTransactionRef(child));
+
+        CMutableTransaction grandchild;
+        grandchild.vin.resize(1);
+        grandchild.vin[0].prevout = COutPoint(txs.back()->GetHash(), 0);
+        grandchild.vin[0].scriptSig = CScript() << OP_3;
+        grandchild.vout.resize(1);
+        grandchild.vout[0].scriptPubKey = CScript() << OP_3 << OP_EQUAL;
+        grandchild.vout[0].nValue = COIN / 4;
+        txs.push_back(MakeTransactionRef(grandchild));
+    }
+
+    CTxMemPool pool;
+    while (state.KeepRunning()) {
+        for (const CTransactionRef& tx : txs) {
+            AddTx(tx, 1000LL, pool);
+        }
+        pool.TrimToSize(0);
+    }
+}
+
+// Fill a mempool with independent transactions, then trim it to half its memory usage.
+static void MempoolFillAndTrim(benchmark::State& state)
+{
+    std::vector<CTransactionRef> txs;
+    for (uint32_t i = 0; i < 5000; ++i) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(uint256(), i);
+        tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 1) << std::vector<unsigned char>(33, 2);
+        tx.vout.resize(2);
+        for (CTxOut& out : tx.vout) {
+            out.scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i & 0xff) << OP_EQUALVERIFY << OP_CHECKSIG;
+            out.nValue = COIN;
+        }
+        txs.push_back(MakeTransactionRef(tx));
+    }
+
+    while (state.KeepRunning()) {
+        CTxMemPool pool;
+        for (size_t i = 0; i < txs.size(); ++i) {
+            AddTx(txs[i], 1000 + (i * 7919) % 5000, pool);
+        }
+        pool.TrimToSize(pool.DynamicMemoryUsage() / 2);
+    }
+}
+
 BENCHMARK(MempoolEviction, 41000);
+BENCHMARK(MempoolEvictionDescendants, 200);
+BENCHMARK(MempoolFillAndTrim, 10);
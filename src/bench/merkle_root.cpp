@@ -0,0 +1,32 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <uint256.h>
+#include <random.h>
+#include <consensus/merkle.h>
+
+static void MerkleRoot(benchmark::State& state, size_t num_leaves)
+{
+    FastRandomContext rng(true);
+    std::vector<uint256> leaves;
+    leaves.resize(num_leaves);
+    for (auto& item : leaves) {
+        item = rng.rand256();
+    }
+    while (state.KeepRunning()) {
+        bool mutation = false;
+        uint256 hash = ComputeMerkleRoot(std::vector<uint256>(leaves), &mutation);
+        leaves[mutation] = hash;
+    }
+}
+
+static void MerkleRoot1000(benchmark::State& state) { MerkleRoot(state, 1000); }
+static void MerkleRoot4000(benchmark::State& state) { MerkleRoot(state, 4000); }
+static void MerkleRoot10000(benchmark::State& state) { MerkleRoot(state, 10000); }
+
+BENCHMARK(MerkleRoot1000, 900);
+BENCHMARK(MerkleRoot4000, 225);
+BENCHMARK(MerkleRoot10000, 90);
@@ -8,6 +8,7 @@
 #include <script/bitcoinconsensus.h>
 #endif
 #include <script/script.h>
+#include <script/sigcache.h>
 #include <script/sign.h>
 #include <streams.h>
 
@@ -105,4 +106,114 @@ static void VerifyScriptBench(benchmark::State& state)
     }
 }
 
+// Build a transaction spending 2000 P2PKH outputs to a single output, with
+// every input signed SIGHASH_ALL. Its legacy signature hashes are what makes
+// the verification cost of such a transaction grow quadratically.
+static CMutableTransaction BuildLargeP2PKHSpend(CMutableTransaction& txCredit)
+{
+    static const int N_INPUTS = 2000;
+
+    CKey key;
+    static const std::array<unsigned char, 32> vchKey = {
+        {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1
+        }
+    };
+    key.Set(vchKey.begin(), vchKey.end(), true);
+    CPubKey pubkey = key.GetPubKey();
+    CScript scriptPubKey = CScript() << OP_DUP << OP_HASH160 << ToByteVector(pubkey.GetID()) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    txCredit = BuildCreditingTransaction(scriptPubKey);
+    txCredit.vout.assign(N_INPUTS, txCredit.vout[0]);
+
+    CMutableTransaction txSpend = BuildSpendingTransaction(CScript(), txCredit);
+    txSpend.vin.resize(N_INPUTS, txSpend.vin[0]);
+    for (int i = 0; i < N_INPUTS; i++) {
+        txSpend.vin[i].prevout.n = i;
+    }
+    txSpend.vout[0].nValue = N_INPUTS;
+
+    // scriptSigs are blanked in the signature hash, so one cache serves all inputs
+    PrecomputedTransactionData txdata(txSpend);
+    for (int i = 0; i < N_INPUTS; i++) {
+        std::vector<unsigned char> vchSig;
+        key.Sign(SignatureHash(scriptPubKey, txSpend, i, SIGHASH_ALL, 0, SigVersion::BASE, &txdata), vchSig);
+        vchSig.push_back(static_cast<unsigned char>(SIGHASH_ALL));
+        txSpend.vin[i].scriptSig = CScript() << vchSig << ToByteVector(pubkey);
+    }
+    return txSpend;
+}
+
+// Legacy signature hashes of all inputs of a 2000-input transaction, once
+// serializing the whole transaction per input and once through the
+// PrecomputedTransactionData cache (including building it).
+static void LegacySighashLarge(benchmark::State& state, bool use_cache)
+{
+    CMutableTransaction txCredit;
+    const CTransaction tx(BuildLargeP2PKHSpend(txCredit));
+    const CScript& scriptCode = txCredit.vout[0].scriptPubKey;
+
+    while (state.KeepRunning()) {
+        PrecomputedTransactionData txdata(tx);
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            uint256 hash = SignatureHash(scriptCode, tx, i, SIGHASH_ALL, 0, SigVersion::BASE, use_cache ? &txdata : nullptr);
+            assert(!hash.IsNull());
+        }
+    }
+}
+
+// PrecomputedTransactionData of the 2000-input transaction when no script is
+// run, as in ConnectBlock below the assumevalid block.
+static void PrecomputeTxData2000P2PKH(benchmark::State& state)
+{
+    CMutableTransaction txCredit;
+    const CTransaction tx(BuildLargeP2PKHSpend(txCredit));
+
+    while (state.KeepRunning()) {
+        PrecomputedTransactionData txdata(tx);
+        assert(!txdata.ready);
+    }
+}
+
+static void LegacySighash2000P2PKH(benchmark::State& state) { LegacySighashLarge(state, true); }
+static void LegacySighash2000P2PKHNoCache(benchmark::State& state) { LegacySighashLarge(state, false); }
+
+// Full script verification of all inputs of the 2000-input transaction, whose
+// inputs all reuse one key. With the caching checker (as used by ConnectBlock)
+// the key is parsed once; the signature cache itself is bypassed as nothing is
+// stored in it.
+static void VerifyScript2000P2PKHChecker(benchmark::State& state, bool caching)
+{
+    const int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC | SCRIPT_VERIFY_DERSIG;
+    CMutableTransaction txCredit;
+    const CTransaction tx(BuildLargeP2PKHSpend(txCredit));
+    static bool sigcache_ready = (InitSignatureCache(), true);
+    (void)sigcache_ready;
+
+    while (state.KeepRunning()) {
+        PrecomputedTransactionData txdata(tx);
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            ScriptError err;
+            bool success;
+            if (caching) {
+                success = VerifyScript(tx.vin[i].scriptSig, txCredit.vout[i].scriptPubKey, &tx.vin[i].scriptWitness, flags,
+                    CachingTransactionSignatureChecker(&tx, i, txCredit.vout[i].nValue, false, txdata), &err);
+            } else {
+                success = VerifyScript(tx.vin[i].scriptSig, txCredit.vout[i].scriptPubKey, &tx.vin[i].scriptWitness, flags,
+                    TransactionSignatureChecker(&tx, i, txCredit.vout[i].nValue, txdata), &err);
+            }
+            assert(err == SCRIPT_ERR_OK);
+            assert(success);
+        }
+    }
+}
+
+static void VerifyScript2000P2PKH(benchmark::State& state) { VerifyScript2000P2PKHChecker(state, false); }
+static void VerifyScript2000P2PKHPubKeyCache(benchmark::State& state) { VerifyScript2000P2PKHChecker(state, true); }
+
 BENCHMARK(VerifyScriptBench, 6300);
+BENCHMARK(LegacySighash2000P2PKH, 2);
+BENCHMARK(LegacySighash2000P2PKHNoCache, 2);
+BENCHMARK(PrecomputeTxData2000P2PKH, 200);
+BENCHMARK(VerifyScript2000P2PKH, 1);
+BENCHMARK(VerifyScript2000P2PKHPubKeyCache, 1);
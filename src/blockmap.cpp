@@ -0,0 +1,92 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockmap.h>
+
+#include <memusage.h>
+
+#include <assert.h>
+#include <limits>
+#include <new>
+
+/** Tables are kept at most 3/4 full. */
+static size_t TableSizeFor(size_t n)
+{
+    size_t size = 16;
+    while (size * 3 < n * 4) size *= 2;
+    return size;
+}
+
+size_t BlockMap::FindSlot(const uint256& hash) const
+{
+    const size_t mask = m_table.size() - 1;
+    // Block hashes are uniformly distributed outside the leading zeros,
+    // which GetCheapHash does not read.
+    size_t slot = hash.GetCheapHash() & mask;
+    while (m_table[slot] != 0 && Pair(m_table[slot] - 1).first != hash) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void BlockMap::Rehash(size_t table_size)
+{
+    m_table.assign(table_size, 0);
+    for (uint32_t n = 0; n < m_size; ++n) {
+        m_table[FindSlot(Pair(n).first)] = n + 1;
+    }
+}
+
+BlockMap::iterator BlockMap::find(const uint256& hash)
+{
+    if (m_size == 0) return end();
+    const uint32_t n = m_table[FindSlot(hash)];
+    return n == 0 ? end() : iterator(this, n - 1);
+}
+
+BlockMap::const_iterator BlockMap::find(const uint256& hash) const
+{
+    return const_cast<BlockMap*>(this)->find(hash);
+}
+
+std::pair<BlockMap::iterator, bool> BlockMap::emplace(const uint256& hash, CBlockIndex* pindex)
+{
+    if (m_table.size() * 3 < (size_t(m_size) + 1) * 4) {
+        Rehash(TableSizeFor(size_t(m_size) + 1));
+    }
+    const size_t slot = FindSlot(hash);
+    if (m_table[slot] != 0) {
+        return std::make_pair(iterator(this, m_table[slot] - 1), false);
+    }
+
+    assert(m_size < std::numeric_limits<uint32_t>::max());
+    if (m_size == m_chunks.size() * CHUNK_SIZE) {
+        m_chunks.emplace_back(new Slot[CHUNK_SIZE]);
+    }
+    const uint32_t n = m_size++;
+    new (&m_chunks[n / CHUNK_SIZE][n % CHUNK_SIZE]) value_type(hash, pindex);
+    m_table[slot] = n + 1;
+    return std::make_pair(iterator(this, n), true);
+}
+
+void BlockMap::reserve(size_t n)
+{
+    if (m_table.size() * 3 < n * 4) {
+        Rehash(TableSizeFor(n));
+    }
+    m_chunks.reserve((n + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+void BlockMap::clear()
+{
+    m_chunks.clear();
+    m_table.clear();
+    m_size = 0;
+}
+
+size_t BlockMap::DynamicMemoryUsage() const
+{
+    return memusage::MallocUsage(sizeof(Slot) * CHUNK_SIZE) * m_chunks.size() +
+           memusage::DynamicUsage(m_chunks) + memusage::DynamicUsage(m_table);
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKMAP_H
+#define BITCOIN_BLOCKMAP_H
+
+#include <uint256.h>
+
+#include <iterator>
+#include <memory>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class CBlockIndex;
+
+/**
+ * Map from block hash to block index entry, with the interface of the
+ * std::unordered_map it replaces for mapBlockIndex, but a compact layout.
+ *
+ * The (hash, entry) pairs are kept in insertion order in fixed-size chunks,
+ * so they are never moved and CBlockIndex::phashBlock can point at the key.
+ * Lookups go through an open-addressing table of 32-bit pair numbers with
+ * linear probing. A node-based map spends a heap allocation, a next pointer
+ * and a bucket slot on every entry; here the overhead is the table alone.
+ *
+ * Pairs cannot be removed, which mapBlockIndex never needs. Iteration is in
+ * insertion order.
+ */
+class BlockMap
+{
+public:
+    typedef uint256 key_type;
+    typedef CBlockIndex* mapped_type;
+    typedef std::pair<const uint256, CBlockIndex*> value_type;
+
+private:
+    static_assert(std::is_trivially_destructible<value_type>::value, "pairs are not destroyed individually");
+    static const uint32_t CHUNK_SIZE = 1024;
+    typedef std::aligned_storage<sizeof(value_type), alignof(value_type)>::type Slot;
+
+    std::vector<std::unique_ptr<Slot[]>> m_chunks;
+    //! Pair number + 1 per slot, 0 when empty. Its size is a power of two.
+    std::vector<uint32_t> m_table;
+    uint32_t m_size = 0;
+
+    value_type& Pair(uint32_t n) const { return *reinterpret_cast<value_type*>(&m_chunks[n / CHUNK_SIZE][n % CHUNK_SIZE]); }
+    //! The table slot holding hash, or the empty slot where it would go
+    size_t FindSlot(const uint256& hash) const;
+    void Rehash(size_t table_size);
+
+    template <typename Value>
+    class Iterator
+    {
+        friend class BlockMap;
+        const BlockMap* m_map;
+        uint32_t m_pos;
+        Iterator(const BlockMap* map, uint32_t pos) : m_map(map), m_pos(pos) {}
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef BlockMap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Value* pointer;
+        typedef Value& reference;
+
+        Iterator() : m_map(nullptr), m_pos(0) {}
+        //! iterator converts to const_iterator
+        template <typename Other, typename = typename std::enable_if<std::is_convertible<Other*, Value*>::value>::type>
+        Iterator(const Iterator<Other>& other) : m_map(other.m_map), m_pos(other.m_pos) {}
+
+        reference operator*() const { return m_map->Pair(m_pos); }
+        pointer operator->() const { return &m_map->Pair(m_pos); }
+        Iterator& operator++() { ++m_pos; return *this; }
+        Iterator operator++(int) { Iterator ret = *this; ++m_pos; return ret; }
+        template <typename Other>
+        bool operator==(const Iterator<Other>& other) const { return m_pos == other.m_pos; }
+        template <typename Other>
+        bool operator!=(const Iterator<Other>& other) const { return m_pos != other.m_pos; }
+
+        template <typename Other> friend class Iterator;
+    };
+
+public:
+    typedef Iterator<value_type> iterator;
+    typedef Iterator<const value_type> const_iterator;
+
+    BlockMap() {}
+    BlockMap(const BlockMap&) = delete;
+    BlockMap& operator=(const BlockMap&) = delete;
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_size); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_size); }
+
+    iterator find(const uint256& hash);
+    const_iterator find(const uint256& hash) const;
+    size_t count(const uint256& hash) const { return find(hash) != end(); }
+
+    //! Insert a pair unless hash is already present; like std::unordered_map::emplace.
+    std::pair<iterator, bool> emplace(const uint256& hash, CBlockIndex* pindex);
+    template <typename P>
+    std::pair<iterator, bool> insert(const P& value) { return emplace(value.first, value.second); }
+
+    //! Make room for n pairs in total without rehashing.
+    void reserve(size_t n);
+    void clear();
+
+    size_t DynamicMemoryUsage() const;
+};
+
+#endif // BITCOIN_BLOCKMAP_H
@@ -118,6 +118,13 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
+void CBlockIndex::BuildSkip(const CChain& chain)
+{
+    assert(chain[nHeight] == this);
+    if (pprev)
+        pskip = chain[GetSkipHeight(nHeight)];
+}
+
 arith_uint256 GetBlockProof(const CBlockIndex& block)
 {
     arith_uint256 bnTarget;
@@ -162,6 +162,8 @@ enum BlockStatus: uint32_t {
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
 };
 
+class CChain;
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block. A blockindex may have multiple pprev pointing
@@ -219,6 +221,9 @@ public:
     //! (memory only) Maximum nTime in the chain up to and including this block.
     unsigned int nTimeMax;
 
+    //! (memory only) Number of this block's latest record in the headers file, plus one; 0 if none.
+    uint32_t nHeaderRecord;
+
     void SetNull()
     {
         phashBlock = nullptr;
@@ -234,6 +239,7 @@ public:
         nStatus = 0;
         nSequenceId = 0;
         nTimeMax = 0;
+        nHeaderRecord = 0;
 
         nVersion       = 0;
         hashMerkleRoot = uint256();
@@ -353,6 +359,10 @@ public:
 
     //! Build the skiplist pointer for this entry.
     void BuildSkip();
+    //! Build the skiplist pointer for an entry in chain by looking up the
+    //! target there. Unlike BuildSkip, this does not read other entries'
+    //! skiplist pointers, so entries can be done concurrently.
+    void BuildSkip(const CChain& chain);
 
     //! Efficiently find an ancestor of this block.
     CBlockIndex* GetAncestor(int height);
@@ -169,6 +169,11 @@ public:
             }
         };
 
+        snapshotData = {
+            {
+            }
+        };
+
         chainTxData = ChainTxData{
             // Data as of block 0000000000000000002d6cca6761c99b3c2e936f9a0e304b7c7651a993f461de (height 506081).
             1516903077, // * UNIX timestamp of last known number of transactions
@@ -263,6 +268,11 @@ public:
             }
         };
 
+        snapshotData = {
+            {
+            }
+        };
+
         chainTxData = ChainTxData{
             // Data as of block 000000000000033cfa3c975eb83ecf2bb4aaedf68e6d279f6ed2b427c64caff9 (height 1260526)
             1516903490,
@@ -336,6 +346,12 @@ public:
             }
         };
 
+        // No published snapshots; regtest accepts any snapshot for its own chain.
+        snapshotData = {
+            {
+            }
+        };
+
         chainTxData = ChainTxData{
             0,
             0,
@@ -25,6 +25,16 @@ struct CCheckpointData {
     MapCheckpoints mapCheckpoints;
 };
 
+typedef std::map<uint256, uint256> MapSnapshotHashes;
+
+/**
+ * Hashes of the UTXO snapshots (see utxosnapshot.h) that loadtxoutset
+ * accepts, keyed by the hash of the block each snapshot is based on.
+ */
+struct CSnapshotData {
+    MapSnapshotHashes mapSnapshotHashes;
+};
+
 /**
  * Holds various statistics on transactions within a chain. Used to estimate
  * verification progress during chain sync.
@@ -79,6 +89,7 @@ public:
     const std::string& Bech32HRP() const { return bech32_hrp; }
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
+    const CSnapshotData& Snapshots() const { return snapshotData; }
     const ChainTxData& TxData() const { return chainTxData; }
     void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout);
 protected:
@@ -98,6 +109,7 @@ protected:
     bool fRequireStandard;
     bool fMineBlocksOnDemand;
     CCheckpointData checkpointData;
+    CSnapshotData snapshotData;
     ChainTxData chainTxData;
     bool m_fallback_fee_enabled;
 };
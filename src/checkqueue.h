@@ -8,6 +8,10 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,12 +29,36 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every thread (the master included) owns a deque of pending checks. The
+  * master spreads each batch over the deques, and a thread works through its
+  * own deque from the back, stealing half of another thread's deque from the
+  * front when it runs dry. Each deque has its own lock, so threads only ever
+  * contend with the master pushing or with a single thief; the shared mutex
+  * is only taken to go to sleep or to wake sleepers up.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! Maximum number of per-thread deques; further threads share them.
+    static constexpr unsigned int MAX_SLOTS = 128;
+
+    struct Slot {
+        std::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    //! Per-thread deques, slot 0 being the master's
+    std::unique_ptr<Slot[]> slots;
+
+    //! Number of worker threads that registered a slot
+    std::atomic<unsigned int> nWorkers;
+
+    //! Slot that receives the next pushed checks
+    unsigned int nNextSlot;
+
+    //! Mutex to protect sleeping and waking up
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,87 +67,96 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
-
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
-
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! Number of checks sitting in the deques
+    std::atomic<unsigned int> nQueued;
 
-    //! The temporary evaluation result.
-    bool fAllOk;
+    //! The number of worker threads that are asleep (protected by mutex).
+    unsigned int nIdle;
 
     /**
      * Number of verifications that haven't completed yet.
-     * This includes elements that are no longer queued, but still in the
-     * worker's own batches.
+     * This includes elements that are no longer queued, but still in a
+     * worker's own batch.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
+
+    //! The temporary evaluation result. Once false, remaining checks are skipped.
+    std::atomic<bool> fAllOk;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    unsigned int SlotCount() const { return std::min(MAX_SLOTS, nWorkers.load() + 1); }
+
+    //! Move up to half of a slot's checks (at least one) into vChecks.
+    bool Take(Slot& slot, std::vector<T>& vChecks, bool fOwner)
+    {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        size_t nAvail = slot.checks.size();
+        if (nAvail == 0) return false;
+        size_t nNow = std::max<size_t>(1, std::min<size_t>(nBatchSize, nAvail / 2));
+        vChecks.resize(nNow);
+        for (T& check : vChecks) {
+            // Owners work from the back, thieves from the front, so they
+            // rarely fight over the same end of the deque.
+            if (fOwner) {
+                check.swap(slot.checks.back());
+                slot.checks.pop_back();
+            } else {
+                check.swap(slot.checks.front());
+                slot.checks.pop_front();
+            }
+        }
+        nQueued -= nNow;
+        return true;
+    }
+
+    bool Find(unsigned int nSlot, std::vector<T>& vChecks)
+    {
+        if (Take(slots[nSlot], vChecks, true)) return true;
+        const unsigned int nSlots = SlotCount();
+        for (unsigned int i = 1; i < nSlots; i++) {
+            if (Take(slots[(nSlot + i) % nSlots], vChecks, false)) return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    bool Loop(unsigned int nSlot, bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
+            if (!Find(nSlot, vChecks)) {
                 boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
+                if (fMaster && nTodo == 0) {
+                    // reset the status for new work later
+                    return fAllOk.exchange(true);
                 }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if (fMaster && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
+                if (nQueued == 0) {
+                    if (fMaster) {
+                        condMaster.wait(lock); // wait
+                    } else {
+                        nIdle++;
+                        condWorker.wait(lock); // wait
+                        nIdle--;
                     }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
             // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
+            for (T& check : vChecks) {
+                if (fAllOk.load(std::memory_order_relaxed) && !check()) {
+                    fAllOk = false;
+                }
+            }
+            const unsigned int nDone = vChecks.size();
             vChecks.clear();
+            if ((nTodo -= nDone) == 0) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutex);
+                condMaster.notify_one();
+            }
         } while (true);
     }
 
@@ -128,33 +165,43 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : slots(new Slot[MAX_SLOTS]), nWorkers(0), nNextSlot(0), nQueued(0), nIdle(0), nTodo(0), fAllOk(true), nBatchSize(nBatchSizeIn) {}
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        Loop(1 + nWorkers++ % (MAX_SLOTS - 1));
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
-        return Loop(true);
+        return Loop(0, true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty()) return;
+        // Spread the batch over the slots in contiguous runs, continuing
+        // round-robin where the previous batch left off.
+        const unsigned int nSlots = SlotCount();
+        const size_t nPerSlot = (vChecks.size() + nSlots - 1) / nSlots;
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
+        for (size_t i = 0; i < vChecks.size(); i += nPerSlot) {
+            Slot& slot = slots[nNextSlot++ % nSlots];
+            std::lock_guard<std::mutex> lock(slot.mutex);
+            for (size_t j = i; j < std::min(vChecks.size(), i + nPerSlot); j++) {
+                slot.checks.emplace_back();
+                vChecks[j].swap(slot.checks.back());
+            }
+            nQueued += std::min(vChecks.size(), i + nPerSlot) - i;
+        }
+        // Only wake up as many sleeping workers as there are new checks.
+        boost::unique_lock<boost::mutex> lock(mutex);
+        for (size_t i = std::min<size_t>(nIdle, vChecks.size()); i > 0; i--) {
             condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        }
     }
 
     ~CCheckQueue()
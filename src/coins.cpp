@@ -6,11 +6,14 @@
 
 #include <consensus/consensus.h>
 #include <random.h>
+#include <streams.h>
+#include <version.h>
 
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
-bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
+bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CRollingCoinsStats &stats) { return false; }
+bool CCoinsView::GetRollingStats(CRollingCoinsStats &stats) const { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
 
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
@@ -25,26 +28,319 @@ bool CCoinsViewBacked::HaveCoin(const COutPoint &outpoint) const { return base->
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetHeadBlocks(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
-bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
+bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CRollingCoinsStats &stats) { return base->BatchWrite(mapCoins, hashBlock, stats); }
+bool CCoinsViewBacked::GetRollingStats(CRollingCoinsStats &stats) const { return base->GetRollingStats(stats); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
+/** The element a coin contributes to the rolling hash. */
+static void SerializeCoinElement(CDataStream &ss, const COutPoint &outpoint, const Coin &coin)
+{
+    ss << outpoint;
+    ss << static_cast<uint32_t>(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+}
+
+static int64_t CoinBogoSize(const Coin &coin)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + coin.out.scriptPubKey.size() /* scriptPubKey */;
+}
+
+void CRollingCoinsStats::Add(const COutPoint &outpoint, const Coin &coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    SerializeCoinElement(ss, outpoint, coin);
+    muhash.Insert((const unsigned char*)ss.data(), ss.size());
+    ++nTransactionOutputs;
+    nBogoSize += CoinBogoSize(coin);
+    nTotalAmount += coin.out.nValue;
+}
+
+void CRollingCoinsStats::Remove(const COutPoint &outpoint, const Coin &coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    SerializeCoinElement(ss, outpoint, coin);
+    muhash.Remove((const unsigned char*)ss.data(), ss.size());
+    --nTransactionOutputs;
+    nBogoSize -= CoinBogoSize(coin);
+    nTotalAmount -= coin.out.nValue;
+}
+
+void CRollingCoinsStats::Apply(const CRollingCoinsStats &other)
+{
+    muhash *= other.muhash;
+    nTransactionOutputs += other.nTransactionOutputs;
+    nBogoSize += other.nBogoSize;
+    nTotalAmount += other.nTotalAmount;
+}
+
+void CompactCoin::Set(const Coin& coin)
+{
+    const uint64_t value = coin.out.nValue;
+    m_value_lo = uint32_t(value);
+    m_value_hi = uint32_t(value >> 32);
+    m_coinbase = coin.fCoinBase;
+    m_height = coin.nHeight;
+    m_size = 0;
+    if (coin.IsSpent()) {
+        m_type = SPENT;
+        return;
+    }
+    // The same templates as IsToKeyID and IsToScriptID in compressor.cpp.
+    const CScript& script = coin.out.scriptPubKey;
+    const size_t size = script.size();
+    if (size == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 &&
+        script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG) {
+        m_type = P2PKH;
+        memcpy(m_data, script.data() + 3, 20);
+    } else if (size == 23 && script[0] == OP_HASH160 && script[1] == 20 && script[22] == OP_EQUAL) {
+        m_type = P2SH;
+        memcpy(m_data, script.data() + 2, 20);
+    } else if (size <= DATA_SIZE) {
+        m_type = INLINE;
+        m_size = size;
+        memcpy(m_data, script.data(), size);
+    } else {
+        unsigned char* ptr = new unsigned char[size];
+        memcpy(ptr, script.data(), size);
+        const uint32_t heap_size = size;
+        memcpy(m_data, &ptr, sizeof(ptr));
+        memcpy(m_data + sizeof(ptr), &heap_size, sizeof(heap_size));
+        m_type = HEAP;
+    }
+}
+
+void CompactCoin::CopyFrom(const CompactCoin& other)
+{
+    m_value_lo = other.m_value_lo;
+    m_value_hi = other.m_value_hi;
+    m_coinbase = other.m_coinbase;
+    m_height = other.m_height;
+    m_type = other.m_type;
+    m_size = other.m_size;
+    memcpy(m_data, other.m_data, DATA_SIZE);
+    if (m_type == HEAP) {
+        const uint32_t size = other.HeapSize();
+        unsigned char* ptr = new unsigned char[size];
+        memcpy(ptr, other.HeapData(), size);
+        memcpy(m_data, &ptr, sizeof(ptr));
+    }
+}
+
+void CompactCoin::Decompress(Coin& coin) const
+{
+    if (IsSpent()) {
+        coin.Clear();
+        return;
+    }
+    coin.out.nValue = GetValue();
+    coin.fCoinBase = m_coinbase;
+    coin.nHeight = m_height;
+    CScript& script = coin.out.scriptPubKey;
+    switch (m_type) {
+    case P2PKH:
+        script.resize(25);
+        script[0] = OP_DUP;
+        script[1] = OP_HASH160;
+        script[2] = 20;
+        memcpy(script.data() + 3, m_data, 20);
+        script[23] = OP_EQUALVERIFY;
+        script[24] = OP_CHECKSIG;
+        break;
+    case P2SH:
+        script.resize(23);
+        script[0] = OP_HASH160;
+        script[1] = 20;
+        memcpy(script.data() + 2, m_data, 20);
+        script[22] = OP_EQUAL;
+        break;
+    case INLINE:
+        script.assign(m_data, m_data + m_size);
+        break;
+    case HEAP: {
+        const unsigned char* ptr = HeapData();
+        script.assign(ptr, ptr + HeapSize());
+        break;
+    }
+    }
+}
+
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+size_t CCoinsMap::FindSlot(const COutPoint& key, uint32_t tag, bool& found) const
+{
+    const size_t mask = m_table.size() - 1;
+    size_t insert_pos = m_table.size();
+    for (size_t pos = tag & mask; ; pos = (pos + 1) & mask) {
+        const Slot& slot = m_table[pos];
+        if (slot.entry == EMPTY) {
+            // Reuse the first tombstone on the way, if any.
+            found = false;
+            return insert_pos < m_table.size() ? insert_pos : pos;
+        }
+        if (slot.entry == DELETED) {
+            if (insert_pos == m_table.size()) insert_pos = pos;
+        } else if (slot.tag == tag && Entry(slot.entry - 1).first == key) {
+            found = true;
+            return pos;
+        }
+    }
+}
+
+uint32_t CCoinsMap::AllocateEntry()
+{
+    if (!m_free.empty()) {
+        const uint32_t n = m_free.back();
+        m_free.pop_back();
+        return n;
+    }
+    assert(m_allocated < DELETED - 1);
+    const uint32_t n = m_allocated++;
+    if (n == m_capacity) {
+        const size_t chunk_size = ChunkSize(m_chunks.size());
+        m_chunks.emplace_back(new Storage[chunk_size]);
+        m_capacity += chunk_size;
+    }
+    return n;
+}
+
+void CCoinsMap::Rehash(size_t table_size)
+{
+    std::vector<Slot> old_table(table_size, Slot{EMPTY, 0});
+    old_table.swap(m_table);
+    const size_t mask = m_table.size() - 1;
+    for (const Slot& slot : old_table) {
+        if (slot.entry == EMPTY || slot.entry == DELETED) continue;
+        size_t pos = slot.tag & mask;
+        while (m_table[pos].entry != EMPTY) pos = (pos + 1) & mask;
+        m_table[pos] = slot;
+    }
+    m_deleted = 0;
+}
+
+void CCoinsMap::Grow()
+{
+    // Double the table when it is more than 5/8 full of live entries;
+    // otherwise only clear the tombstones, which leaves room for at least
+    // an eighth of the table to be inserted before the next rehash.
+    size_t table_size = std::max<size_t>(16, m_table.size());
+    while ((m_size + 1) * 8 > table_size * 5) table_size *= 2;
+    Rehash(table_size);
+}
+
+CCoinsMap::iterator CCoinsMap::erase(iterator it)
+{
+    const size_t pos = it.m_pos;
+    Slot& slot = m_table[pos];
+    Entry(slot.entry - 1).~value_type();
+    m_free.push_back(slot.entry - 1);
+    // A slot followed by an empty one ends every probe sequence through it,
+    // so it can be emptied rather than turned into a tombstone.
+    if (m_table[(pos + 1) & (m_table.size() - 1)].entry == EMPTY) {
+        slot.entry = EMPTY;
+    } else {
+        slot.entry = DELETED;
+        ++m_deleted;
+    }
+    --m_size;
+    ++it;
+    return it;
+}
+
+void CCoinsMap::clear()
+{
+    for (iterator it = begin(); it != end(); ++it) {
+        it->~value_type();
+    }
+    std::vector<Slot>().swap(m_table);
+    std::vector<std::unique_ptr<Storage[]>>().swap(m_chunks);
+    std::vector<uint32_t>().swap(m_free);
+    m_allocated = 0;
+    m_capacity = 0;
+    m_size = 0;
+    m_deleted = 0;
+}
+
+void CCoinsMap::swap(CCoinsMap& other)
+{
+    std::swap(m_hasher, other.m_hasher);
+    m_table.swap(other.m_table);
+    m_chunks.swap(other.m_chunks);
+    m_free.swap(other.m_free);
+    std::swap(m_allocated, other.m_allocated);
+    std::swap(m_capacity, other.m_capacity);
+    std::swap(m_size, other.m_size);
+    std::swap(m_deleted, other.m_deleted);
+}
+
+size_t CCoinsMap::DynamicMemoryUsage() const
+{
+    size_t usage = memusage::DynamicUsage(m_table) + memusage::DynamicUsage(m_chunks) + memusage::DynamicUsage(m_free);
+    for (size_t chunk = 0; chunk < m_chunks.size(); ++chunk) {
+        usage += memusage::MallocUsage(ChunkSize(chunk) * sizeof(Storage));
+    }
+    return usage;
+}
+
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn, bool track_stats) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0), m_track_stats(track_stats) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
-    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
+    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage +
+           memusage::DynamicUsage(m_stats_added) + memusage::DynamicUsage(m_stats_removed) + m_stats_coins_usage;
+}
+
+void CCoinsViewCache::StatsAdd(const COutPoint &outpoint, const Coin &coin) {
+    if (!m_track_stats) return;
+    auto inserted = m_stats_added.emplace(outpoint, coin);
+    if (!inserted.second) {
+        // An overwritten coin is removed first, so this is not expected;
+        // hash the older coin right away.
+        statsDelta.Add(outpoint, inserted.first->second);
+        m_stats_coins_usage -= inserted.first->second.DynamicMemoryUsage();
+        inserted.first->second = coin;
+    }
+    m_stats_coins_usage += coin.DynamicMemoryUsage();
+}
+
+void CCoinsViewCache::StatsRemove(const COutPoint &outpoint, const Coin &coin) {
+    if (!m_track_stats) return;
+    auto it = m_stats_added.find(outpoint);
+    if (it != m_stats_added.end() && it->second.out == coin.out &&
+        it->second.nHeight == coin.nHeight && it->second.fCoinBase == coin.fCoinBase) {
+        // Added and spent again before being hashed: the two cancel out.
+        m_stats_coins_usage -= it->second.DynamicMemoryUsage();
+        m_stats_added.erase(it);
+        return;
+    }
+    m_stats_removed.emplace_back(outpoint, coin);
+    m_stats_coins_usage += coin.DynamicMemoryUsage();
+}
+
+void CCoinsViewCache::ApplyPendingStats() const {
+    for (const auto& added : m_stats_added) {
+        statsDelta.Add(added.first, added.second);
+    }
+    for (const auto& removed : m_stats_removed) {
+        statsDelta.Remove(removed.first, removed.second);
+    }
+    m_stats_added.clear();
+    m_stats_removed.clear();
+    m_stats_coins_usage = 0;
 }
 
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
     CCoinsMap::iterator it = cacheCoins.find(outpoint);
-    if (it != cacheCoins.end())
+    if (it != cacheCoins.end()) {
+        it->second.recent = true;
+        ++m_hits;
         return it;
+    }
+    ++m_misses;
     Coin tmp;
     if (!base->GetCoin(outpoint, tmp))
         return cacheCoins.end();
-    CCoinsMap::iterator ret = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(tmp))).first;
+    CCoinsMap::iterator ret = cacheCoins.try_emplace(outpoint, std::move(tmp)).first;
     if (ret->second.coin.IsSpent()) {
         // The parent only has an empty entry for this outpoint; we can consider our
         // version as fresh.
@@ -57,7 +353,7 @@ CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const
 bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     CCoinsMap::const_iterator it = FetchCoin(outpoint);
     if (it != cacheCoins.end()) {
-        coin = it->second.coin;
+        it->second.coin.Decompress(coin);
         return !coin.IsSpent();
     }
     return false;
@@ -68,10 +364,23 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
     if (coin.out.scriptPubKey.IsUnspendable()) return;
     CCoinsMap::iterator it;
     bool inserted;
-    std::tie(it, inserted) = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::tuple<>());
+    if (possible_overwrite) {
+        // The coin being overwritten has to leave the rolling stats, so it
+        // must be known even if it is not cached yet.
+        it = FetchCoin(outpoint);
+        inserted = it == cacheCoins.end();
+        if (inserted) {
+            it = cacheCoins.try_emplace(outpoint).first;
+        }
+    } else {
+        std::tie(it, inserted) = cacheCoins.try_emplace(outpoint);
+    }
     bool fresh = false;
     if (!inserted) {
         cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+        if (m_track_stats && !it->second.coin.IsSpent()) {
+            StatsRemove(outpoint, it->second.coin.Decompress());
+        }
     }
     if (!possible_overwrite) {
         if (!it->second.coin.IsSpent()) {
@@ -79,8 +388,10 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
         }
         fresh = !(it->second.flags & CCoinsCacheEntry::DIRTY);
     }
-    it->second.coin = std::move(coin);
+    StatsAdd(outpoint, coin);
+    it->second.coin = coin;
     it->second.flags |= CCoinsCacheEntry::DIRTY | (fresh ? CCoinsCacheEntry::FRESH : 0);
+    it->second.recent = true;
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
 }
 
@@ -99,8 +410,14 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
     CCoinsMap::iterator it = FetchCoin(outpoint);
     if (it == cacheCoins.end()) return false;
     cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
-    if (moveout) {
-        *moveout = std::move(it->second.coin);
+    if ((m_track_stats && !it->second.coin.IsSpent()) || moveout) {
+        Coin coin = it->second.coin.Decompress();
+        if (!coin.IsSpent()) {
+            StatsRemove(outpoint, coin);
+        }
+        if (moveout) {
+            *moveout = std::move(coin);
+        }
     }
     if (it->second.flags & CCoinsCacheEntry::FRESH) {
         cacheCoins.erase(it);
@@ -113,13 +430,12 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
 
 static const Coin coinEmpty;
 
-const Coin& CCoinsViewCache::AccessCoin(const COutPoint &outpoint) const {
+Coin CCoinsViewCache::AccessCoin(const COutPoint &outpoint) const {
     CCoinsMap::const_iterator it = FetchCoin(outpoint);
-    if (it == cacheCoins.end()) {
+    if (it == cacheCoins.end() || it->second.coin.IsSpent()) {
         return coinEmpty;
-    } else {
-        return it->second.coin;
     }
+    return it->second.coin.Decompress();
 }
 
 bool CCoinsViewCache::HaveCoin(const COutPoint &outpoint) const {
@@ -132,6 +448,24 @@ bool CCoinsViewCache::HaveCoinInCache(const COutPoint &outpoint) const {
     return (it != cacheCoins.end() && !it->second.coin.IsSpent());
 }
 
+bool CCoinsViewCache::HaveEntryInCache(const COutPoint &outpoint) const {
+    return cacheCoins.count(outpoint) != 0;
+}
+
+size_t CCoinsViewCache::AddFetchedCoins(std::vector<std::pair<COutPoint, Coin>>& coins) {
+    size_t added = 0;
+    for (auto& entry : coins) {
+        if (entry.second.IsSpent()) continue;
+        CCoinsMap::iterator it;
+        bool inserted;
+        std::tie(it, inserted) = cacheCoins.try_emplace(entry.first, std::move(entry.second));
+        if (!inserted) continue;
+        cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+        ++added;
+    }
+    return added;
+}
+
 uint256 CCoinsViewCache::GetBestBlock() const {
     if (hashBlock.IsNull())
         hashBlock = base->GetBestBlock();
@@ -142,7 +476,14 @@ void CCoinsViewCache::SetBestBlock(const uint256 &hashBlockIn) {
     hashBlock = hashBlockIn;
 }
 
-bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn) {
+bool CCoinsViewCache::GetRollingStats(CRollingCoinsStats &stats) const {
+    if (!m_track_stats || !base->GetRollingStats(stats)) return false;
+    ApplyPendingStats();
+    stats.Apply(statsDelta);
+    return true;
+}
+
+bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn, const CRollingCoinsStats &stats) {
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = mapCoins.erase(it)) {
         // Ignore non-dirty entries (optimization).
         if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) {
@@ -155,10 +496,11 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
             if (!(it->second.flags & CCoinsCacheEntry::FRESH && it->second.coin.IsSpent())) {
                 // Otherwise we will need to create it in the parent
                 // and move the data up and mark it as dirty
-                CCoinsCacheEntry& entry = cacheCoins[it->first];
+                CCoinsCacheEntry& entry = cacheCoins.try_emplace(it->first).first->second;
                 entry.coin = std::move(it->second.coin);
                 cachedCoinsUsage += entry.coin.DynamicMemoryUsage();
                 entry.flags = CCoinsCacheEntry::DIRTY;
+                entry.recent = true;
                 // We can mark it FRESH in the parent if it was FRESH in the child
                 // Otherwise it might have just been flushed from the parent's cache
                 // and already exist in the grandparent
@@ -188,6 +530,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                 itUs->second.coin = std::move(it->second.coin);
                 cachedCoinsUsage += itUs->second.coin.DynamicMemoryUsage();
                 itUs->second.flags |= CCoinsCacheEntry::DIRTY;
+                itUs->second.recent = true;
                 // NOTE: It is possible the child has a FRESH flag here in
                 // the event the entry we found in the parent is pruned. But
                 // we must not copy that FRESH flag to the parent as that
@@ -197,13 +540,38 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
         }
     }
     hashBlock = hashBlockIn;
+    if (m_track_stats) {
+        statsDelta.Apply(stats);
+    }
     return true;
 }
 
-bool CCoinsViewCache::Flush() {
-    bool fOk = base->BatchWrite(cacheCoins, hashBlock);
+bool CCoinsViewCache::Flush(size_t keep_usage) {
+    if (!m_track_stats) {
+        throw std::logic_error("Flushing a coins cache that does not track the rolling statistics");
+    }
+    // Copy the entries to keep before the base view takes over the map.
+    CCoinsMap kept;
+    size_t kept_coins_usage = 0;
+    if (keep_usage > 0) {
+        for (const auto& item : cacheCoins) {
+            if (!item.second.recent || item.second.coin.IsSpent()) continue;
+            kept.try_emplace(item.first, item.second.coin);
+            kept_coins_usage += item.second.coin.DynamicMemoryUsage();
+            // Measuring the map is not free, so only do it now and then.
+            if (kept.size() % 1024 == 0 && memusage::DynamicUsage(kept) + kept_coins_usage >= keep_usage) break;
+        }
+    }
+    ApplyPendingStats();
+    bool fOk = base->BatchWrite(cacheCoins, hashBlock, statsDelta);
     cacheCoins.clear();
     cachedCoinsUsage = 0;
+    if (fOk) {
+        cacheCoins.swap(kept);
+        cachedCoinsUsage = kept_coins_usage;
+    }
+    m_kept = cacheCoins.size();
+    statsDelta = CRollingCoinsStats();
     return fOk;
 }
 
@@ -226,8 +594,11 @@ CAmount CCoinsViewCache::GetValueIn(const CTransaction& tx) const
         return 0;
 
     CAmount nResult = 0;
-    for (unsigned int i = 0; i < tx.vin.size(); i++)
-        nResult += AccessCoin(tx.vin[i].prevout).out.nValue;
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        // Read the amount without decompressing the coin, as AccessCoin would.
+        CCoinsMap::const_iterator it = FetchCoin(tx.vin[i].prevout);
+        nResult += it == cacheCoins.end() ? coinEmpty.out.nValue : it->second.coin.GetValue();
+    }
 
     return nResult;
 }
@@ -247,11 +618,11 @@ bool CCoinsViewCache::HaveInputs(const CTransaction& tx) const
 static const size_t MIN_TRANSACTION_OUTPUT_WEIGHT = WITNESS_SCALE_FACTOR * ::GetSerializeSize(CTxOut(), SER_NETWORK, PROTOCOL_VERSION);
 static const size_t MAX_OUTPUTS_PER_BLOCK = MAX_BLOCK_WEIGHT / MIN_TRANSACTION_OUTPUT_WEIGHT;
 
-const Coin& AccessByTxid(const CCoinsViewCache& view, const uint256& txid)
+Coin AccessByTxid(const CCoinsViewCache& view, const uint256& txid)
 {
     COutPoint iter(txid, 0);
     while (iter.n < MAX_OUTPUTS_PER_BLOCK) {
-        const Coin& alternate = view.AccessCoin(iter);
+        Coin alternate = view.AccessCoin(iter);
         if (!alternate.IsSpent()) return alternate;
         ++iter.n;
     }
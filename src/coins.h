@@ -9,6 +9,8 @@
 #include <primitives/transaction.h>
 #include <compressor.h>
 #include <core_memusage.h>
+#include <crypto/common.h>
+#include <crypto/muhash.h>
 #include <hash.h>
 #include <memusage.h>
 #include <serialize.h>
@@ -16,8 +18,16 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
 
-#include <unordered_map>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 /**
  * A UTXO entry.
@@ -81,11 +91,119 @@ public:
     }
 };
 
+/**
+ * The form in which a cache entry holds a Coin.
+ *
+ * Pay-to-pubkey-hash and pay-to-script-hash scripts are kept as their
+ * 20-byte hash, as CScriptCompressor stores them on disk. Other scripts of
+ * up to 22 bytes, which covers pay-to-witness-pubkey-hash, are kept inline
+ * and longer ones in a heap allocation of their exact size. The amount is
+ * split into 32-bit halves, so the class needs only 4-byte alignment and
+ * packs directly behind the COutPoint key. A cache entry takes 76 bytes
+ * this way instead of 96 with a Coin and its 28-byte inline CScript.
+ *
+ * Reading the Coin back builds its script again, see Decompress.
+ */
+class CompactCoin
+{
+private:
+    enum Type : unsigned char {
+        SPENT,
+        //! m_data holds the 20-byte hash
+        P2PKH,
+        P2SH,
+        //! m_data holds m_size bytes of script
+        INLINE,
+        //! m_data holds a pointer to the script and its 32-bit size
+        HEAP,
+    };
+    static const unsigned int DATA_SIZE = 22;
+
+    uint32_t m_value_lo;
+    uint32_t m_value_hi;
+    uint32_t m_coinbase : 1;
+    uint32_t m_height : 31;
+    unsigned char m_type;
+    unsigned char m_size;
+    unsigned char m_data[DATA_SIZE];
+
+    unsigned char* HeapData() const { unsigned char* ptr; memcpy(&ptr, m_data, sizeof(ptr)); return ptr; }
+    uint32_t HeapSize() const { uint32_t size; memcpy(&size, m_data + sizeof(unsigned char*), sizeof(size)); return size; }
+    void Set(const Coin& coin);
+    void CopyFrom(const CompactCoin& other);
+    //! Take over the state of other, which is left spent.
+    void MoveFrom(CompactCoin& other)
+    {
+        m_value_lo = other.m_value_lo;
+        m_value_hi = other.m_value_hi;
+        m_coinbase = other.m_coinbase;
+        m_height = other.m_height;
+        m_type = other.m_type;
+        m_size = other.m_size;
+        memcpy(m_data, other.m_data, DATA_SIZE);
+        other.m_type = SPENT;
+    }
+
+public:
+    CompactCoin() : m_value_lo(0), m_value_hi(0), m_coinbase(0), m_height(0), m_type(SPENT), m_size(0) {}
+    explicit CompactCoin(const Coin& coin) { Set(coin); }
+    CompactCoin(const CompactCoin& other) { CopyFrom(other); }
+    CompactCoin(CompactCoin&& other) noexcept { MoveFrom(other); }
+    ~CompactCoin() { Clear(); }
+
+    CompactCoin& operator=(const CompactCoin& other)
+    {
+        if (this != &other) {
+            Clear();
+            CopyFrom(other);
+        }
+        return *this;
+    }
+    CompactCoin& operator=(CompactCoin&& other) noexcept
+    {
+        if (this != &other) {
+            Clear();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+    CompactCoin& operator=(const Coin& coin)
+    {
+        Clear();
+        Set(coin);
+        return *this;
+    }
+
+    //! Mark spent and release the script.
+    void Clear()
+    {
+        if (m_type == HEAP) delete[] HeapData();
+        m_type = SPENT;
+    }
+
+    bool IsSpent() const { return m_type == SPENT; }
+    bool IsCoinBase() const { return m_coinbase; }
+    uint32_t GetHeight() const { return m_height; }
+    //! The amount, or -1 (the null amount of CTxOut) if spent.
+    CAmount GetValue() const { return IsSpent() ? -1 : CAmount(uint64_t(m_value_hi) << 32 | m_value_lo); }
+
+    //! Write the Coin this holds to coin.
+    void Decompress(Coin& coin) const;
+    Coin Decompress() const
+    {
+        Coin coin;
+        Decompress(coin);
+        return coin;
+    }
+
+    size_t DynamicMemoryUsage() const { return m_type == HEAP ? memusage::MallocUsage(HeapSize()) : 0; }
+};
+
 class SaltedOutpointHasher
 {
 private:
     /** Salt */
-    const uint64_t k0, k1;
+    uint64_t k0, k1;
 
 public:
     SaltedOutpointHasher();
@@ -102,8 +220,15 @@ public:
 
 struct CCoinsCacheEntry
 {
-    Coin coin; // The actual cached data.
+    CompactCoin coin; // The actual cached data.
     unsigned char flags;
+    /**
+     * CLOCK reference bit, which fits in the padding after flags. Set when
+     * the entry is created or looked up again after being loaded; a flush
+     * keeps clean copies of such entries and clears the bit, so an entry
+     * survives the next flush only if it is used again.
+     */
+    bool recent;
 
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
@@ -115,11 +240,176 @@ struct CCoinsCacheEntry
          */
     };
 
-    CCoinsCacheEntry() : flags(0) {}
-    explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
+    CCoinsCacheEntry() : flags(0), recent(false) {}
+    explicit CCoinsCacheEntry(const Coin& coin_) : coin(coin_), flags(0), recent(false) {}
+    explicit CCoinsCacheEntry(const CompactCoin& coin_) : coin(coin_), flags(0), recent(false) {}
+};
+
+/**
+ * Map from outpoint to cache entry for CCoinsViewCache, with the part of the
+ * std::unordered_map interface that the caches use.
+ *
+ * Entries live in chunks that are allocated as the map grows and never move,
+ * so references to them stay valid until they are erased, as with a
+ * node-based map, but without a heap node per entry. Lookups go through an
+ * open-addressing table with linear probing whose slots hold an entry number
+ * and 32 bits of the salted SipHash of the key; the same bits pick the home
+ * slot, so rehashing does not hash the keys again and a probe rarely reads an
+ * entry that does not match. Scripts of up to 28 bytes are already stored
+ * inline in the entry by prevector.
+ *
+ * Erasing leaves a tombstone in the table and puts the entry on a free list,
+ * so iterators stay valid across erase, which the BatchWrite implementations
+ * rely on. Inserting can invalidate iterators, but not references.
+ */
+class CCoinsMap
+{
+public:
+    typedef COutPoint key_type;
+    typedef CCoinsCacheEntry mapped_type;
+    typedef std::pair<const COutPoint, CCoinsCacheEntry> value_type;
+
+private:
+    struct Slot {
+        //! Entry number + 1, or EMPTY or DELETED
+        uint32_t entry;
+        //! Low 32 bits of the key's hash
+        uint32_t tag;
+    };
+    static const uint32_t EMPTY = 0;
+    static const uint32_t DELETED = 0xffffffff;
+    //! The first chunks double in size from FIRST_CHUNK entries up to MAX_CHUNK, so small caches stay small.
+    static const uint32_t FIRST_CHUNK = 16;
+    static const unsigned int GROWING_CHUNKS = 8;
+    static const uint32_t MAX_CHUNK = FIRST_CHUNK << GROWING_CHUNKS;
+    typedef std::aligned_storage<sizeof(value_type), alignof(value_type)>::type Storage;
+
+    SaltedOutpointHasher m_hasher;
+    std::vector<Slot> m_table;
+    std::vector<std::unique_ptr<Storage[]>> m_chunks;
+    //! Entry numbers that were erased and can be reused
+    std::vector<uint32_t> m_free;
+    //! Entry numbers handed out so far
+    uint32_t m_allocated = 0;
+    //! Entries that fit in the allocated chunks
+    size_t m_capacity = 0;
+    size_t m_size = 0;
+    size_t m_deleted = 0;
+
+    static size_t ChunkSize(size_t chunk) { return chunk == 0 ? FIRST_CHUNK : chunk <= GROWING_CHUNKS ? FIRST_CHUNK << (chunk - 1) : MAX_CHUNK; }
+    Storage& EntryStorage(uint32_t n) const
+    {
+        if (n < FIRST_CHUNK) return m_chunks[0][n];
+        if (n < MAX_CHUNK) {
+            const unsigned int chunk = CountBits(n / FIRST_CHUNK);
+            return m_chunks[chunk][n - (FIRST_CHUNK << (chunk - 1))];
+        }
+        return m_chunks[GROWING_CHUNKS + 1 + (n - MAX_CHUNK) / MAX_CHUNK][(n - MAX_CHUNK) % MAX_CHUNK];
+    }
+    value_type& Entry(uint32_t n) const { return *reinterpret_cast<value_type*>(&EntryStorage(n)); }
+    uint32_t Tag(const COutPoint& key) const { return m_hasher(key); }
+
+    //! The table slot holding key, or where it would be inserted; sets found accordingly.
+    size_t FindSlot(const COutPoint& key, uint32_t tag, bool& found) const;
+    uint32_t AllocateEntry();
+    void Rehash(size_t table_size);
+    //! Make room for one more entry in the table.
+    void Grow();
+
+    template <typename Value>
+    class Iterator
+    {
+        friend class CCoinsMap;
+        const CCoinsMap* m_map;
+        size_t m_pos;
+        Iterator(const CCoinsMap* map, size_t pos) : m_map(map), m_pos(pos) {}
+        void SkipFree()
+        {
+            while (m_pos < m_map->m_table.size() && (m_map->m_table[m_pos].entry == EMPTY || m_map->m_table[m_pos].entry == DELETED)) ++m_pos;
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef CCoinsMap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Value* pointer;
+        typedef Value& reference;
+
+        Iterator() : m_map(nullptr), m_pos(0) {}
+        //! iterator converts to const_iterator
+        template <typename Other, typename = typename std::enable_if<std::is_convertible<Other*, Value*>::value>::type>
+        Iterator(const Iterator<Other>& other) : m_map(other.m_map), m_pos(other.m_pos) {}
+
+        reference operator*() const { return m_map->Entry(m_map->m_table[m_pos].entry - 1); }
+        pointer operator->() const { return &m_map->Entry(m_map->m_table[m_pos].entry - 1); }
+        Iterator& operator++() { ++m_pos; SkipFree(); return *this; }
+        Iterator operator++(int) { Iterator ret = *this; ++*this; return ret; }
+        template <typename Other>
+        bool operator==(const Iterator<Other>& other) const { return m_pos == other.m_pos; }
+        template <typename Other>
+        bool operator!=(const Iterator<Other>& other) const { return m_pos != other.m_pos; }
+
+        template <typename Other> friend class Iterator;
+    };
+
+public:
+    typedef Iterator<value_type> iterator;
+    typedef Iterator<const value_type> const_iterator;
+
+    CCoinsMap() {}
+    ~CCoinsMap() { clear(); }
+    CCoinsMap(const CCoinsMap&) = delete;
+    CCoinsMap& operator=(const CCoinsMap&) = delete;
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    iterator begin() { iterator it(this, 0); it.SkipFree(); return it; }
+    iterator end() { return iterator(this, m_table.size()); }
+    const_iterator begin() const { const_iterator it(this, 0); it.SkipFree(); return it; }
+    const_iterator end() const { return const_iterator(this, m_table.size()); }
+
+    iterator find(const COutPoint& key)
+    {
+        if (m_size == 0) return end();
+        bool found;
+        const size_t pos = FindSlot(key, Tag(key), found);
+        return found ? iterator(this, pos) : end();
+    }
+    const_iterator find(const COutPoint& key) const { return const_cast<CCoinsMap*>(this)->find(key); }
+    size_t count(const COutPoint& key) const { return find(key) != end(); }
+
+    //! Construct an entry from args unless key is present; like std::unordered_map::try_emplace.
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const COutPoint& key, Args&&... args)
+    {
+        if ((m_size + m_deleted + 1) * 4 > m_table.size() * 3) Grow();
+        const uint32_t tag = Tag(key);
+        bool found;
+        const size_t pos = FindSlot(key, tag, found);
+        if (found) return std::make_pair(iterator(this, pos), false);
+        const uint32_t n = AllocateEntry();
+        new (&EntryStorage(n)) value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        if (m_table[pos].entry == DELETED) --m_deleted;
+        m_table[pos] = Slot{n + 1, tag};
+        ++m_size;
+        return std::make_pair(iterator(this, pos), true);
+    }
+    std::pair<iterator, bool> emplace(const COutPoint& key, CCoinsCacheEntry&& entry) { return try_emplace(key, std::move(entry)); }
+
+    //! Erase the entry at it and return an iterator to the next one.
+    iterator erase(iterator it);
+    //! Destroy all entries and release the memory.
+    void clear();
+    //! Exchange the contents with other in constant time.
+    void swap(CCoinsMap& other);
+
+    size_t DynamicMemoryUsage() const;
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+namespace memusage {
+static inline size_t DynamicUsage(const CCoinsMap& m) { return m.DynamicMemoryUsage(); }
+}
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -141,6 +431,42 @@ private:
     uint256 hashBlock;
 };
 
+/**
+ * Statistics of a UTXO set that are kept up to date one coin at a time: a
+ * MuHash3072 of the coins plus running totals. Also used for the change
+ * between two states of a set, where the totals can be negative.
+ */
+class CRollingCoinsStats
+{
+public:
+    MuHash3072 muhash;
+    int64_t nTransactionOutputs = 0;
+    //! See gettxoutsetinfo
+    int64_t nBogoSize = 0;
+    CAmount nTotalAmount = 0;
+
+    void Add(const COutPoint &outpoint, const Coin &coin);
+    void Remove(const COutPoint &outpoint, const Coin &coin);
+    //! Add the changes recorded in other
+    void Apply(const CRollingCoinsStats &other);
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        unsigned char data[MuHash3072::SERIALIZED_SIZE];
+        muhash.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+        s << nTransactionOutputs << nBogoSize << nTotalAmount;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream &s) {
+        unsigned char data[MuHash3072::SERIALIZED_SIZE];
+        s.read((char*)data, sizeof(data));
+        muhash.FromBytes(data);
+        s >> nTransactionOutputs >> nBogoSize >> nTotalAmount;
+    }
+};
+
 /** Abstract view on the open txout dataset. */
 class CCoinsView
 {
@@ -164,8 +490,12 @@ public:
     virtual std::vector<uint256> GetHeadBlocks() const;
 
     //! Do a bulk modification (multiple Coin changes + BestBlock change).
-    //! The passed mapCoins can be modified.
-    virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+    //! The passed mapCoins can be modified. stats holds the change the
+    //! modification makes to the rolling statistics of the set.
+    virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CRollingCoinsStats &stats);
+
+    //! Retrieve the rolling statistics of the set, if this view keeps them.
+    virtual bool GetRollingStats(CRollingCoinsStats &stats) const;
 
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
@@ -191,7 +521,8 @@ public:
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     void SetBackend(CCoinsView &viewIn);
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CRollingCoinsStats &stats) override;
+    bool GetRollingStats(CRollingCoinsStats &stats) const override;
     CCoinsViewCursor *Cursor() const override;
     size_t EstimateSize() const override;
 };
@@ -211,8 +542,35 @@ protected:
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
+    /* Change to the rolling statistics of the set made by the changes in this
+     * cache, apart from the coins still waiting in m_stats_added/removed. */
+    mutable CRollingCoinsStats statsDelta;
+
+    /* Coins added to and removed from the set that are not hashed into
+     * statsDelta yet. Hashing is by far the most expensive part of keeping
+     * the statistics, so it is put off until the changes are handed on
+     * (Flush, GetRollingStats), which for a block's view is once per block.
+     * A coin that is added and spent again in between is never hashed. */
+    mutable std::map<COutPoint, Coin> m_stats_added;
+    mutable std::vector<std::pair<COutPoint, Coin>> m_stats_removed;
+    mutable size_t m_stats_coins_usage = 0;
+
+    /* Whether this cache keeps rolling statistics at all. */
+    const bool m_track_stats;
+
+    /* Lookups answered from the cache and passed to the base view, and entries kept by the last Flush. */
+    mutable uint64_t m_hits = 0;
+    mutable uint64_t m_misses = 0;
+    size_t m_kept = 0;
+
 public:
-    CCoinsViewCache(CCoinsView *baseIn);
+    /**
+     * Views that are dropped rather than flushed (block templates, mempool
+     * and script checks, VerifyDB) pass track_stats = false, so that their
+     * changes skip the rolling statistics entirely. Such a view cannot be
+     * flushed and has no statistics to report.
+     */
+    CCoinsViewCache(CCoinsView *baseIn, bool track_stats = true);
 
     /**
      * By deleting the copy constructor, we prevent accidentally using it when one intends to create a cache on top of a base cache.
@@ -224,7 +582,8 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CRollingCoinsStats &stats) override;
+    bool GetRollingStats(CRollingCoinsStats &stats) const override;
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
     }
@@ -237,16 +596,26 @@ public:
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
     /**
-     * Return a reference to Coin in the cache, or a pruned one if not found. This is
-     * more efficient than GetCoin.
-     *
-     * Generally, do not hold the reference returned for more than a short scope.
-     * While the current implementation allows for modifications to the contents
-     * of the cache while holding the reference, this behavior should not be relied
-     * on! To be safe, best to not hold the returned reference through any other
-     * calls to this cache.
+     * Check if the cache has any entry for the given outpoint, including a
+     * spent one, i.e. whether a lookup would be answered without calling the
+     * backing CCoinsView.
      */
-    const Coin& AccessCoin(const COutPoint &output) const;
+    bool HaveEntryInCache(const COutPoint &outpoint) const;
+
+    /**
+     * Insert coins that were looked up in the backing CCoinsView ahead of
+     * time, exactly as if they had been fetched on a cache miss. Entries for
+     * outpoints that are already cached and spent (not found) coins are
+     * skipped. Returns the number of coins added.
+     */
+    size_t AddFetchedCoins(std::vector<std::pair<COutPoint, Coin>>& coins);
+
+    /**
+     * Return the Coin in the cache, or a pruned one if not found. Coins are
+     * held compressed, so this decompresses a copy that belongs to the
+     * caller; callers that only need amounts should use GetValueIn.
+     */
+    Coin AccessCoin(const COutPoint &output) const;
 
     /**
      * Add a coin. Set potential_overwrite to true if a non-pruned version may
@@ -265,8 +634,12 @@ public:
      * Push the modifications applied to this cache to its base.
      * Failure to call this method before destruction will cause the changes to be forgotten.
      * If false is returned, the state of this cache (and its backing view) will be undefined.
+     *
+     * Afterwards the cache keeps clean copies of the unspent entries marked
+     * recent (see CCoinsCacheEntry::recent) until they take up keep_usage
+     * bytes, and is empty otherwise.
      */
-    bool Flush();
+    bool Flush(size_t keep_usage = 0);
 
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
@@ -277,6 +650,11 @@ public:
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
+    uint64_t GetCacheHits() const { return m_hits; }
+    uint64_t GetCacheMisses() const { return m_misses; }
+    //! Number of entries the last Flush kept in the cache
+    size_t GetKeptSize() const { return m_kept; }
+
     //! Calculate the size of the cache (in bytes)
     size_t DynamicMemoryUsage() const;
 
@@ -295,6 +673,11 @@ public:
 
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
+
+    void StatsAdd(const COutPoint &outpoint, const Coin &coin);
+    void StatsRemove(const COutPoint &outpoint, const Coin &coin);
+    //! Hash the coins waiting in m_stats_added/removed into statsDelta.
+    void ApplyPendingStats() const;
 };
 
 //! Utility function to add all of a transaction's outputs to a cache.
@@ -309,6 +692,6 @@ void AddCoins(CCoinsViewCache& cache, const CTransaction& tx, int nHeight, bool
 // This function can be quite expensive because in the event of a transaction
 // which is not found in the cache, it can cause up to MAX_OUTPUTS_PER_BLOCK
 // lookups to database, so it should be used with care.
-const Coin& AccessByTxid(const CCoinsViewCache& cache, const uint256& txid);
+Coin AccessByTxid(const CCoinsViewCache& cache, const uint256& txid);
 
 #endif // BITCOIN_COINS_H
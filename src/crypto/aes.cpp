@@ -12,6 +12,80 @@ extern "C" {
 #include <crypto/ctaes/ctaes.c>
 }
 
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL) && (defined(__x86_64__) || defined(__amd64__))
+#include <cpuid.h>
+#endif
+
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace aes256_ni
+{
+void ExpandEncryptKey(unsigned char* rk, const unsigned char* key);
+void ExpandDecryptKey(unsigned char* rk, const unsigned char* key);
+void Encrypt(const unsigned char* rk, unsigned char* out, const unsigned char* in);
+void Decrypt(const unsigned char* rk, unsigned char* const* out, const unsigned char* const* in, size_t blocks);
+}
+#else
+// Never called: AESAutoDetect only enables AES-NI when it is compiled in.
+namespace aes256_ni
+{
+static void ExpandEncryptKey(unsigned char*, const unsigned char*) { assert(false); }
+static void ExpandDecryptKey(unsigned char*, const unsigned char*) { assert(false); }
+static void Encrypt(const unsigned char*, unsigned char*, const unsigned char*) { assert(false); }
+static void Decrypt(const unsigned char*, unsigned char* const*, const unsigned char* const*, size_t) { assert(false); }
+}
+#endif
+
+namespace {
+
+bool g_use_aesni = false;
+
+/** Check an implementation against the FIPS-197 AES-256 example vector. */
+bool SelfTest()
+{
+    static const unsigned char key[32] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
+    static const unsigned char plain[16] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+    static const unsigned char cipher[16] = {
+        0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89};
+
+    // Decrypt 9 copies to cover both the 8-way and the single block paths
+    unsigned char buf[16], out[9][16];
+    unsigned char* outs[9];
+    const unsigned char* ins[9];
+    for (int i = 0; i < 9; i++) {
+        outs[i] = out[i];
+        ins[i] = cipher;
+    }
+    AES256Encrypt(key).Encrypt(buf, plain);
+    AES256Decrypt(key).Decrypt(outs, ins, 9);
+    if (memcmp(buf, cipher, 16)) return false;
+    for (int i = 0; i < 9; i++) {
+        if (memcmp(out[i], plain, 16)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string AESAutoDetect(bool use_aesni)
+{
+    std::string ret = "ctaes";
+    g_use_aesni = false;
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL) && (defined(__x86_64__) || defined(__amd64__))
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (use_aesni && __get_cpuid(1, &eax, &ebx, &ecx, &edx) && ((ecx >> 25) & 1)) {
+        g_use_aesni = true;
+        ret = "aesni";
+    }
+#else
+    (void)use_aesni;
+#endif
+    assert(SelfTest());
+    return ret;
+}
+
 AES128Encrypt::AES128Encrypt(const unsigned char key[16])
 {
     AES128_init(&ctx, key);
@@ -42,34 +116,59 @@ void AES128Decrypt::Decrypt(unsigned char plaintext[16], const unsigned char cip
     AES128_decrypt(&ctx, 1, plaintext, ciphertext);
 }
 
-AES256Encrypt::AES256Encrypt(const unsigned char key[32])
+AES256Encrypt::AES256Encrypt(const unsigned char key[32]) : use_aesni(g_use_aesni)
 {
-    AES256_init(&ctx, key);
+    if (use_aesni) {
+        aes256_ni::ExpandEncryptKey(rk, key);
+    } else {
+        AES256_init(&ctx, key);
+    }
 }
 
 AES256Encrypt::~AES256Encrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES256Encrypt::Encrypt(unsigned char ciphertext[16], const unsigned char plaintext[16]) const
 {
-    AES256_encrypt(&ctx, 1, ciphertext, plaintext);
+    if (use_aesni) {
+        aes256_ni::Encrypt(rk, ciphertext, plaintext);
+    } else {
+        AES256_encrypt(&ctx, 1, ciphertext, plaintext);
+    }
 }
 
-AES256Decrypt::AES256Decrypt(const unsigned char key[32])
+AES256Decrypt::AES256Decrypt(const unsigned char key[32]) : use_aesni(g_use_aesni)
 {
-    AES256_init(&ctx, key);
+    if (use_aesni) {
+        aes256_ni::ExpandDecryptKey(rk, key);
+    } else {
+        AES256_init(&ctx, key);
+    }
 }
 
 AES256Decrypt::~AES256Decrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES256Decrypt::Decrypt(unsigned char plaintext[16], const unsigned char ciphertext[16]) const
 {
-    AES256_decrypt(&ctx, 1, plaintext, ciphertext);
+    Decrypt(&plaintext, &ciphertext, 1);
+}
+
+void AES256Decrypt::Decrypt(unsigned char* const* plaintexts, const unsigned char* const* ciphertexts, size_t blocks) const
+{
+    if (use_aesni) {
+        aes256_ni::Decrypt(rk, plaintexts, ciphertexts, blocks);
+    } else {
+        for (size_t i = 0; i < blocks; i++) {
+            AES256_decrypt(&ctx, 1, plaintexts[i], ciphertexts[i]);
+        }
+    }
 }
 
 
@@ -109,11 +208,34 @@ static int CBCEncrypt(const T& enc, const unsigned char iv[AES_BLOCKSIZE], const
     return written;
 }
 
+/** Check and strip the padding of a decrypted message ending at out. Returns the plaintext size, or 0 on failure. */
+static int CBCCheckPadding(unsigned char* out, int written, bool pad)
+{
+    bool fail = false;
+
+    // When decrypting padding, attempt to run in constant-time
+    if (pad) {
+        // If used, padding size is the value of the last decrypted byte. For
+        // it to be valid, It must be between 1 and AES_BLOCKSIZE.
+        unsigned char padsize = *--out;
+        fail = !padsize | (padsize > AES_BLOCKSIZE);
+
+        // If not well-formed, treat it as though there's no padding.
+        padsize *= !fail;
+
+        // All padding must equal the last byte otherwise it's not well-formed
+        for (int i = AES_BLOCKSIZE; i != 0; i--)
+            fail |= ((i > AES_BLOCKSIZE - padsize) & (*out-- != padsize));
+
+        written -= padsize;
+    }
+    return written * !fail;
+}
+
 template <typename T>
 static int CBCDecrypt(const T& dec, const unsigned char iv[AES_BLOCKSIZE], const unsigned char* data, int size, bool pad, unsigned char* out)
 {
     int written = 0;
-    bool fail = false;
     const unsigned char* prev = iv;
 
     if (!data || !size || !out)
@@ -131,23 +253,52 @@ static int CBCDecrypt(const T& dec, const unsigned char iv[AES_BLOCKSIZE], const
         written += AES_BLOCKSIZE;
     }
 
-    // When decrypting padding, attempt to run in constant-time
-    if (pad) {
-        // If used, padding size is the value of the last decrypted byte. For
-        // it to be valid, It must be between 1 and AES_BLOCKSIZE.
-        unsigned char padsize = *--out;
-        fail = !padsize | (padsize > AES_BLOCKSIZE);
-
-        // If not well-formed, treat it as though there's no padding.
-        padsize *= !fail;
+    return CBCCheckPadding(out, written, pad);
+}
 
-        // All padding must equal the last byte otherwise it's not well-formed
-        for (int i = AES_BLOCKSIZE; i != 0; i--)
-            fail |= ((i > AES_BLOCKSIZE - padsize) & (*out-- != padsize));
+/** Blocks decrypted per AES256Decrypt call when decrypting many messages. */
+static const size_t CBC_BATCH_BLOCKS = 64;
 
-        written -= padsize;
+/** Like CBCDecrypt, but decrypts the blocks of all messages together. */
+static void CBCDecryptMany(const AES256Decrypt& dec, bool pad, AESCBCMessage* msgs, size_t count)
+{
+    unsigned char* outs[CBC_BATCH_BLOCKS];
+    const unsigned char* ins[CBC_BATCH_BLOCKS];
+    size_t n = 0;
+
+    // Decrypt all blocks of all well-formed messages, without chaining
+    for (size_t m = 0; m < count; m++) {
+        AESCBCMessage& msg = msgs[m];
+        msg.written = 0;
+        if (!msg.data || !msg.size || !msg.out || msg.size % AES_BLOCKSIZE != 0)
+            continue;
+        for (int pos = 0; pos != msg.size; pos += AES_BLOCKSIZE) {
+            outs[n] = msg.out + pos;
+            ins[n] = msg.data + pos;
+            if (++n == CBC_BATCH_BLOCKS) {
+                dec.Decrypt(outs, ins, n);
+                n = 0;
+            }
+        }
+        msg.written = msg.size;
+    }
+    if (n)
+        dec.Decrypt(outs, ins, n);
+
+    // Chain with the previous ciphertext block and check the padding
+    for (size_t m = 0; m < count; m++) {
+        AESCBCMessage& msg = msgs[m];
+        if (!msg.written)
+            continue;
+        const unsigned char* prev = msg.iv;
+        unsigned char* out = msg.out;
+        for (int pos = 0; pos != msg.size; pos += AES_BLOCKSIZE) {
+            for (int i = 0; i != AES_BLOCKSIZE; i++)
+                *out++ ^= prev[i];
+            prev = msg.data + pos;
+        }
+        msg.written = CBCCheckPadding(out, msg.size, pad);
     }
-    return written * !fail;
 }
 
 AES256CBCEncrypt::AES256CBCEncrypt(const unsigned char key[AES256_KEYSIZE], const unsigned char ivIn[AES_BLOCKSIZE], bool padIn)
@@ -175,7 +326,9 @@ AES256CBCDecrypt::AES256CBCDecrypt(const unsigned char key[AES256_KEYSIZE], cons
 
 int AES256CBCDecrypt::Decrypt(const unsigned char* data, int size, unsigned char* out) const
 {
-    return CBCDecrypt(dec, iv, data, size, pad, out);
+    AESCBCMessage msg{iv, data, size, out, 0};
+    CBCDecryptMany(dec, pad, &msg, 1);
+    return msg.written;
 }
 
 AES256CBCDecrypt::~AES256CBCDecrypt()
@@ -183,6 +336,16 @@ AES256CBCDecrypt::~AES256CBCDecrypt()
     memset(iv, 0, sizeof(iv));
 }
 
+AES256CBCBatchDecrypt::AES256CBCBatchDecrypt(const unsigned char key[AES256_KEYSIZE], bool padIn)
+    : dec(key), pad(padIn)
+{
+}
+
+void AES256CBCBatchDecrypt::Decrypt(AESCBCMessage* msgs, size_t count) const
+{
+    CBCDecryptMany(dec, pad, msgs, count);
+}
+
 AES128CBCEncrypt::AES128CBCEncrypt(const unsigned char key[AES128_KEYSIZE], const unsigned char ivIn[AES_BLOCKSIZE], bool padIn)
     : enc(key), pad(padIn)
 {
@@ -11,9 +11,20 @@ extern "C" {
 #include <crypto/ctaes/ctaes.h>
 }
 
+#include <stddef.h>
+#include <string>
+#include <vector>
+
 static const int AES_BLOCKSIZE = 16;
 static const int AES128_KEYSIZE = 16;
 static const int AES256_KEYSIZE = 32;
+/** Size of an expanded AES-256 key schedule as used by AES-NI (15 round keys). */
+static const int AES256_ROUNDKEYSIZE = 15 * AES_BLOCKSIZE;
+
+/** Autodetect whether AES-NI can be used for AES-256, and return the name
+ *  of the implementation that will be used. Objects created afterwards use
+ *  it; ctaes remains the fallback. */
+std::string AESAutoDetect(bool use_aesni = true);
 
 /** An encryption class for AES-128. */
 class AES128Encrypt
@@ -44,6 +55,8 @@ class AES256Encrypt
 {
 private:
     AES256_ctx ctx;
+    unsigned char rk[AES256_ROUNDKEYSIZE];
+    bool use_aesni;
 
 public:
     explicit AES256Encrypt(const unsigned char key[32]);
@@ -56,11 +69,15 @@ class AES256Decrypt
 {
 private:
     AES256_ctx ctx;
+    unsigned char rk[AES256_ROUNDKEYSIZE];
+    bool use_aesni;
 
 public:
     explicit AES256Decrypt(const unsigned char key[32]);
     ~AES256Decrypt();
     void Decrypt(unsigned char plaintext[16], const unsigned char ciphertext[16]) const;
+    /** Decrypt independent blocks; plaintexts[i] and ciphertexts[i] point to 16 bytes each. */
+    void Decrypt(unsigned char* const* plaintexts, const unsigned char* const* ciphertexts, size_t blocks) const;
 };
 
 class AES256CBCEncrypt
@@ -89,6 +106,34 @@ private:
     unsigned char iv[AES_BLOCKSIZE];
 };
 
+/** One message for AES256CBCBatchDecrypt. */
+struct AESCBCMessage
+{
+    const unsigned char* iv;   //!< AES_BLOCKSIZE bytes
+    const unsigned char* data; //!< ciphertext
+    int size;                  //!< ciphertext size
+    unsigned char* out;        //!< at least size bytes, not overlapping data
+    int written;               //!< set to the plaintext size, or 0 on failure
+};
+
+/**
+ * Decrypts many independent AES-256-CBC messages under one key, such as all
+ * keys of an encrypted wallet. The key schedule is set up once, and blocks of
+ * different messages are decrypted together.
+ */
+class AES256CBCBatchDecrypt
+{
+public:
+    AES256CBCBatchDecrypt(const unsigned char key[AES256_KEYSIZE], bool padIn);
+    /** Decrypt all messages; each gets the result AES256CBCDecrypt::Decrypt would give. */
+    void Decrypt(AESCBCMessage* msgs, size_t count) const;
+    void Decrypt(std::vector<AESCBCMessage>& msgs) const { Decrypt(msgs.data(), msgs.size()); }
+
+private:
+    const AES256Decrypt dec;
+    const bool pad;
+};
+
 class AES128CBCEncrypt
 {
 public:
@@ -0,0 +1,127 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// AES-256 using the x86 AES-NI instructions. The round keys are laid out as
+// 15 consecutive 16-byte words; the decryption schedule is the encryption one
+// reversed, with InvMixColumns applied to the inner round keys.
+
+#ifdef ENABLE_AESNI
+
+#include <stddef.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace aes256_ni {
+namespace {
+
+template <int rcon>
+void ExpandStep(__m128i& k1, __m128i& k2, __m128i* rk)
+{
+    // Even round key: derived from the previous even one and RotWord/SubWord of the last word of k2
+    __m128i t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k2, rcon), 0xff);
+    k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+    k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+    k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+    k1 = _mm_xor_si128(k1, t);
+    rk[0] = k1;
+    if (rcon == 0x40) return;
+
+    // Odd round key: derived from the previous odd one and SubWord of the last word of k1
+    t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k1, 0), 0xaa);
+    k2 = _mm_xor_si128(k2, _mm_slli_si128(k2, 4));
+    k2 = _mm_xor_si128(k2, _mm_slli_si128(k2, 4));
+    k2 = _mm_xor_si128(k2, _mm_slli_si128(k2, 4));
+    k2 = _mm_xor_si128(k2, t);
+    rk[1] = k2;
+}
+
+void Expand(__m128i rk[15], const unsigned char* key)
+{
+    __m128i k1 = _mm_loadu_si128((const __m128i*)key);
+    __m128i k2 = _mm_loadu_si128((const __m128i*)(key + 16));
+    rk[0] = k1;
+    rk[1] = k2;
+    ExpandStep<0x01>(k1, k2, rk + 2);
+    ExpandStep<0x02>(k1, k2, rk + 4);
+    ExpandStep<0x04>(k1, k2, rk + 6);
+    ExpandStep<0x08>(k1, k2, rk + 8);
+    ExpandStep<0x10>(k1, k2, rk + 10);
+    ExpandStep<0x20>(k1, k2, rk + 12);
+    ExpandStep<0x40>(k1, k2, rk + 14);
+}
+
+inline __m128i LoadKey(const unsigned char* rk, int i) { return _mm_loadu_si128((const __m128i*)(rk + 16 * i)); }
+
+} // namespace
+
+void ExpandEncryptKey(unsigned char* rk, const unsigned char* key)
+{
+    __m128i k[15];
+    Expand(k, key);
+    for (int i = 0; i < 15; ++i) _mm_storeu_si128((__m128i*)(rk + 16 * i), k[i]);
+}
+
+void ExpandDecryptKey(unsigned char* rk, const unsigned char* key)
+{
+    __m128i k[15];
+    Expand(k, key);
+    _mm_storeu_si128((__m128i*)rk, k[14]);
+    for (int i = 1; i < 14; ++i) _mm_storeu_si128((__m128i*)(rk + 16 * i), _mm_aesimc_si128(k[14 - i]));
+    _mm_storeu_si128((__m128i*)(rk + 16 * 14), k[0]);
+}
+
+void Encrypt(const unsigned char* rk, unsigned char* out, const unsigned char* in)
+{
+    __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in), LoadKey(rk, 0));
+    for (int i = 1; i < 14; ++i) x = _mm_aesenc_si128(x, LoadKey(rk, i));
+    _mm_storeu_si128((__m128i*)out, _mm_aesenclast_si128(x, LoadKey(rk, 14)));
+}
+
+void Decrypt(const unsigned char* rk, unsigned char* const* out, const unsigned char* const* in, size_t blocks)
+{
+    // Blocks are independent, so run 8 of them through the pipeline at a time.
+    while (blocks >= 8) {
+        __m128i k = LoadKey(rk, 0);
+        __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in[0]), k);
+        __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in[1]), k);
+        __m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in[2]), k);
+        __m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in[3]), k);
+        __m128i x4 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in[4]), k);
+        __m128i x5 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in[5]), k);
+        __m128i x6 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in[6]), k);
+        __m128i x7 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in[7]), k);
+        for (int i = 1; i < 14; ++i) {
+            k = LoadKey(rk, i);
+            x0 = _mm_aesdec_si128(x0, k);
+            x1 = _mm_aesdec_si128(x1, k);
+            x2 = _mm_aesdec_si128(x2, k);
+            x3 = _mm_aesdec_si128(x3, k);
+            x4 = _mm_aesdec_si128(x4, k);
+            x5 = _mm_aesdec_si128(x5, k);
+            x6 = _mm_aesdec_si128(x6, k);
+            x7 = _mm_aesdec_si128(x7, k);
+        }
+        k = LoadKey(rk, 14);
+        _mm_storeu_si128((__m128i*)out[0], _mm_aesdeclast_si128(x0, k));
+        _mm_storeu_si128((__m128i*)out[1], _mm_aesdeclast_si128(x1, k));
+        _mm_storeu_si128((__m128i*)out[2], _mm_aesdeclast_si128(x2, k));
+        _mm_storeu_si128((__m128i*)out[3], _mm_aesdeclast_si128(x3, k));
+        _mm_storeu_si128((__m128i*)out[4], _mm_aesdeclast_si128(x4, k));
+        _mm_storeu_si128((__m128i*)out[5], _mm_aesdeclast_si128(x5, k));
+        _mm_storeu_si128((__m128i*)out[6], _mm_aesdeclast_si128(x6, k));
+        _mm_storeu_si128((__m128i*)out[7], _mm_aesdeclast_si128(x7, k));
+        in += 8;
+        out += 8;
+        blocks -= 8;
+    }
+    while (blocks--) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)*in++), LoadKey(rk, 0));
+        for (int i = 1; i < 14; ++i) x = _mm_aesdec_si128(x, LoadKey(rk, i));
+        _mm_storeu_si128((__m128i*)*out++, _mm_aesdeclast_si128(x, LoadKey(rk, 14)));
+    }
+}
+
+} // namespace aes256_ni
+
+#endif
@@ -4,11 +4,14 @@
 
 #include <crypto/hmac_sha512.h>
 
+#include <support/cleanse.h>
+
 #include <string.h>
+#include <vector>
 
-CHMAC_SHA512::CHMAC_SHA512(const unsigned char* key, size_t keylen)
+/** Expand an HMAC key to one SHA-512 block. */
+static void PadKey(unsigned char rkey[128], const unsigned char* key, size_t keylen)
 {
-    unsigned char rkey[128];
     if (keylen <= 128) {
         memcpy(rkey, key, keylen);
         memset(rkey + keylen, 0, 128 - keylen);
@@ -16,6 +19,12 @@ CHMAC_SHA512::CHMAC_SHA512(const unsigned char* key, size_t keylen)
         CSHA512().Write(key, keylen).Finalize(rkey);
         memset(rkey + 64, 0, 64);
     }
+}
+
+CHMAC_SHA512::CHMAC_SHA512(const unsigned char* key, size_t keylen)
+{
+    unsigned char rkey[128];
+    PadKey(rkey, key, keylen);
 
     for (int n = 0; n < 128; n++)
         rkey[n] ^= 0x5c;
@@ -32,3 +41,28 @@ void CHMAC_SHA512::Finalize(unsigned char hash[OUTPUT_SIZE])
     inner.Finalize(temp);
     outer.Write(temp, 64).Finalize(hash);
 }
+
+void HMACSHA512Multi(unsigned char* output, const unsigned char* key, size_t keylen, const unsigned char* const* inputs, const size_t* lengths, size_t count)
+{
+    unsigned char rkey[128];
+    PadKey(rkey, key, keylen);
+
+    // Inner hashes: SHA512((key ^ ipad) || message)
+    std::vector<unsigned char> temp(64 * count);
+    for (int n = 0; n < 128; n++)
+        rkey[n] ^= 0x36;
+    SHA512MultiBuffer(temp.data(), rkey, inputs, lengths, count);
+
+    // Outer hashes: SHA512((key ^ opad) || inner hash)
+    std::vector<const unsigned char*> inner(count);
+    std::vector<size_t> inner_lengths(count, 64);
+    for (size_t i = 0; i < count; ++i)
+        inner[i] = temp.data() + 64 * i;
+    for (int n = 0; n < 128; n++)
+        rkey[n] ^= 0x36 ^ 0x5c;
+    SHA512MultiBuffer(output, rkey, inner.data(), inner_lengths.data(), count);
+
+    // The padded key and the inner hashes are as secret as the key is.
+    memory_cleanse(rkey, sizeof(rkey));
+    memory_cleanse(temp.data(), temp.size());
+}
@@ -29,4 +29,8 @@ public:
     void Finalize(unsigned char hash[OUTPUT_SIZE]);
 };
 
+/** Compute HMAC-SHA-512 of count messages under one key, hashing several
+ *  messages at once where possible. output receives count * 64 bytes. */
+void HMACSHA512Multi(unsigned char* output, const unsigned char* key, size_t keylen, const unsigned char* const* inputs, const size_t* lengths, size_t count);
+
 #endif // BITCOIN_CRYPTO_HMAC_SHA512_H
@@ -0,0 +1,78 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** An integer modulo the prime 2^3072 - 1103717. */
+class Num3072
+{
+public:
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static const int LIMBS = 48;
+    static const int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static const int LIMBS = 96;
+    static const int LIMB_SIZE = 32;
+#endif
+    static const size_t BYTE_SIZE = 384;
+
+    limb_t limbs[LIMBS];
+
+    Num3072() { SetToOne(); }
+    //! Little-endian; values of the modulus or above are reduced.
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    //! Multiply by the modular inverse of a.
+    void Divide(const Num3072& a);
+    Num3072 GetInverse() const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+};
+
+/**
+ * A multiset hash: the hash of a set of byte strings that can be updated by
+ * inserting or removing one element at a time, in any order. Each element
+ * is mapped to a number modulo a 3072-bit prime (SHA256, then ChaCha20
+ * keyed with the result), and the set to the product of its elements.
+ * Removals are kept as a separate denominator so that only Finalize needs
+ * a modular inverse.
+ *
+ * Two instances combine with *= (union) and /= (difference).
+ */
+class MuHash3072
+{
+private:
+    Num3072 m_numerator;
+    Num3072 m_denominator;
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+    static const size_t SERIALIZED_SIZE = 2 * Num3072::BYTE_SIZE;
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+    MuHash3072& operator*=(const MuHash3072& mul);
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    //! SHA256 of the set's number. Folds the denominator into the numerator.
+    void Finalize(unsigned char out[OUTPUT_SIZE]);
+
+    void ToBytes(unsigned char out[SERIALIZED_SIZE]) const;
+    void FromBytes(const unsigned char in[SERIALIZED_SIZE]);
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
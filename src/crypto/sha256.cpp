@@ -19,6 +19,36 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 #endif
 #endif
 
+namespace sha256_shani
+{
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
+}
+
+namespace sha256d64_shani
+{
+void Transform_2way(unsigned char* out, const unsigned char* in);
+}
+
+namespace sha256d64_sse41
+{
+void Transform_4way(unsigned char* out, const unsigned char* in);
+}
+
+namespace sha256_sse41
+{
+void Transform_4way(uint32_t* const* s, const unsigned char* const* chunks);
+}
+
+namespace sha256d64_avx2
+{
+void Transform_8way(unsigned char* out, const unsigned char* in);
+}
+
+namespace sha256_avx2
+{
+void Transform_8way(uint32_t* const* s, const unsigned char* const* chunks);
+}
+
 // Internal implementation code.
 namespace
 {
@@ -144,6 +174,36 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
 } // namespace sha256
 
 typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
+typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+typedef void (*TransformMultiType)(uint32_t* const*, const unsigned char* const*);
+
+/** Compute the double SHA-256 of a single 64-byte input, using a block transform. */
+template<TransformType tr>
+void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
+{
+    // The second block of the first hash only holds padding (512 bits of input).
+    static const unsigned char padding1[64] = {
+        0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0
+    };
+    // The second hash is of a 32-byte input (256 bits), followed by its padding.
+    unsigned char buffer2[64] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0
+    };
+    uint32_t s[8];
+    sha256::Initialize(s);
+    tr(s, in, 1);
+    tr(s, padding1, 1);
+    for (int i = 0; i < 8; ++i) {
+        WriteBE32(buffer2 + 4 * i, s[i]);
+    }
+    sha256::Initialize(s);
+    tr(s, buffer2, 1);
+    for (int i = 0; i < 8; ++i) {
+        WriteBE32(out + 4 * i, s[i]);
+    }
+}
 
 bool SelfTest(TransformType tr) {
     static const unsigned char in1[65] = {0, 0x80};
@@ -172,23 +232,275 @@ bool SelfTest(TransformType tr) {
     return true;
 }
 
+/** Check a multi-way double SHA-256 implementation against the single-way reference. */
+bool SelfTestD64(TransformD64Type tr, size_t ways)
+{
+    unsigned char in[64 * 8];
+    unsigned char out[32 * 8];
+    unsigned char expected[32 * 8];
+    assert(ways <= 8);
+    for (size_t i = 0; i < sizeof(in); ++i) {
+        in[i] = (unsigned char)(i * 37 + 11);
+    }
+    for (size_t i = 0; i < ways; ++i) {
+        TransformD64Wrapper<sha256::Transform>(expected + 32 * i, in + 64 * i);
+    }
+    tr(out, in);
+    return memcmp(out, expected, 32 * ways) == 0;
+}
+
+/** Check a multi-lane transform against the single-lane reference, with a different state and chunk per lane. */
+bool SelfTestMulti(TransformMultiType tr, size_t ways)
+{
+    unsigned char in[64 * 8];
+    uint32_t states[8][8];
+    uint32_t expected[8][8];
+    uint32_t* state_ptrs[8];
+    const unsigned char* chunk_ptrs[8];
+    assert(ways <= 8);
+    for (size_t i = 0; i < sizeof(in); ++i) {
+        in[i] = (unsigned char)(i * 91 + 7);
+    }
+    for (size_t i = 0; i < ways; ++i) {
+        sha256::Initialize(states[i]);
+        states[i][i] ^= 0x5a5a5a5aul;
+        memcpy(expected[i], states[i], sizeof(expected[i]));
+        sha256::Transform(expected[i], in + 64 * (ways - 1 - i), 1);
+        state_ptrs[i] = states[i];
+        chunk_ptrs[i] = in + 64 * (ways - 1 - i);
+    }
+    tr(state_ptrs, chunk_ptrs);
+    for (size_t i = 0; i < ways; ++i) {
+        if (memcmp(states[i], expected[i], sizeof(expected[i]))) return false;
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+
 TransformType Transform = sha256::Transform;
+TransformD64Type TransformD64 = TransformD64Wrapper<sha256::Transform>;
+TransformD64Type TransformD64_2way = nullptr;
+TransformD64Type TransformD64_4way = nullptr;
+TransformD64Type TransformD64_8way = nullptr;
+TransformMultiType TransformMulti_4way = nullptr;
+TransformMultiType TransformMulti_8way = nullptr;
+
+/** One message being hashed in a lane of the multi-buffer engine. */
+struct MultiBufferLane
+{
+    uint32_t s[8];
+    const unsigned char* data; //!< Next full block of the message itself
+    size_t data_blocks;        //!< Number of full message blocks left
+    unsigned char tail[128];   //!< Final partial block of the message, followed by the padding
+    size_t tail_pos;           //!< Offset of the next block in tail
+    size_t tail_end;           //!< Size of the padded tail: one or two blocks
+    size_t index;              //!< Which message this lane is hashing
+    bool outer;                //!< Whether this is the second hash of the double SHA-256
+
+    void Start(const unsigned char* msg, size_t len, size_t idx, bool outer_hash)
+    {
+        sha256::Initialize(s);
+        data = msg;
+        data_blocks = len / 64;
+        size_t rem = len % 64;
+        if (rem) memcpy(tail, msg + 64 * data_blocks, rem);
+        tail[rem] = 0x80;
+        tail_end = rem < 56 ? 64 : 128;
+        memset(tail + rem + 1, 0, tail_end - 8 - rem - 1);
+        WriteBE64(tail + tail_end - 8, (uint64_t)len << 3);
+        tail_pos = 0;
+        index = idx;
+        outer = outer_hash;
+    }
+
+    bool Done() const { return data_blocks == 0 && tail_pos == tail_end; }
+
+    const unsigned char* NextBlock()
+    {
+        const unsigned char* ret;
+        if (data_blocks) {
+            ret = data;
+            data += 64;
+            --data_blocks;
+        } else {
+            ret = tail + tail_pos;
+            tail_pos += 64;
+        }
+        return ret;
+    }
+
+    /** Process all remaining blocks with the single-lane transform. */
+    void Finish()
+    {
+        if (data_blocks) {
+            Transform(s, data, data_blocks);
+            data += 64 * data_blocks;
+            data_blocks = 0;
+        }
+        Transform(s, tail + tail_pos, (tail_end - tail_pos) / 64);
+        tail_pos = tail_end;
+    }
+
+    /** Move on once Done(): start the outer hash, or store the result. Returns false if nothing is left to do. */
+    bool Complete(unsigned char* output)
+    {
+        unsigned char hash[32];
+        for (int i = 0; i < 8; ++i) {
+            WriteBE32(hash + 4 * i, s[i]);
+        }
+        if (!outer) {
+            Start(hash, 32, index, true);
+            return true;
+        }
+        memcpy(output + 32 * index, hash, 32);
+        return false;
+    }
+};
+
+/** Double-SHA256 a list of messages using an N-lane transform, refilling lanes as messages complete. */
+template<size_t N>
+void MultiBufferD(TransformMultiType tr, unsigned char* out, const unsigned char* const* in, const size_t* lens, size_t count)
+{
+    static const unsigned char idle_chunk[64] = {0};
+    uint32_t idle_state[8];
+    MultiBufferLane lanes[N];
+    bool active[N];
+    uint32_t* states[N];
+    const unsigned char* chunks[N];
+    size_t next = 0;
+    size_t num_active = 0;
+
+    for (size_t i = 0; i < N; ++i) {
+        active[i] = next < count;
+        if (active[i]) {
+            lanes[i].Start(in[next], lens[next], next, false);
+            ++next;
+            ++num_active;
+        }
+    }
+    // Once no new messages are left and at most half of the lanes would be
+    // busy, the single-lane transform is faster.
+    while (num_active && (next < count || 2 * num_active > N)) {
+        for (size_t i = 0; i < N; ++i) {
+            if (active[i]) {
+                states[i] = lanes[i].s;
+                chunks[i] = lanes[i].NextBlock();
+            } else {
+                states[i] = idle_state;
+                chunks[i] = idle_chunk;
+            }
+        }
+        tr(states, chunks);
+        for (size_t i = 0; i < N; ++i) {
+            if (active[i] && lanes[i].Done() && !lanes[i].Complete(out)) {
+                if (next < count) {
+                    lanes[i].Start(in[next], lens[next], next, false);
+                    ++next;
+                } else {
+                    active[i] = false;
+                    --num_active;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < N; ++i) {
+        if (!active[i]) continue;
+        do {
+            lanes[i].Finish();
+        } while (lanes[i].Complete(out));
+    }
+}
 
 } // namespace
 
-std::string SHA256AutoDetect()
+std::string SHA256AutoDetect(sha256_implementation::UseImplementation use_implementation)
 {
+    std::string ret = "standard";
+    Transform = sha256::Transform;
+    TransformD64 = TransformD64Wrapper<sha256::Transform>;
+    TransformD64_2way = nullptr;
+    TransformD64_4way = nullptr;
+    TransformD64_8way = nullptr;
+    TransformMulti_4way = nullptr;
+    TransformMulti_8way = nullptr;
+
 #if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
-    uint32_t eax, ebx, ecx, edx;
-    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx >> 19) & 1) {
+    bool have_sse4 = false;
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool have_shani = false;
+    bool enabled_avx = false;
+
+    // Only used when the corresponding backends are compiled in.
+    (void)have_avx2;
+    (void)have_shani;
+    (void)enabled_avx;
+
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        have_sse4 = (ecx >> 19) & 1;
+        have_xsave = (ecx >> 27) & 1;
+        have_avx = (ecx >> 28) & 1;
+        if (have_xsave && have_avx) {
+            enabled_avx = AVXEnabled();
+        }
+        if (__get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            have_avx2 = (ebx >> 5) & 1;
+            have_shani = (ebx >> 29) & 1;
+        }
+    }
+
+#if defined(ENABLE_SHANI) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_shani && (use_implementation & sha256_implementation::USE_SHANI)) {
+        Transform = sha256_shani::Transform;
+        TransformD64 = TransformD64Wrapper<sha256_shani::Transform>;
+        TransformD64_2way = sha256d64_shani::Transform_2way;
+        ret = "shani(1way,2way)";
+        // The SHA-NI transforms beat the SSE4/AVX2 ones; don't override them below.
+        have_sse4 = false;
+        have_avx2 = false;
+    }
+#endif
+
+    if (have_sse4 && (use_implementation & sha256_implementation::USE_SSE4)) {
         Transform = sha256_sse4::Transform;
-        assert(SelfTest(Transform));
-        return "sse4";
+        TransformD64 = TransformD64Wrapper<sha256_sse4::Transform>;
+        ret = "sse4(1way)";
+#if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
+        TransformD64_4way = sha256d64_sse41::Transform_4way;
+        TransformMulti_4way = sha256_sse41::Transform_4way;
+        ret += ",sse41(4way)";
+#endif
     }
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && have_avx && enabled_avx && (use_implementation & sha256_implementation::USE_AVX2)) {
+        TransformD64_8way = sha256d64_avx2::Transform_8way;
+        TransformMulti_8way = sha256_avx2::Transform_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
 #endif
 
     assert(SelfTest(Transform));
-    return "standard";
+    assert(SelfTestD64(TransformD64, 1));
+    if (TransformD64_2way) assert(SelfTestD64(TransformD64_2way, 2));
+    if (TransformD64_4way) assert(SelfTestD64(TransformD64_4way, 4));
+    if (TransformD64_8way) assert(SelfTestD64(TransformD64_8way, 8));
+    if (TransformMulti_4way) assert(SelfTestMulti(TransformMulti_4way, 4));
+    if (TransformMulti_8way) assert(SelfTestMulti(TransformMulti_8way, 8));
+    return ret;
 }
 
 ////// SHA-256
@@ -247,3 +559,52 @@ CSHA256& CSHA256::Reset()
     sha256::Initialize(s);
     return *this;
 }
+
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (TransformD64_8way) {
+        while (blocks >= 8) {
+            TransformD64_8way(out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    if (TransformD64_4way) {
+        while (blocks >= 4) {
+            TransformD64_4way(out, in);
+            out += 128;
+            in += 256;
+            blocks -= 4;
+        }
+    }
+    if (TransformD64_2way) {
+        while (blocks >= 2) {
+            TransformD64_2way(out, in);
+            out += 64;
+            in += 128;
+            blocks -= 2;
+        }
+    }
+    while (blocks) {
+        TransformD64(out, in);
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
+
+void SHA256DMultiBuffer(unsigned char* out, const unsigned char* const* in, const size_t* lens, size_t count)
+{
+    if (TransformMulti_8way) {
+        MultiBufferD<8>(TransformMulti_8way, out, in, lens, count);
+    } else if (TransformMulti_4way) {
+        MultiBufferD<4>(TransformMulti_4way, out, in, lens, count);
+    } else {
+        unsigned char hash[CSHA256::OUTPUT_SIZE];
+        for (size_t i = 0; i < count; ++i) {
+            CSHA256().Write(in[i], lens[i]).Finalize(hash);
+            CSHA256().Write(hash, sizeof(hash)).Finalize(out + 32 * i);
+        }
+    }
+}
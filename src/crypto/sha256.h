@@ -26,9 +26,42 @@ public:
     CSHA256& Reset();
 };
 
-/** Autodetect the best available SHA256 implementation.
+namespace sha256_implementation {
+/** Bitmask of the optional SHA256 backends SHA256AutoDetect() may pick. */
+enum UseImplementation : uint8_t {
+    STANDARD = 0,
+    USE_SSE4 = 1 << 0,
+    USE_AVX2 = 1 << 1,
+    USE_SHANI = 1 << 2,
+    USE_SSE4_AND_AVX2 = USE_SSE4 | USE_AVX2,
+    USE_SSE4_AND_SHANI = USE_SSE4 | USE_SHANI,
+    USE_ALL = USE_SSE4 | USE_AVX2 | USE_SHANI,
+};
+}
+
+/** Autodetect the best available SHA256 implementation, restricted to the
+ *  backends allowed by use_implementation (benchmarks use this to compare them).
  *  Returns the name of the implementation.
  */
-std::string SHA256AutoDetect();
+std::string SHA256AutoDetect(sha256_implementation::UseImplementation use_implementation = sha256_implementation::USE_ALL);
+
+/** Compute multiple double-SHA256's of 64-byte blobs.
+ *  output:  pointer to a blocks*32 byte output buffer
+ *  input:   pointer to a blocks*64 byte input buffer
+ *  blocks:  the number of hashes to compute.
+ *  The output may overlap the input, as long as output <= input; merkle tree
+ *  levels are computed in place this way.
+ */
+void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
+
+/** Compute the double-SHA256's of multiple variable-length messages.
+ *  output:  pointer to a count*32 byte output buffer
+ *  inputs:  pointers to the count messages
+ *  lengths: the length in bytes of each message
+ *  count:   the number of messages
+ *  The messages are spread over the lanes of the multi-way transforms, when
+ *  available, so that several of them are hashed together.
+ */
+void SHA256DMultiBuffer(unsigned char* output, const unsigned char* const* inputs, const size_t* lengths, size_t count);
 
 #endif // BITCOIN_CRYPTO_SHA256_H
@@ -6,8 +6,17 @@
 
 #include <crypto/common.h>
 
+#include <assert.h>
 #include <string.h>
 
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL) && (defined(__x86_64__) || defined(__amd64__))
+#include <cpuid.h>
+namespace sha512_avx2
+{
+void Transform_4way(uint64_t* const* s, const unsigned char* const* chunks);
+}
+#endif
+
 // Internal implementation code.
 namespace
 {
@@ -146,8 +155,190 @@ void Transform(uint64_t* s, const unsigned char* chunk)
 
 } // namespace sha512
 
+typedef void (*TransformMultiType)(uint64_t* const*, const unsigned char* const*);
+
+/** Check a multi-lane transform against the single-lane reference, with a different state and chunk per lane. */
+bool SelfTestMulti(TransformMultiType tr, size_t ways)
+{
+    unsigned char in[128 * 4];
+    uint64_t states[4][8];
+    uint64_t expected[4][8];
+    uint64_t* state_ptrs[4];
+    const unsigned char* chunk_ptrs[4];
+    assert(ways <= 4);
+    for (size_t i = 0; i < sizeof(in); ++i) {
+        in[i] = (unsigned char)(i * 91 + 7);
+    }
+    for (size_t i = 0; i < ways; ++i) {
+        sha512::Initialize(states[i]);
+        states[i][i] ^= 0x5a5a5a5a5a5a5a5aull;
+        memcpy(expected[i], states[i], sizeof(expected[i]));
+        sha512::Transform(expected[i], in + 128 * (ways - 1 - i));
+        state_ptrs[i] = states[i];
+        chunk_ptrs[i] = in + 128 * (ways - 1 - i);
+    }
+    tr(state_ptrs, chunk_ptrs);
+    for (size_t i = 0; i < ways; ++i) {
+        if (memcmp(states[i], expected[i], sizeof(expected[i]))) return false;
+    }
+    return true;
+}
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL) && (defined(__x86_64__) || defined(__amd64__))
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+
+TransformMultiType TransformMulti_4way = nullptr;
+
+/** One message being hashed in a lane of the multi-buffer engine. */
+struct MultiBufferLane
+{
+    uint64_t s[8];
+    const unsigned char* data; //!< Next full block of the message itself
+    size_t data_blocks;        //!< Number of full message blocks left
+    unsigned char tail[256];   //!< Final partial block of the message, followed by the padding
+    size_t tail_pos;           //!< Offset of the next block in tail
+    size_t tail_end;           //!< Size of the padded tail: one or two blocks
+    size_t index;              //!< Which message this lane is hashing
+
+    /** Start hashing msg from state init, which has already absorbed prefix_len bytes. */
+    void Start(const uint64_t* init, size_t prefix_len, const unsigned char* msg, size_t len, size_t idx)
+    {
+        memcpy(s, init, sizeof(s));
+        data = msg;
+        data_blocks = len / 128;
+        size_t rem = len % 128;
+        if (rem) memcpy(tail, msg + 128 * data_blocks, rem);
+        tail[rem] = 0x80;
+        tail_end = rem < 112 ? 128 : 256;
+        memset(tail + rem + 1, 0, tail_end - 8 - rem - 1);
+        WriteBE64(tail + tail_end - 8, (uint64_t)(prefix_len + len) << 3);
+        tail_pos = 0;
+        index = idx;
+    }
+
+    bool Done() const { return data_blocks == 0 && tail_pos == tail_end; }
+
+    const unsigned char* NextBlock()
+    {
+        const unsigned char* ret;
+        if (data_blocks) {
+            ret = data;
+            data += 128;
+            --data_blocks;
+        } else {
+            ret = tail + tail_pos;
+            tail_pos += 128;
+        }
+        return ret;
+    }
+
+    /** Process all remaining blocks with the single-lane transform. */
+    void Finish()
+    {
+        while (!Done()) {
+            sha512::Transform(s, NextBlock());
+        }
+    }
+
+    void Store(unsigned char* output) const
+    {
+        for (int i = 0; i < 8; ++i) {
+            WriteBE64(output + 64 * index + 8 * i, s[i]);
+        }
+    }
+};
+
+/** SHA512 a list of messages using an N-lane transform, refilling lanes as messages complete. */
+template<size_t N>
+void MultiBuffer(TransformMultiType tr, unsigned char* out, const uint64_t* init, size_t prefix_len, const unsigned char* const* in, const size_t* lens, size_t count)
+{
+    static const unsigned char idle_chunk[128] = {0};
+    uint64_t idle_state[8];
+    MultiBufferLane lanes[N];
+    bool active[N];
+    uint64_t* states[N];
+    const unsigned char* chunks[N];
+    size_t next = 0;
+    size_t num_active = 0;
+
+    for (size_t i = 0; i < N; ++i) {
+        active[i] = next < count;
+        if (active[i]) {
+            lanes[i].Start(init, prefix_len, in[next], lens[next], next);
+            ++next;
+            ++num_active;
+        }
+    }
+    // Once no new messages are left and at most half of the lanes would be
+    // busy, the single-lane transform is faster.
+    while (num_active && (next < count || 2 * num_active > N)) {
+        for (size_t i = 0; i < N; ++i) {
+            if (active[i]) {
+                states[i] = lanes[i].s;
+                chunks[i] = lanes[i].NextBlock();
+            } else {
+                states[i] = idle_state;
+                chunks[i] = idle_chunk;
+            }
+        }
+        tr(states, chunks);
+        for (size_t i = 0; i < N; ++i) {
+            if (active[i] && lanes[i].Done()) {
+                lanes[i].Store(out);
+                if (next < count) {
+                    lanes[i].Start(init, prefix_len, in[next], lens[next], next);
+                    ++next;
+                } else {
+                    active[i] = false;
+                    --num_active;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < N; ++i) {
+        if (!active[i]) continue;
+        lanes[i].Finish();
+        lanes[i].Store(out);
+    }
+}
+
 } // namespace
 
+std::string SHA512AutoDetect(bool use_avx2)
+{
+    std::string ret = "standard";
+    TransformMulti_4way = nullptr;
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL) && (defined(__x86_64__) || defined(__amd64__))
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (use_avx2 && __get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        const bool have_xsave = (ecx >> 27) & 1;
+        const bool have_avx = (ecx >> 28) & 1;
+        bool have_avx2 = false;
+        if (__get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            have_avx2 = (ebx >> 5) & 1;
+        }
+        if (have_xsave && have_avx && have_avx2 && AVXEnabled()) {
+            TransformMulti_4way = sha512_avx2::Transform_4way;
+            ret = "avx2(4way)";
+        }
+    }
+#else
+    (void)use_avx2;
+#endif
+
+    if (TransformMulti_4way) assert(SelfTestMulti(TransformMulti_4way, 4));
+    return ret;
+}
+
 
 ////// SHA-512
 
@@ -205,3 +396,17 @@ CSHA512& CSHA512::Reset()
     sha512::Initialize(s);
     return *this;
 }
+
+void SHA512MultiBuffer(unsigned char* output, const unsigned char* prefix, const unsigned char* const* inputs, const size_t* lengths, size_t count)
+{
+    uint64_t init[8];
+    sha512::Initialize(init);
+    if (prefix) sha512::Transform(init, prefix);
+    const size_t prefix_len = prefix ? 128 : 0;
+    if (TransformMulti_4way) {
+        MultiBuffer<4>(TransformMulti_4way, output, init, prefix_len, inputs, lengths, count);
+    } else {
+        MultiBuffer<1>([](uint64_t* const* s, const unsigned char* const* chunks) { sha512::Transform(s[0], chunks[0]); },
+                       output, init, prefix_len, inputs, lengths, count);
+    }
+}
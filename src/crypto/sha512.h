@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-512. */
 class CSHA512
@@ -25,4 +26,16 @@ public:
     CSHA512& Reset();
 };
 
+/** Autodetect the best available SHA512 implementation.
+ *  Returns the name of the implementation.
+ */
+std::string SHA512AutoDetect(bool use_avx2 = true);
+
+/** Compute the SHA512 of count messages at once: output i (64 bytes each) is
+ *  SHA512(prefix || inputs[i]), where prefix is one 128-byte block shared by
+ *  all messages, or absent if nullptr. Messages are hashed 4 at a time when
+ *  the AVX2 backend is available.
+ */
+void SHA512MultiBuffer(unsigned char* output, const unsigned char* prefix, const unsigned char* const* inputs, const size_t* lengths, size_t count);
+
 #endif // BITCOIN_CRYPTO_SHA512_H
@@ -5,6 +5,7 @@
 #include <hash.h>
 #include <crypto/common.h>
 #include <crypto/hmac_sha512.h>
+#include <support/cleanse.h>
 
 
 inline uint32_t ROTL32(uint32_t x, int8_t r)
@@ -78,6 +79,28 @@ void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char he
     CHMAC_SHA512(chainCode.begin(), chainCode.size()).Write(&header, 1).Write(data, 32).Write(num, 4).Finalize(output);
 }
 
+void BIP32HashMulti(const ChainCode &chainCode, unsigned int nChildBegin, unsigned int count, unsigned char header, const unsigned char data[32], unsigned char* output)
+{
+    static const size_t MSG_SIZE = 1 + 32 + 4;
+    std::vector<unsigned char> msgs(MSG_SIZE * count);
+    std::vector<const unsigned char*> inputs(count);
+    std::vector<size_t> lengths(count, MSG_SIZE);
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned char* msg = &msgs[MSG_SIZE * i];
+        unsigned int nChild = nChildBegin + i;
+        msg[0] = header;
+        memcpy(msg + 1, data, 32);
+        msg[33] = (nChild >> 24) & 0xFF;
+        msg[34] = (nChild >> 16) & 0xFF;
+        msg[35] = (nChild >>  8) & 0xFF;
+        msg[36] = (nChild >>  0) & 0xFF;
+        inputs[i] = msg;
+    }
+    HMACSHA512Multi(output, chainCode.begin(), chainCode.size(), inputs.data(), lengths.data(), count);
+    // For hardened children every message holds a copy of the private key.
+    memory_cleanse(msgs.data(), msgs.size());
+}
+
 #define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
 
 #define SIPROUND do { \
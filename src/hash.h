@@ -193,6 +193,8 @@ uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
+/** BIP32Hash for the count consecutive children starting at nChildBegin, hashed together. output receives count * 64 bytes. */
+void BIP32HashMulti(const ChainCode &chainCode, unsigned int nChildBegin, unsigned int count, unsigned char header, const unsigned char data[32], unsigned char* output);
 
 /** SipHash-2-4 */
 class CSipHasher
@@ -273,6 +273,40 @@ bool CExtKey::Derive(CExtKey &out, unsigned int _nChild) const {
     return key.Derive(out.key, out.chaincode, _nChild, chaincode);
 }
 
+bool CExtKey::DeriveRange(std::vector<CExtKey>& out, unsigned int nChildBegin, unsigned int count) const {
+    assert(key.IsValid());
+    assert(key.IsCompressed());
+    assert(count == 0 || (nChildBegin >> 31) == ((nChildBegin + count - 1) >> 31));
+    std::vector<unsigned char, secure_allocator<unsigned char>> vout(64 * count);
+    std::vector<unsigned char, secure_allocator<unsigned char>> vchild(32);
+    CPubKey pubkey = key.GetPubKey();
+    if ((nChildBegin >> 31) == 0) {
+        assert(pubkey.size() == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE);
+        BIP32HashMulti(chaincode, nChildBegin, count, *pubkey.begin(), pubkey.begin()+1, vout.data());
+    } else {
+        assert(key.size() == 32);
+        BIP32HashMulti(chaincode, nChildBegin, count, 0, key.begin(), vout.data());
+    }
+    CKeyID id = pubkey.GetID();
+    bool ret = true;
+    out.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        CExtKey& child = out[i];
+        child.nDepth = nDepth + 1;
+        memcpy(&child.vchFingerprint[0], &id, 4);
+        child.nChild = nChildBegin + i;
+        memcpy(child.chaincode.begin(), vout.data() + 64 * i + 32, 32);
+        memcpy(vchild.data(), key.begin(), 32);
+        if (secp256k1_ec_privkey_tweak_add(secp256k1_context_sign, vchild.data(), vout.data() + 64 * i)) {
+            child.key.Set(vchild.begin(), vchild.end(), true);
+        } else {
+            child.key = CKey();
+            ret = false;
+        }
+    }
+    return ret;
+}
+
 void CExtKey::SetSeed(const unsigned char *seed, unsigned int nSeedLen) {
     static const unsigned char hashkey[] = {'B','i','t','c','o','i','n',' ','s','e','e','d'};
     std::vector<unsigned char, secure_allocator<unsigned char>> vout(64);
@@ -157,6 +157,8 @@ struct CExtKey {
     void Encode(unsigned char code[BIP32_EXTKEY_SIZE]) const;
     void Decode(const unsigned char code[BIP32_EXTKEY_SIZE]);
     bool Derive(CExtKey& out, unsigned int nChild) const;
+    //! Derive the count children starting at nChildBegin (all hardened or all not), hashing them together.
+    bool DeriveRange(std::vector<CExtKey>& out, unsigned int nChildBegin, unsigned int count) const;
     CExtPubKey Neuter() const;
     void SetSeed(const unsigned char* seed, unsigned int nSeedLen);
     template <typename Stream>
@@ -94,7 +94,7 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITEAS(CBlockHeader, *this);
-        READWRITE(vtx);
+        READWRITE(TransactionBatch(vtx));
     }
 
     void SetNull()
@@ -5,7 +5,9 @@
 
 #include <primitives/transaction.h>
 
+#include <crypto/sha256.h>
 #include <hash.h>
+#include <streams.h>
 #include <tinyformat.h>
 #include <utilstrencodings.h>
 
@@ -79,6 +81,61 @@ uint256 CTransaction::ComputeWitnessHash() const
 CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nLockTime(0), hash{}, m_witness_hash{} {}
 CTransaction::CTransaction(const CMutableTransaction& tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {}
 CTransaction::CTransaction(CMutableTransaction&& tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {}
+CTransaction::CTransaction(CMutableTransaction&& tx, const uint256& txid, const uint256& wtxid) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{txid}, m_witness_hash{wtxid} {}
+
+void ComputeTransactionHashes(const std::vector<CMutableTransaction>& txs, std::vector<uint256>& txids, std::vector<uint256>& wtxids)
+{
+    txids.clear();
+    wtxids.clear();
+    if (txs.empty()) return;
+
+    // Serialize everything into one buffer first (the same way SerializeHash
+    // would), then hash all serializations together.
+    std::vector<unsigned char> buffer;
+    std::vector<size_t> offsets;
+    std::vector<size_t> lengths;
+    std::vector<size_t> witness_msg(txs.size());
+    offsets.reserve(txs.size() + txs.size() / 2);
+    lengths.reserve(txs.size() + txs.size() / 2);
+    for (size_t i = 0; i < txs.size(); ++i) {
+        offsets.push_back(buffer.size());
+        CVectorWriter(SER_GETHASH, SERIALIZE_TRANSACTION_NO_WITNESS, buffer, buffer.size(), txs[i]);
+        lengths.push_back(buffer.size() - offsets.back());
+        witness_msg[i] = offsets.size() - 1;
+        if (txs[i].HasWitness()) {
+            offsets.push_back(buffer.size());
+            CVectorWriter(SER_GETHASH, 0, buffer, buffer.size(), txs[i]);
+            lengths.push_back(buffer.size() - offsets.back());
+            witness_msg[i] = offsets.size() - 1;
+        }
+    }
+    std::vector<const unsigned char*> inputs(offsets.size());
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        inputs[i] = buffer.data() + offsets[i];
+    }
+    std::vector<uint256> hashes(offsets.size());
+    SHA256DMultiBuffer(hashes[0].begin(), inputs.data(), lengths.data(), inputs.size());
+
+    txids.resize(txs.size());
+    wtxids.resize(txs.size());
+    for (size_t i = 0, msg = 0; i < txs.size(); ++i) {
+        txids[i] = hashes[msg];
+        wtxids[i] = hashes[witness_msg[i]];
+        msg = witness_msg[i] + 1;
+    }
+}
+
+std::vector<CTransactionRef> MakeTransactionRefs(std::vector<CMutableTransaction>&& txs)
+{
+    std::vector<uint256> txids, wtxids;
+    ComputeTransactionHashes(txs, txids, wtxids);
+    std::vector<CTransactionRef> ret;
+    ret.reserve(txs.size());
+    for (size_t i = 0; i < txs.size(); ++i) {
+        ret.push_back(std::make_shared<const CTransaction>(std::move(txs[i]), txids[i], wtxids[i]));
+    }
+    return ret;
+}
 
 CAmount CTransaction::GetValueOut() const
 {
@@ -299,6 +299,10 @@ public:
     CTransaction(const CMutableTransaction &tx);
     CTransaction(CMutableTransaction &&tx);
 
+    /** Convert a CMutableTransaction into a CTransaction, with its txid and
+     *  wtxid already computed (see ComputeTransactionHashes). */
+    CTransaction(CMutableTransaction &&tx, const uint256& txid, const uint256& wtxid);
+
     template <typename Stream>
     inline void Serialize(Stream& s) const {
         SerializeTransaction(*this, s);
@@ -408,4 +412,42 @@ typedef std::shared_ptr<const CTransaction> CTransactionRef;
 static inline CTransactionRef MakeTransactionRef() { return std::make_shared<const CTransaction>(); }
 template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
 
+/** Compute the txids and wtxids of a batch of transactions together, using
+ *  multi-buffer SHA256 so that several transactions are hashed at once. */
+void ComputeTransactionHashes(const std::vector<CMutableTransaction>& txs, std::vector<uint256>& txids, std::vector<uint256>& wtxids);
+
+/** Convert a batch of CMutableTransactions into CTransactionRefs, hashing them together. */
+std::vector<CTransactionRef> MakeTransactionRefs(std::vector<CMutableTransaction>&& txs);
+
+/**
+ * Serialization wrapper for a vector of transactions, such as those of a block.
+ * Deserialization reads all transactions first and then computes their txids
+ * and wtxids in one batch; serialization is identical to the plain vector.
+ */
+class TransactionBatch
+{
+private:
+    std::vector<CTransactionRef>& vtx;
+
+public:
+    explicit TransactionBatch(std::vector<CTransactionRef>& vtxIn) : vtx(vtxIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        s << vtx;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        std::vector<CMutableTransaction> txs;
+        uint64_t nSize = ReadCompactSize(s);
+        // Grow the vector as transactions are actually read, rather than
+        // trusting the size prefix.
+        while (txs.size() < nSize) {
+            txs.emplace_back(deserialize, s);
+        }
+        vtx = MakeTransactionRefs(std::move(txs));
+    }
+};
+
 #endif // BITCOIN_PRIMITIVES_TRANSACTION_H
@@ -167,13 +167,30 @@ static int ecdsa_signature_parse_der_lax(const secp256k1_context* ctx, secp256k1
 }
 
 bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchSig) const {
+    CParsedPubKey parsed;
+    if (!Parse(parsed)) {
+        return false;
+    }
+    return Verify(parsed, hash, vchSig);
+}
+
+static_assert(sizeof(CParsedPubKey) == sizeof(secp256k1_pubkey), "CParsedPubKey must match secp256k1_pubkey");
+
+bool CPubKey::Parse(CParsedPubKey& parsed) const {
     if (!IsValid())
         return false;
     secp256k1_pubkey pubkey;
-    secp256k1_ecdsa_signature sig;
     if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
         return false;
     }
+    memcpy(parsed.data, pubkey.data, sizeof(parsed.data));
+    return true;
+}
+
+bool CPubKey::Verify(const CParsedPubKey& parsed, const uint256 &hash, const std::vector<unsigned char>& vchSig) {
+    secp256k1_pubkey pubkey;
+    secp256k1_ecdsa_signature sig;
+    memcpy(pubkey.data, parsed.data, sizeof(pubkey.data));
     if (!ecdsa_signature_parse_der_lax(secp256k1_context_verify, &sig, vchSig.data(), vchSig.size())) {
         return false;
     }
@@ -271,6 +288,39 @@ bool CExtPubKey::Derive(CExtPubKey &out, unsigned int _nChild) const {
     return pubkey.Derive(out.pubkey, out.chaincode, _nChild, chaincode);
 }
 
+bool CExtPubKey::DeriveRange(std::vector<CExtPubKey>& out, unsigned int nChildBegin, unsigned int count) const {
+    assert(pubkey.IsValid());
+    assert(count == 0 || ((nChildBegin + count - 1) >> 31) == 0);
+    assert(pubkey.size() == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE);
+    std::vector<unsigned char> vout(64 * count);
+    BIP32HashMulti(chaincode, nChildBegin, count, *pubkey.begin(), pubkey.begin()+1, vout.data());
+    secp256k1_pubkey parent;
+    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &parent, pubkey.begin(), pubkey.size())) {
+        return false;
+    }
+    CKeyID id = pubkey.GetID();
+    bool ret = true;
+    out.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        CExtPubKey& child = out[i];
+        child.nDepth = nDepth + 1;
+        memcpy(&child.vchFingerprint[0], &id, 4);
+        child.nChild = nChildBegin + i;
+        memcpy(child.chaincode.begin(), vout.data() + 64 * i + 32, 32);
+        secp256k1_pubkey tweaked = parent;
+        if (!secp256k1_ec_pubkey_tweak_add(secp256k1_context_verify, &tweaked, vout.data() + 64 * i)) {
+            child.pubkey = CPubKey();
+            ret = false;
+            continue;
+        }
+        unsigned char pub[CPubKey::COMPRESSED_PUBLIC_KEY_SIZE];
+        size_t publen = CPubKey::COMPRESSED_PUBLIC_KEY_SIZE;
+        secp256k1_ec_pubkey_serialize(secp256k1_context_verify, pub, &publen, &tweaked, SECP256K1_EC_COMPRESSED);
+        child.pubkey.Set(pub, pub + publen);
+    }
+    return ret;
+}
+
 /* static */ bool CPubKey::CheckLowS(const std::vector<unsigned char>& vchSig) {
     secp256k1_ecdsa_signature sig;
     if (!ecdsa_signature_parse_der_lax(secp256k1_context_verify, &sig, vchSig.data(), vchSig.size())) {
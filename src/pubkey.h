@@ -26,6 +26,14 @@ public:
 
 typedef uint256 ChainCode;
 
+/** A public key in libsecp256k1's parsed (decompressed) form. Verifying
+ *  against it skips the parse, which for compressed keys includes a field
+ *  square root. The contents are only meaningful within this process. */
+struct CParsedPubKey
+{
+    unsigned char data[64];
+};
+
 /** An encapsulated public key. */
 class CPubKey
 {
@@ -187,6 +195,12 @@ public:
      */
     bool Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const;
 
+    //! Parse this public key for use with the static Verify below.
+    bool Parse(CParsedPubKey& parsed) const;
+
+    //! Verify a DER signature against an already parsed public key.
+    static bool Verify(const CParsedPubKey& parsed, const uint256& hash, const std::vector<unsigned char>& vchSig);
+
     /**
      * Check whether a signature is normalized (lower-S).
      */
@@ -221,6 +235,8 @@ struct CExtPubKey {
     void Encode(unsigned char code[BIP32_EXTKEY_SIZE]) const;
     void Decode(const unsigned char code[BIP32_EXTKEY_SIZE]);
     bool Derive(CExtPubKey& out, unsigned int nChild) const;
+    //! Derive the count (non-hardened) children starting at nChildBegin, hashing them together.
+    bool DeriveRange(std::vector<CExtPubKey>& out, unsigned int nChildBegin, unsigned int count) const;
 
     void Serialize(CSizeComputer& s) const
     {
@@ -24,6 +24,7 @@
 #include <txmempool.h>
 #include <util.h>
 #include <utilstrencodings.h>
+#include <utxosnapshot.h>
 #include <hash.h>
 #include <validationinterface.h>
 #include <warnings.h>
@@ -385,35 +386,31 @@ static std::string EntryDescriptionString()
            "       ... ]\n";
 }
 
-static void entryToJSON(UniValue &info, const CTxMemPoolEntry &e) EXCLUSIVE_LOCKS_REQUIRED(::mempool.cs)
+static void entryToJSON(UniValue &info, const CTxMemPoolSnapshot::Entry &e)
 {
-    AssertLockHeld(mempool.cs);
-
     UniValue fees(UniValue::VOBJ);
-    fees.pushKV("base", ValueFromAmount(e.GetFee()));
-    fees.pushKV("modified", ValueFromAmount(e.GetModifiedFee()));
-    fees.pushKV("ancestor", ValueFromAmount(e.GetModFeesWithAncestors()));
-    fees.pushKV("descendant", ValueFromAmount(e.GetModFeesWithDescendants()));
+    fees.pushKV("base", ValueFromAmount(e.nFee));
+    fees.pushKV("modified", ValueFromAmount(e.nModifiedFee));
+    fees.pushKV("ancestor", ValueFromAmount(e.nModFeesWithAncestors));
+    fees.pushKV("descendant", ValueFromAmount(e.nModFeesWithDescendants));
     info.pushKV("fees", fees);
 
-    info.pushKV("size", (int)e.GetTxSize());
-    info.pushKV("fee", ValueFromAmount(e.GetFee()));
-    info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
-    info.pushKV("time", e.GetTime());
-    info.pushKV("height", (int)e.GetHeight());
-    info.pushKV("descendantcount", e.GetCountWithDescendants());
-    info.pushKV("descendantsize", e.GetSizeWithDescendants());
-    info.pushKV("descendantfees", e.GetModFeesWithDescendants());
-    info.pushKV("ancestorcount", e.GetCountWithAncestors());
-    info.pushKV("ancestorsize", e.GetSizeWithAncestors());
-    info.pushKV("ancestorfees", e.GetModFeesWithAncestors());
-    info.pushKV("wtxid", mempool.vTxHashes[e.vTxHashesIdx].first.ToString());
-    const CTransaction& tx = e.GetTx();
+    info.pushKV("size", (int)e.nTxSize);
+    info.pushKV("fee", ValueFromAmount(e.nFee));
+    info.pushKV("modifiedfee", ValueFromAmount(e.nModifiedFee));
+    info.pushKV("time", e.nTime);
+    info.pushKV("height", (int)e.nHeight);
+    info.pushKV("descendantcount", e.nCountWithDescendants);
+    info.pushKV("descendantsize", e.nSizeWithDescendants);
+    info.pushKV("descendantfees", e.nModFeesWithDescendants);
+    info.pushKV("ancestorcount", e.nCountWithAncestors);
+    info.pushKV("ancestorsize", e.nSizeWithAncestors);
+    info.pushKV("ancestorfees", e.nModFeesWithAncestors);
+    info.pushKV("wtxid", e.wtxid.ToString());
     std::set<std::string> setDepends;
-    for (const CTxIn& txin : tx.vin)
+    for (const uint256& parent : e.vParents)
     {
-        if (mempool.exists(txin.prevout.hash))
-            setDepends.insert(txin.prevout.hash.ToString());
+        setDepends.insert(parent.ToString());
     }
 
     UniValue depends(UniValue::VARR);
@@ -425,10 +422,8 @@ static void entryToJSON(UniValue &info, const CTxMemPoolEntry &e) EXCLUSIVE_LOCK
     info.pushKV("depends", depends);
 
     UniValue spent(UniValue::VARR);
-    const CTxMemPool::txiter &it = mempool.mapTx.find(tx.GetHash());
-    const CTxMemPool::setEntries &setChildren = mempool.GetMemPoolChildren(it);
-    for (const CTxMemPool::txiter &childiter : setChildren) {
-        spent.push_back(childiter->GetTx().GetHash().ToString());
+    for (const uint256& child : e.vChildren) {
+        spent.push_back(child.ToString());
     }
 
     info.pushKV("spentby", spent);
@@ -438,14 +433,16 @@ UniValue mempoolToJSON(bool fVerbose)
 {
     if (fVerbose)
     {
-        LOCK(mempool.cs);
+        // Work from a snapshot, so that formatting a large mempool does not
+        // hold mempool.cs and block transaction acceptance or block connection.
+        std::shared_ptr<const CTxMemPoolSnapshot> snapshot = mempool.GetSnapshot();
         UniValue o(UniValue::VOBJ);
-        for (const CTxMemPoolEntry& e : mempool.mapTx)
+        for (const CTxMemPoolSnapshot::Entry& e : snapshot->entries)
         {
-            const uint256& hash = e.GetTx().GetHash();
             UniValue info(UniValue::VOBJ);
             entryToJSON(info, e);
-            o.pushKV(hash.ToString(), info);
+            // txids are unique, so skip pushKV's linear search for an existing key
+            o.__pushKV(e.GetHash().ToString(), info);
         }
         return o;
     }
@@ -526,33 +523,24 @@ static UniValue getmempoolancestors(const JSONRPCRequest& request)
 
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
 
-    LOCK(mempool.cs);
-
-    CTxMemPool::txiter it = mempool.mapTx.find(hash);
-    if (it == mempool.mapTx.end()) {
+    std::vector<CTxMemPoolSnapshot::Entry> ancestors;
+    if (!mempool.GetSnapshotAncestors(hash, ancestors)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
     }
 
-    CTxMemPool::setEntries setAncestors;
-    uint64_t noLimit = std::numeric_limits<uint64_t>::max();
-    std::string dummy;
-    mempool.CalculateMemPoolAncestors(*it, setAncestors, noLimit, noLimit, noLimit, noLimit, dummy, false);
-
     if (!fVerbose) {
         UniValue o(UniValue::VARR);
-        for (CTxMemPool::txiter ancestorIt : setAncestors) {
-            o.push_back(ancestorIt->GetTx().GetHash().ToString());
+        for (const CTxMemPoolSnapshot::Entry& e : ancestors) {
+            o.push_back(e.GetHash().ToString());
         }
 
         return o;
     } else {
         UniValue o(UniValue::VOBJ);
-        for (CTxMemPool::txiter ancestorIt : setAncestors) {
-            const CTxMemPoolEntry &e = *ancestorIt;
-            const uint256& _hash = e.GetTx().GetHash();
+        for (const CTxMemPoolSnapshot::Entry& e : ancestors) {
             UniValue info(UniValue::VOBJ);
             entryToJSON(info, e);
-            o.pushKV(_hash.ToString(), info);
+            o.__pushKV(e.GetHash().ToString(), info);
         }
         return o;
     }
@@ -590,33 +578,24 @@ static UniValue getmempooldescendants(const JSONRPCRequest& request)
 
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
 
-    LOCK(mempool.cs);
-
-    CTxMemPool::txiter it = mempool.mapTx.find(hash);
-    if (it == mempool.mapTx.end()) {
+    std::vector<CTxMemPoolSnapshot::Entry> descendants;
+    if (!mempool.GetSnapshotDescendants(hash, descendants)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
     }
 
-    CTxMemPool::setEntries setDescendants;
-    mempool.CalculateDescendants(it, setDescendants);
-    // CTxMemPool::CalculateDescendants will include the given tx
-    setDescendants.erase(it);
-
     if (!fVerbose) {
         UniValue o(UniValue::VARR);
-        for (CTxMemPool::txiter descendantIt : setDescendants) {
-            o.push_back(descendantIt->GetTx().GetHash().ToString());
+        for (const CTxMemPoolSnapshot::Entry& e : descendants) {
+            o.push_back(e.GetHash().ToString());
         }
 
         return o;
     } else {
         UniValue o(UniValue::VOBJ);
-        for (CTxMemPool::txiter descendantIt : setDescendants) {
-            const CTxMemPoolEntry &e = *descendantIt;
-            const uint256& _hash = e.GetTx().GetHash();
+        for (const CTxMemPoolSnapshot::Entry& e : descendants) {
             UniValue info(UniValue::VOBJ);
             entryToJSON(info, e);
-            o.pushKV(_hash.ToString(), info);
+            o.__pushKV(e.GetHash().ToString(), info);
         }
         return o;
     }
@@ -642,14 +621,12 @@ static UniValue getmempoolentry(const JSONRPCRequest& request)
 
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
 
-    LOCK(mempool.cs);
-
-    CTxMemPool::txiter it = mempool.mapTx.find(hash);
-    if (it == mempool.mapTx.end()) {
+    // A single entry is cheaper to copy on its own than to take a full snapshot.
+    CTxMemPoolSnapshot::Entry e;
+    if (!mempool.GetSnapshotEntry(hash, e)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
     }
 
-    const CTxMemPoolEntry &e = *it;
     UniValue info(UniValue::VOBJ);
     entryToJSON(info, e);
     return info;
@@ -847,6 +824,7 @@ struct CCoinsStats
     uint64_t nTransactionOutputs;
     uint64_t nBogoSize;
     uint256 hashSerialized;
+    uint256 hashMuHash;
     uint64_t nDiskSize;
     CAmount nTotalAmount;
 
@@ -878,6 +856,7 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
     assert(pcursor);
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    CRollingCoinsStats rolling;
     stats.hashBlock = pcursor->GetBestBlock();
     {
         LOCK(cs_main);
@@ -896,6 +875,7 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
                 outputs.clear();
             }
             prevkey = key.hash;
+            rolling.Add(key, coin);
             outputs[key.n] = std::move(coin);
         } else {
             return error("%s: unable to read value", __func__);
@@ -906,10 +886,29 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
         ApplyStats(stats, ss, prevkey, outputs);
     }
     stats.hashSerialized = ss.GetHash();
+    rolling.muhash.Finalize(stats.hashMuHash.begin());
     stats.nDiskSize = view->EstimateSize();
     return true;
 }
 
+//! Read the statistics the coins views keep up to date, without a scan
+static bool GetRollingUTXOStats(CCoinsStats &stats)
+{
+    CRollingCoinsStats rolling;
+    {
+        LOCK(cs_main);
+        if (!pcoinsTip->GetRollingStats(rolling)) return false;
+        stats.hashBlock = pcoinsTip->GetBestBlock();
+        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
+    }
+    stats.nTransactionOutputs = rolling.nTransactionOutputs;
+    stats.nBogoSize = rolling.nBogoSize;
+    stats.nTotalAmount = rolling.nTotalAmount;
+    rolling.muhash.Finalize(stats.hashMuHash.begin());
+    stats.nDiskSize = pcoinsdbview->EstimateSize();
+    return true;
+}
+
 static UniValue pruneblockchain(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -961,30 +960,49 @@ static UniValue pruneblockchain(const JSONRPCRequest& request)
 
 static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( full_scan )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "These are kept up to date as blocks are connected, unless the chainstate predates them\n"
+            "(restart with -reindex-chainstate to build them). Otherwise, or with full_scan, the\n"
+            "whole set is read, which may take some time.\n"
+            "\nArguments:\n"
+            "1. full_scan    (boolean, optional, default=false) Compute the statistics from a scan of the set\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) The hash of the block at the tip of the chain\n"
-            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
+            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs (scan only)\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (scan only)\n"
+            "  \"muhash\": \"hash\",      (string) The MuHash3072 of the set\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "true")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    bool full_scan = !request.params[0].isNull() && request.params[0].get_bool();
+
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
+    if (!full_scan && GetRollingUTXOStats(stats)) {
+        ret.pushKV("height", (int64_t)stats.nHeight);
+        ret.pushKV("bestblock", stats.hashBlock.GetHex());
+        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+        ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+        ret.pushKV("muhash", stats.hashMuHash.GetHex());
+        ret.pushKV("disk_size", stats.nDiskSize);
+        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+        return ret;
+    }
+
     FlushStateToDisk();
     if (GetUTXOStats(pcoinsdbview.get(), stats)) {
         ret.pushKV("height", (int64_t)stats.nHeight);
@@ -993,6 +1011,7 @@ static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
         ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
         ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
         ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+        ret.pushKV("muhash", stats.hashMuHash.GetHex());
         ret.pushKV("disk_size", stats.nDiskSize);
         ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
     } else {
@@ -1926,6 +1945,107 @@ static UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue SnapshotInfoToJSON(const SnapshotInfo& info, const fs::path& path)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("base_hash", info.base_blockhash.GetHex());
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = LookupBlockIndex(info.base_blockhash);
+        if (pindex) ret.pushKV("base_height", pindex->nHeight);
+    }
+    ret.pushKV("coins", info.coins_count);
+    ret.pushKV("hash", info.hash.GetHex());
+    ret.pushKV("size", info.nBytes);
+    ret.pushKV("path", path.string());
+    return ret;
+}
+
+static UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the UTXO set at the current tip to a snapshot file for loadtxoutset.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) path of the new snapshot file, relative to the data directory if not absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"base_hash\": \"hex\",     (string) the block the snapshot is based on\n"
+            "  \"base_height\": n,       (numeric) its height\n"
+            "  \"coins\": n,             (numeric) the number of coins in the snapshot\n"
+            "  \"hash\": \"hex\",          (string) the hash committing to the snapshot file\n"
+            "  \"size\": n,              (numeric) the size of the snapshot file in bytes\n"
+            "  \"path\": \"path\"          (string) the absolute path of the snapshot file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+    }
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    }
+
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    {
+        // Holding cs_main keeps a flush from running between the two calls;
+        // the cursor then reads a consistent view of the database.
+        LOCK(cs_main);
+        FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->Cursor());
+    }
+
+    SnapshotInfo info;
+    std::string error;
+    if (!DumpSnapshot(pcursor.get(), Params().MessageStart(), path, info, error)) {
+        throw JSONRPCError(RPC_MISC_ERROR, error);
+    }
+    return SnapshotInfoToJSON(info, path);
+}
+
+static UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nLoad a UTXO snapshot written by dumptxoutset and make its base block the chain tip.\n"
+            "The chainstate must be empty and the headers up to the base block must have been received.\n"
+            "The snapshot hash must match the one this network lists for the base block; regtest accepts any snapshot.\n"
+            "Blocks up to the base are not downloaded afterwards, and the node stops serving historical blocks on restart.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) path of the snapshot file, relative to the data directory if not absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"base_hash\": \"hex\",     (string) the block the snapshot is based on\n"
+            "  \"base_height\": n,       (numeric) its height\n"
+            "  \"coins\": n,             (numeric) the number of coins loaded\n"
+            "  \"hash\": \"hex\",          (string) the hash committing to the snapshot file\n"
+            "  \"size\": n,              (numeric) the size of the snapshot file in bytes\n"
+            "  \"path\": \"path\"          (string) the absolute path of the snapshot file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+        );
+    }
+
+    if (g_txindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "loadtxoutset is not supported with -txindex");
+    }
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    SnapshotInfo info;
+    std::string error;
+    if (!LoadSnapshotChainstate(path, Params(), info, error)) {
+        throw JSONRPCError(RPC_MISC_ERROR, error);
+    }
+    return SnapshotInfoToJSON(info, path);
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
@@ -1945,9 +2065,11 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"full_scan"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           {"path"} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
@@ -16,7 +16,9 @@
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
+#include <script/sigcache.h>
 #include <timedata.h>
+#include <txdb.h>
 #include <util.h>
 #include <utilstrencodings.h>
 #ifdef ENABLE_WALLET
@@ -280,6 +282,63 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCPubKeyCacheInfo()
+{
+    PubKeyCacheStats stats = GetPubKeyCacheStats();
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("hits", stats.hits);
+    obj.pushKV("misses", stats.misses);
+    obj.pushKV("entries", uint64_t(stats.entries));
+    obj.pushKV("capacity", uint64_t(stats.capacity));
+    obj.pushKV("usage", uint64_t(stats.usage));
+    return obj;
+}
+
+static UniValue RPCBlockIndexMemoryInfo()
+{
+    BlockIndexMemoryStats stats;
+    {
+        LOCK(cs_main);
+        stats = GetBlockIndexMemoryStats();
+    }
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("entries", uint64_t(stats.entries));
+    obj.pushKV("index_usage", uint64_t(stats.index_usage));
+    obj.pushKV("map_usage", uint64_t(stats.map_usage));
+    obj.pushKV("map_saved", int64_t(stats.node_map_usage) - int64_t(stats.map_usage));
+    return obj;
+}
+
+static UniValue RPCCoinsCacheInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    CoinsFlushStats stats;
+    {
+        LOCK(cs_main);
+        if (!pcoinsTip || !pcoinsflushview) return obj;
+        obj.pushKV("entries", uint64_t(pcoinsTip->GetCacheSize()));
+        obj.pushKV("usage", uint64_t(pcoinsTip->DynamicMemoryUsage()));
+        const uint64_t hits = pcoinsTip->GetCacheHits();
+        const uint64_t misses = pcoinsTip->GetCacheMisses();
+        obj.pushKV("hits", hits);
+        obj.pushKV("misses", misses);
+        obj.pushKV("hit_rate", hits + misses > 0 ? double(hits) / (hits + misses) : 0.0);
+        obj.pushKV("kept", uint64_t(pcoinsTip->GetKeptSize()));
+        stats = pcoinsflushview->GetStats();
+    }
+    UniValue flush(UniValue::VOBJ);
+    flush.pushKV("count", stats.count);
+    flush.pushKV("coins", stats.coins);
+    flush.pushKV("in_progress", stats.in_progress);
+    flush.pushKV("snapshot_usage", uint64_t(stats.snapshot_usage));
+    flush.pushKV("last_ms", stats.last_duration / 1000);
+    flush.pushKV("total_ms", stats.total_duration / 1000);
+    flush.pushKV("wait_ms", stats.total_wait / 1000);
+    flush.pushKV("saved_ms", std::max<int64_t>(stats.total_duration - stats.total_wait, 0) / 1000);
+    obj.pushKV("flush", flush);
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -321,6 +380,37 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"pubkeycache\": {          (json object) Information about the parsed public key cache used in script verification\n"
+            "    \"hits\": xxxxx,          (numeric) Number of keys found already parsed\n"
+            "    \"misses\": xxxxx,        (numeric) Number of keys that had to be parsed\n"
+            "    \"entries\": xxxxx,       (numeric) Number of cached keys\n"
+            "    \"capacity\": xxxxx,      (numeric) Maximum number of cached keys\n"
+            "    \"usage\": xxxxx,         (numeric) Memory used by the cache in bytes\n"
+            "  },\n"
+            "  \"blockindex\": {           (json object) Information about the block index\n"
+            "    \"entries\": xxxxx,       (numeric) Number of block headers known\n"
+            "    \"index_usage\": xxxxx,   (numeric) Bytes used by the entries\n"
+            "    \"map_usage\": xxxxx,     (numeric) Bytes used by the hash index over the entries\n"
+            "    \"map_saved\": xxxxx,     (numeric) Estimated bytes saved by the hash index compared to a node-based hash map\n"
+            "  },\n"
+            "  \"coinscache\": {           (json object) Information about the UTXO cache\n"
+            "    \"entries\": xxxxx,       (numeric) Number of cached coins\n"
+            "    \"usage\": xxxxx,         (numeric) Memory used by the cache in bytes\n"
+            "    \"hits\": xxxxx,          (numeric) Number of lookups answered from the cache\n"
+            "    \"misses\": xxxxx,        (numeric) Number of lookups passed on to the chainstate database\n"
+            "    \"hit_rate\": x.xxx,      (numeric) Fraction of lookups answered from the cache\n"
+            "    \"kept\": xxxxx,          (numeric) Number of recently used coins the last flush kept in the cache (see -dbcachekeep)\n"
+            "    \"flush\": {              (json object) Flushes of the cache to the chainstate database\n"
+            "      \"count\": xxxxx,       (numeric) Number of completed flushes\n"
+            "      \"coins\": xxxxx,       (numeric) Number of cache entries they wrote\n"
+            "      \"in_progress\": true|false, (boolean) Whether a flush is being written in the background\n"
+            "      \"snapshot_usage\": xxxxx, (numeric) Bytes held by the entries of that flush\n"
+            "      \"last_ms\": xxxxx,     (numeric) Duration of the last flush in milliseconds\n"
+            "      \"total_ms\": xxxxx,    (numeric) Duration of all flushes in milliseconds\n"
+            "      \"wait_ms\": xxxxx,     (numeric) Milliseconds validation was blocked by flushes\n"
+            "      \"saved_ms\": xxxxx,    (numeric) Milliseconds of flushing that overlapped with validation (see -backgroundflush)\n"
+            "    }\n"
             "  }\n"
             "}\n"
             "\nResult (mode \"mallocinfo\"):\n"
@@ -334,6 +424,9 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("pubkeycache", RPCPubKeyCacheInfo());
+        obj.pushKV("blockindex", RPCBlockIndexMemoryInfo());
+        obj.pushKV("coinscache", RPCCoinsCacheInfo());
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
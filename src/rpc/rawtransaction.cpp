@@ -252,7 +252,7 @@ static UniValue gettxoutproof(const JSONRPCRequest& request)
 
         // Loop through txids and try to find which block they're in. Exit loop once a block is found.
         for (const auto& tx : setTxids) {
-            const Coin& coin = AccessByTxid(*pcoinsTip, tx);
+            const Coin coin = AccessByTxid(*pcoinsTip, tx);
             if (!coin.IsSpent()) {
                 pblockindex = chainActive[coin.nHeight];
                 break;
@@ -720,7 +720,7 @@ static UniValue combinerawtransaction(const JSONRPCRequest& request)
         view.SetBackend(viewMempool); // temporarily switch cache backend to db+mempool view
 
         for (const CTxIn& txin : mergedTx.vin) {
-            view.AccessCoin(txin.prevout); // Load entries from viewChain into view; can fail.
+            view.HaveCoin(txin.prevout); // Load entries from viewChain into view; can fail.
         }
 
         view.SetBackend(viewDummy); // switch back to avoid locking mempool for too long
@@ -732,7 +732,7 @@ static UniValue combinerawtransaction(const JSONRPCRequest& request)
     // Sign what we can:
     for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
         CTxIn& txin = mergedTx.vin[i];
-        const Coin& coin = view.AccessCoin(txin.prevout);
+        const Coin coin = view.AccessCoin(txin.prevout);
         if (coin.IsSpent()) {
             throw JSONRPCError(RPC_VERIFY_ERROR, "Input not found or already spent");
         }
@@ -766,7 +766,7 @@ UniValue SignTransaction(CMutableTransaction& mtx, const UniValue& prevTxsUnival
         view.SetBackend(viewMempool); // temporarily switch cache backend to db+mempool view
 
         for (const CTxIn& txin : mtx.vin) {
-            view.AccessCoin(txin.prevout); // Load entries from viewChain into view; can fail.
+            view.HaveCoin(txin.prevout); // Load entries from viewChain into view; can fail.
         }
 
         view.SetBackend(viewDummy); // switch back to avoid locking mempool for too long
@@ -802,7 +802,7 @@ UniValue SignTransaction(CMutableTransaction& mtx, const UniValue& prevTxsUnival
             CScript scriptPubKey(pkData.begin(), pkData.end());
 
             {
-                const Coin& coin = view.AccessCoin(out);
+                const Coin coin = view.AccessCoin(out);
                 if (!coin.IsSpent() && coin.out.scriptPubKey != scriptPubKey) {
                     std::string err("Previous output scriptPubKey mismatch:\n");
                     err = err + ScriptToAsmStr(coin.out.scriptPubKey) + "\nvs:\n"+
@@ -867,7 +867,7 @@ UniValue SignTransaction(CMutableTransaction& mtx, const UniValue& prevTxsUnival
     // Sign what we can:
     for (unsigned int i = 0; i < mtx.vin.size(); i++) {
         CTxIn& txin = mtx.vin[i];
-        const Coin& coin = view.AccessCoin(txin.prevout);
+        const Coin coin = view.AccessCoin(txin.prevout);
         if (coin.IsSpent()) {
             TxInErrorToJSON(txin, vErrors, "Input not found or already spent");
             continue;
@@ -1128,7 +1128,7 @@ static UniValue sendrawtransaction(const JSONRPCRequest& request)
     CCoinsViewCache &view = *pcoinsTip;
     bool fHaveChain = false;
     for (size_t o = 0; !fHaveChain && o < tx->vout.size(); o++) {
-        const Coin& existingCoin = view.AccessCoin(COutPoint(hashTx, o));
+        const Coin existingCoin = view.AccessCoin(COutPoint(hashTx, o));
         fHaveChain = !existingCoin.IsSpent();
     }
     bool fHaveMempool = mempool.exists(hashTx);
@@ -1180,6 +1180,174 @@ static UniValue sendrawtransaction(const JSONRPCRequest& request)
     return hashTx.GetHex();
 }
 
+/**
+ * Order a batch of transactions so that each one comes after the transactions
+ * of the batch it spends from, otherwise keeping the order they were given in.
+ * Returns indices into txs.
+ */
+static std::vector<size_t> SortTransactionsTopologically(const std::vector<CTransactionRef>& txs)
+{
+    std::map<uint256, size_t> index;
+    for (size_t i = 0; i < txs.size(); ++i) {
+        index.emplace(txs[i]->GetHash(), i);
+    }
+
+    std::vector<size_t> num_parents(txs.size(), 0);
+    std::vector<std::vector<size_t>> children(txs.size());
+    for (size_t i = 0; i < txs.size(); ++i) {
+        std::set<size_t> parents;
+        for (const CTxIn& txin : txs[i]->vin) {
+            auto it = index.find(txin.prevout.hash);
+            if (it != index.end() && it->second != i) {
+                parents.insert(it->second);
+            }
+        }
+        num_parents[i] = parents.size();
+        for (size_t parent : parents) {
+            children[parent].push_back(i);
+        }
+    }
+
+    std::vector<size_t> order;
+    order.reserve(txs.size());
+    std::set<size_t> ready;
+    for (size_t i = 0; i < txs.size(); ++i) {
+        if (num_parents[i] == 0) ready.insert(i);
+    }
+    while (!ready.empty()) {
+        const size_t i = *ready.begin();
+        ready.erase(ready.begin());
+        order.push_back(i);
+        for (size_t child : children[i]) {
+            if (--num_parents[child] == 0) ready.insert(child);
+        }
+    }
+    return order;
+}
+
+static UniValue sendrawtransactions(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        throw std::runtime_error(
+            // clang-format off
+            "sendrawtransactions [\"rawtxs\"] ( allowhighfees )\n"
+            "\nSubmits a batch of raw transactions (serialized, hex-encoded) to local node and network.\n"
+            "\nThe transactions are validated together, parents before children whatever their order\n"
+            "in the array, and the accepted ones are announced to peers at once.\n"
+            "\nSee sendrawtransaction call.\n"
+            "\nArguments:\n"
+            "1. [\"rawtxs\"]       (array, required) An array of hex strings of raw transactions.\n"
+            "                      At most " + std::to_string(MAX_MEMPOOL_BATCH_SIZE) + " transactions per call.\n"
+            "2. allowhighfees    (boolean, optional, default=false) Allow high fees\n"
+            "\nResult:\n"
+            "[                   (array) The result for each raw transaction in the input array, in the same order.\n"
+            " {\n"
+            "  \"txid\"           (string) The transaction hash in hex\n"
+            "  \"accepted\"       (boolean) If the transaction is in the mempool\n"
+            "  \"reject-reason\"  (string) Rejection string (only present when 'accepted' is false)\n"
+            " }\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("sendrawtransactions", "\"[\\\"signedhex1\\\",\\\"signedhex2\\\"]\"") +
+            "\nAs a json rpc call\n"
+            + HelpExampleRpc("sendrawtransactions", "[\"signedhex1\",\"signedhex2\"]")
+            // clang-format on
+            );
+    }
+
+    RPCTypeCheck(request.params, {UniValue::VARR, UniValue::VBOOL});
+    const UniValue& rawtxs = request.params[0].get_array();
+    if (rawtxs.size() > MAX_MEMPOOL_BATCH_SIZE) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Array must contain at most %u raw transactions", MAX_MEMPOOL_BATCH_SIZE));
+    }
+
+    std::vector<CTransactionRef> txs;
+    txs.reserve(rawtxs.size());
+    for (size_t i = 0; i < rawtxs.size(); ++i) {
+        CMutableTransaction mtx;
+        if (!DecodeHexTx(mtx, rawtxs[i].get_str())) {
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("TX decode failed for transaction %u", i));
+        }
+        txs.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+
+    CAmount max_raw_tx_fee = ::maxTxFee;
+    if (!request.params[1].isNull() && request.params[1].get_bool()) {
+        max_raw_tx_fee = 0;
+    }
+
+    const std::vector<size_t> order = SortTransactionsTopologically(txs);
+    std::vector<UniValue> results(txs.size());
+    std::vector<uint256> relay;
+    std::promise<void> promise;
+
+    { // cs_main scope
+    LOCK(cs_main);
+    std::vector<CTransactionRef> sorted;
+    sorted.reserve(order.size());
+    for (size_t i : order) {
+        sorted.push_back(txs[i]);
+    }
+    PreverifyMempoolScripts(mempool, sorted);
+
+    for (size_t i : order) {
+        const CTransactionRef& tx = txs[i];
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("txid", tx->GetHash().GetHex());
+
+        // As with sendrawtransaction, a transaction already in the mempool
+        // is announced again.
+        CValidationState state;
+        bool missing_inputs = false;
+        const bool accepted = mempool.exists(tx->GetHash()) ||
+            AcceptToMemoryPool(mempool, state, tx, &missing_inputs, nullptr /* plTxnReplaced */, false /* bypass_limits */, max_raw_tx_fee);
+        result.pushKV("accepted", accepted);
+        if (!accepted) {
+            if (state.IsInvalid()) {
+                result.pushKV("reject-reason", strprintf("%i: %s", state.GetRejectCode(), state.GetRejectReason()));
+            } else if (missing_inputs) {
+                result.pushKV("reject-reason", "missing-inputs");
+            } else {
+                result.pushKV("reject-reason", state.GetRejectReason());
+            }
+        }
+        results[i] = std::move(result);
+    }
+
+    // A later transaction of the batch may have replaced an earlier one or
+    // pushed it out of a full mempool, so only announce what is still there.
+    std::set<uint256> announced;
+    for (size_t i : order) {
+        const uint256& hash = txs[i]->GetHash();
+        if (mempool.exists(hash) && announced.insert(hash).second) {
+            relay.push_back(hash);
+        }
+    }
+
+    // Let the wallet see the accepted transactions before returning, see
+    // sendrawtransaction.
+    CallFunctionInValidationInterfaceQueue([&promise] {
+        promise.set_value();
+    });
+    } // cs_main
+
+    promise.get_future().wait();
+
+    if (!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    g_connman->ForEachNode([&relay](CNode* pnode)
+    {
+        for (const uint256& hash : relay) {
+            pnode->PushInventory(CInv(MSG_TX, hash));
+        }
+    });
+
+    UniValue ret(UniValue::VARR);
+    ret.push_backV(results);
+    return ret;
+}
+
 static UniValue testmempoolaccept(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
@@ -1267,6 +1435,7 @@ static const CRPCCommand commands[] =
     { "rawtransactions",    "decoderawtransaction",         &decoderawtransaction,      {"hexstring","iswitness"} },
     { "rawtransactions",    "decodescript",                 &decodescript,              {"hexstring"} },
     { "rawtransactions",    "sendrawtransaction",           &sendrawtransaction,        {"hexstring","allowhighfees"} },
+    { "rawtransactions",    "sendrawtransactions",          &sendrawtransactions,       {"rawtxs","allowhighfees"} },
     { "rawtransactions",    "combinerawtransaction",        &combinerawtransaction,     {"txs"} },
     { "rawtransactions",    "signrawtransaction",           &signrawtransaction,        {"hexstring","prevtxs","privkeys","sighashtype"} }, /* uses wallet if enabled */
     { "rawtransactions",    "signrawtransactionwithkey",    &signrawtransactionwithkey, {"hexstring","privkeys","prevtxs","sighashtype"} },
@@ -10,6 +10,7 @@
 #include <crypto/sha256.h>
 #include <pubkey.h>
 #include <script/script.h>
+#include <streams.h>
 #include <uint256.h>
 
 typedef std::vector<unsigned char> valtype;
@@ -1212,6 +1213,93 @@ uint256 GetOutputsHash(const T& txTo)
     return ss.GetHash();
 }
 
+template <class T>
+void InitLegacySighashCache(LegacySighashCache& cache, const T& txTo)
+{
+    const size_t nInputs = txTo.vin.size();
+    cache.inputs.reserve(nInputs * LegacySighashCache::INPUT_SIZE);
+    CVectorWriter inputs(SER_GETHASH, 0, cache.inputs, 0);
+    for (const auto& txin : txTo.vin) {
+        inputs << txin.prevout << CScript() << txin.nSequence;
+    }
+    assert(cache.inputs.size() == nInputs * LegacySighashCache::INPUT_SIZE);
+
+    CVectorWriter outputs(SER_GETHASH, 0, cache.outputs, 0);
+    outputs << txTo.vout;
+
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << txTo.nVersion;
+    ::WriteCompactSize(ss, nInputs);
+    cache.midstates.reserve(nInputs);
+    for (size_t i = 0; i < nInputs; i++) {
+        cache.midstates.push_back(ss);
+        ss.write((const char*)&cache.inputs[i * LegacySighashCache::INPUT_SIZE], LegacySighashCache::INPUT_SIZE);
+    }
+}
+
+/** Write blanked inputs [begin, end) from the cache, zeroing their nSequence if requested. */
+void WriteCachedInputs(CHashWriter& ss, const LegacySighashCache& cache, size_t begin, size_t end, bool fZeroSequence)
+{
+    static const unsigned char zero[4] = {};
+    const size_t size = LegacySighashCache::INPUT_SIZE;
+    if (!fZeroSequence) {
+        if (end > begin) ss.write((const char*)&cache.inputs[begin * size], (end - begin) * size);
+        return;
+    }
+    for (size_t i = begin; i < end; i++) {
+        ss.write((const char*)&cache.inputs[i * size], size - sizeof(zero));
+        ss.write((const char*)zero, sizeof(zero));
+    }
+}
+
+/**
+ * Legacy signature hash using a LegacySighashCache. Produces the same result
+ * as hashing CTransactionSignatureSerializer, but only the input being signed
+ * (and for SIGHASH_SINGLE, the outputs up to it) is serialized.
+ */
+template <class T>
+uint256 CachedLegacySignatureHash(const CScript& scriptCode, const T& txTo, unsigned int nIn, int nHashType, const LegacySighashCache& cache)
+{
+    const bool fAnyoneCanPay = !!(nHashType & SIGHASH_ANYONECANPAY);
+    const bool fHashSingle = (nHashType & 0x1f) == SIGHASH_SINGLE;
+    const bool fHashNone = (nHashType & 0x1f) == SIGHASH_NONE;
+    const bool fZeroSequence = fHashSingle || fHashNone;
+    CTransactionSignatureSerializer<T> txTmp(txTo, scriptCode, nIn, nHashType);
+
+    // nVersion and the inputs before the one being signed
+    const bool fMidstate = !fAnyoneCanPay && !fZeroSequence;
+    CHashWriter ss = fMidstate ? cache.midstates[nIn] : CHashWriter(SER_GETHASH, 0);
+    if (fAnyoneCanPay) {
+        ss << txTo.nVersion;
+        ::WriteCompactSize(ss, 1);
+    } else if (fZeroSequence) {
+        ss << txTo.nVersion;
+        ::WriteCompactSize(ss, txTo.vin.size());
+        WriteCachedInputs(ss, cache, 0, nIn, true);
+    }
+
+    // The input being signed, and the ones after it
+    txTmp.SerializeInput(ss, nIn);
+    if (!fAnyoneCanPay) {
+        WriteCachedInputs(ss, cache, nIn + 1, txTo.vin.size(), fZeroSequence);
+    }
+
+    // Outputs
+    if (fHashNone) {
+        ::WriteCompactSize(ss, 0);
+    } else if (fHashSingle) {
+        ::WriteCompactSize(ss, nIn + 1);
+        for (unsigned int nOutput = 0; nOutput <= nIn; nOutput++) {
+            txTmp.SerializeOutput(ss, nOutput);
+        }
+    } else {
+        ss.write((const char*)cache.outputs.data(), cache.outputs.size());
+    }
+
+    ss << txTo.nLockTime << nHashType;
+    return ss.GetHash();
+}
+
 } // namespace
 
 template <class T>
@@ -1224,6 +1312,15 @@ PrecomputedTransactionData::PrecomputedTransactionData(const T& txTo)
         hashOutputs = GetOutputsHash(txTo);
         ready = true;
     }
+    // The legacy cache only pays off once more than one input (those without
+    // a witness) needs a legacy signature hash. It is built on first use.
+    size_t nLegacyInputs = 0;
+    for (const auto& txin : txTo.vin) {
+        if (txin.scriptWitness.IsNull()) nLegacyInputs++;
+    }
+    if (nLegacyInputs > 1) {
+        legacy.reset(new LazyLegacySighashCache());
+    }
 }
 
 // explicit instantiation
@@ -1291,6 +1388,12 @@ uint256 SignatureHash(const CScript& scriptCode, const T& txTo, unsigned int nIn
         }
     }
 
+    if (cache && cache->legacy) {
+        LazyLegacySighashCache& legacy = *cache->legacy;
+        std::call_once(legacy.init, [&legacy, &txTo] { InitLegacySighashCache(legacy.cache, txTo); });
+        return CachedLegacySignatureHash(scriptCode, txTo, nIn, nHashType, legacy.cache);
+    }
+
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer<T> txTmp(txTo, scriptCode, nIn, nHashType);
 
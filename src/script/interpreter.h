@@ -6,9 +6,12 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include <hash.h>
 #include <script/script_error.h>
 #include <primitives/transaction.h>
 
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <stdint.h>
 #include <string>
@@ -119,10 +122,45 @@ enum
 
 bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror);
 
+/**
+ * Reusable parts of the legacy (pre-segwit) signature hash of a transaction.
+ *
+ * The legacy sighash serializes every input and output for every input being
+ * signed. Everything except the input being signed is identical between those
+ * serializations, so the blanked inputs and the outputs are serialized once,
+ * and the SHA256 state after each SIGHASH_ALL input prefix is kept.
+ */
+struct LegacySighashCache
+{
+    /** Size of a blanked input: prevout, empty scriptSig and nSequence. */
+    static constexpr size_t INPUT_SIZE = 36 + 1 + 4;
+
+    /** midstates[i]: hasher fed with nVersion, the input count and blanked inputs [0, i). */
+    std::vector<CHashWriter> midstates;
+    /** All blanked inputs back to back, INPUT_SIZE bytes each. */
+    std::vector<unsigned char> inputs;
+    /** The output count and all outputs, as serialized for SIGHASH_ALL. */
+    std::vector<unsigned char> outputs;
+};
+
+/**
+ * A LegacySighashCache that is only filled in by the first signature hash that
+ * needs it, so that transactions whose scripts are never run (assumevalid,
+ * script execution cache hits) don't pay for it. Script check threads of the
+ * same transaction may race for it, hence the once_flag.
+ */
+struct LazyLegacySighashCache
+{
+    std::once_flag init;
+    LegacySighashCache cache;
+};
+
 struct PrecomputedTransactionData
 {
     uint256 hashPrevouts, hashSequence, hashOutputs;
     bool ready = false;
+    //! Only set for transactions with more than one input without a witness.
+    std::unique_ptr<LazyLegacySighashCache> legacy;
 
     template <class T>
     explicit PrecomputedTransactionData(const T& tx);
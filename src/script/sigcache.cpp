@@ -14,6 +14,10 @@
 #include <cuckoocache.h>
 #include <boost/thread.hpp>
 
+#include <array>
+#include <atomic>
+#include <mutex>
+
 namespace {
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
@@ -66,6 +70,78 @@ public:
  * signatureCache could be made local to VerifySignature.
 */
 static CSignatureCache signatureCache;
+
+/**
+ * Cache of parsed public keys. Blocks reuse the same keys over and over
+ * (exchange and pool payout addresses), and parsing a compressed key costs a
+ * field square root on every signature check.
+ *
+ * This is a fixed size direct-mapped table indexed by a salted SipHash of the
+ * serialized key, so an attacker can not choose keys that collide, and a
+ * colliding insert simply replaces the older entry. Slots are protected by a
+ * set of striped mutexes, as script checks run on several threads at once.
+ */
+class CPubKeyCache
+{
+private:
+    struct Entry {
+        unsigned char size; //!< Serialized key size, 0 for an empty slot
+        unsigned char key[CPubKey::PUBLIC_KEY_SIZE];
+        CParsedPubKey parsed;
+    };
+    static constexpr size_t LOCK_STRIPES = 64;
+    static_assert((PUBKEY_CACHE_ENTRIES & (PUBKEY_CACHE_ENTRIES - 1)) == 0, "PUBKEY_CACHE_ENTRIES must be a power of two");
+
+    const uint64_t k0, k1;
+    std::vector<Entry> entries;
+    std::array<std::mutex, LOCK_STRIPES> locks;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<size_t> used{0};
+
+public:
+    CPubKeyCache() :
+        k0(GetRand(std::numeric_limits<uint64_t>::max())),
+        k1(GetRand(std::numeric_limits<uint64_t>::max())),
+        entries(PUBKEY_CACHE_ENTRIES) {}
+
+    //! Return the parsed form of pubkey, parsing and inserting it on a miss.
+    bool Get(const CPubKey& pubkey, CParsedPubKey& parsed)
+    {
+        const size_t index = CSipHasher(k0, k1).Write(pubkey.begin(), pubkey.size()).Finalize() & (entries.size() - 1);
+        Entry& entry = entries[index];
+        std::mutex& lock = locks[index % LOCK_STRIPES];
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (entry.size == pubkey.size() && memcmp(entry.key, pubkey.begin(), pubkey.size()) == 0) {
+                parsed = entry.parsed;
+                ++hits;
+                return true;
+            }
+        }
+        ++misses;
+        if (!pubkey.Parse(parsed)) return false;
+        std::lock_guard<std::mutex> guard(lock);
+        if (entry.size == 0) ++used;
+        entry.size = pubkey.size();
+        memcpy(entry.key, pubkey.begin(), pubkey.size());
+        entry.parsed = parsed;
+        return true;
+    }
+
+    PubKeyCacheStats Stats() const
+    {
+        PubKeyCacheStats stats;
+        stats.hits = hits;
+        stats.misses = misses;
+        stats.entries = used;
+        stats.capacity = entries.size();
+        stats.usage = memusage::DynamicUsage(entries);
+        return stats;
+    }
+};
+
+static CPubKeyCache pubkeyCache;
 } // namespace
 
 // To be called once in AppInitMain/BasicTestingSetup to initialize the
@@ -86,9 +162,15 @@ bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsig
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
     if (signatureCache.Get(entry, !store))
         return true;
-    if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
+    CParsedPubKey parsed;
+    if (!pubkeyCache.Get(pubkey, parsed) || !CPubKey::Verify(parsed, sighash, vchSig))
         return false;
     if (store)
         signatureCache.Set(entry);
     return true;
 }
+
+PubKeyCacheStats GetPubKeyCacheStats()
+{
+    return pubkeyCache.Stats();
+}
@@ -17,6 +17,9 @@ static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
+//! Number of slots in the parsed public key cache (~4 MB).
+static const unsigned int PUBKEY_CACHE_ENTRIES = 1 << 15;
+
 class CPubKey;
 
 /**
@@ -53,4 +56,16 @@ public:
 
 void InitSignatureCache();
 
+struct PubKeyCacheStats
+{
+    uint64_t hits;      //!< Lookups answered from the cache
+    uint64_t misses;    //!< Lookups that had to parse the key
+    size_t entries;     //!< Slots currently holding a key
+    size_t capacity;    //!< Total number of slots
+    size_t usage;       //!< Memory used by the cache in bytes
+};
+
+/** Statistics of the parsed public key cache used by CachingTransactionSignatureChecker. */
+PubKeyCacheStats GetPubKeyCacheStats();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
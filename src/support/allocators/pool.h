@@ -0,0 +1,232 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <memusage.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Size-class pool for the many small nodes of node-based containers.
+ *
+ * Blocks are carved out of large chunks and rounded up to a multiple of
+ * ALIGN_BYTES. A freed block goes onto the free list of its size class and is
+ * handed out again to the next allocation of the same size, so that a
+ * container which keeps inserting and erasing nodes does not fragment the
+ * heap and pays no per-allocation malloc overhead. Requests larger than
+ * MAX_BLOCK_SIZE_BYTES, or with stricter alignment than ALIGN_BYTES, go to
+ * operator new instead.
+ *
+ * Chunks are only returned when the resource is destroyed, and a free block
+ * only serves its own size class, so the memory held stays at its peak.
+ * Callers that bound their memory use should count ReservedBytes() rather
+ * than UsedBytes().
+ *
+ * The resource is not thread-safe: all containers sharing one must be
+ * guarded by the same lock, and must be destroyed before it.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES > 0 && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+
+    //! Freed blocks are linked through their first bytes.
+    struct ListNode {
+        ListNode* m_next;
+        explicit ListNode(ListNode* next) : m_next(next) {}
+    };
+
+    static const std::size_t ELEM_ALIGN_BYTES = ALIGN_BYTES > alignof(ListNode) ? ALIGN_BYTES : alignof(ListNode);
+    static_assert(sizeof(ListNode) <= ELEM_ALIGN_BYTES, "a free block must be able to hold a ListNode");
+    static const std::size_t NUM_SIZE_CLASSES = (MAX_BLOCK_SIZE_BYTES + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + 1;
+
+    const std::size_t m_chunk_size_bytes;
+    std::vector<char*> m_chunks;
+    //! Free list per size class, indexed by the size in units of ELEM_ALIGN_BYTES.
+    ListNode* m_free_lists[NUM_SIZE_CLASSES];
+    //! Not yet used tail of the most recent chunk.
+    char* m_available_begin;
+    char* m_available_end;
+
+    std::size_t m_pooled_bytes;   //!< bytes in blocks currently handed out from chunks
+    std::size_t m_fallback_bytes; //!< MallocUsage of blocks currently handed out by operator new
+
+    static std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return std::max<std::size_t>(1, (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES);
+    }
+
+    static bool IsPooled(std::size_t bytes, std::size_t alignment)
+    {
+        return bytes <= MAX_BLOCK_SIZE_BYTES && alignment <= ELEM_ALIGN_BYTES;
+    }
+
+    void PushFree(void* p, std::size_t num_elems)
+    {
+        m_free_lists[num_elems] = new (p) ListNode(m_free_lists[num_elems]);
+    }
+
+    void AllocateChunk()
+    {
+        // Keep the unused tail of the current chunk as a free block rather
+        // than losing it.
+        const std::size_t remaining = m_available_end - m_available_begin;
+        if (remaining > 0) {
+            PushFree(m_available_begin, remaining / ELEM_ALIGN_BYTES);
+        }
+        char* chunk = static_cast<char*>(::operator new(m_chunk_size_bytes));
+        m_chunks.push_back(chunk);
+        m_available_begin = chunk;
+        m_available_end = chunk + m_chunk_size_bytes;
+    }
+
+public:
+    explicit PoolResource(std::size_t chunk_size_bytes = 256 * 1024)
+        : m_chunk_size_bytes(NumElemAlignBytes(std::max(chunk_size_bytes, MAX_BLOCK_SIZE_BYTES)) * ELEM_ALIGN_BYTES),
+          m_available_begin(nullptr), m_available_end(nullptr), m_pooled_bytes(0), m_fallback_bytes(0)
+    {
+        std::fill(m_free_lists, m_free_lists + NUM_SIZE_CLASSES, nullptr);
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (char* chunk : m_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsPooled(bytes, alignment)) {
+            void* p = ::operator new(bytes);
+            m_fallback_bytes += memusage::MallocUsage(bytes);
+            return p;
+        }
+        const std::size_t num_elems = NumElemAlignBytes(bytes);
+        const std::size_t block_bytes = num_elems * ELEM_ALIGN_BYTES;
+        void* p;
+        if (m_free_lists[num_elems] != nullptr) {
+            ListNode* node = m_free_lists[num_elems];
+            m_free_lists[num_elems] = node->m_next;
+            node->~ListNode();
+            p = node;
+        } else {
+            if (static_cast<std::size_t>(m_available_end - m_available_begin) < block_bytes) {
+                AllocateChunk();
+            }
+            p = m_available_begin;
+            m_available_begin += block_bytes;
+        }
+        m_pooled_bytes += block_bytes;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (!IsPooled(bytes, alignment)) {
+            m_fallback_bytes -= memusage::MallocUsage(bytes);
+            ::operator delete(p);
+            return;
+        }
+        const std::size_t num_elems = NumElemAlignBytes(bytes);
+        m_pooled_bytes -= num_elems * ELEM_ALIGN_BYTES;
+        PushFree(p, num_elems);
+    }
+
+    //! Memory in use by live allocations, exact for pooled blocks.
+    std::size_t UsedBytes() const { return m_pooled_bytes + m_fallback_bytes; }
+
+    //! Memory held from the system, including free blocks kept for reuse.
+    std::size_t ReservedBytes() const
+    {
+        return memusage::MallocUsage(m_chunk_size_bytes) * m_chunks.size() + memusage::DynamicUsage(m_chunks) + m_fallback_bytes;
+    }
+
+    std::size_t NumChunks() const { return m_chunks.size(); }
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+};
+
+/**
+ * Allocator handing out memory from a PoolResource. Copies, including
+ * rebound ones, share the resource, so containers can be given a single pool
+ * for all of their node types.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolAllocator
+{
+    template <class U, std::size_t M, std::size_t A>
+    friend class PoolAllocator;
+
+    PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* m_resource;
+
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <class U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    explicit PoolAllocator(PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& resource) noexcept : m_resource(&resource) {}
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.m_resource) {}
+
+    T* allocate(std::size_t n, const void* hint = nullptr)
+    {
+        if (n > max_size()) throw std::bad_alloc();
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    std::size_t max_size() const noexcept { return std::numeric_limits<std::size_t>::max() / sizeof(T); }
+
+    T* address(T& x) const noexcept { return std::addressof(x); }
+    const T* address(const T& x) const noexcept { return std::addressof(x); }
+
+    template <class U, class... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+    template <class U>
+    void destroy(U* p) { p->~U(); }
+
+    PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* resource() const noexcept { return m_resource; }
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
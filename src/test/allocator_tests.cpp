@@ -4,9 +4,11 @@
 
 #include <util.h>
 
+#include <support/allocators/pool.h>
 #include <support/allocators/secure.h>
 #include <test/test_bitcoin.h>
 
+#include <map>
 #include <memory>
 
 #include <boost/test/unit_test.hpp>
@@ -233,4 +235,53 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 0U);
+
+    // Sizes are rounded up to the alignment, and freed blocks are reused by
+    // the next allocation of the same size class.
+    void* a = resource.Allocate(20, 8);
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 24U);
+    BOOST_CHECK_EQUAL(resource.NumChunks(), 1U);
+    void* b = resource.Allocate(24, 8);
+    BOOST_CHECK(a != b);
+    resource.Deallocate(a, 20, 8);
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 24U);
+    BOOST_CHECK(resource.Allocate(17, 8) == a);
+    resource.Deallocate(a, 17, 8);
+    resource.Deallocate(b, 24, 8);
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 0U);
+
+    // Large or overaligned blocks bypass the chunks but are still counted.
+    void* big = resource.Allocate(1000, 8);
+    BOOST_CHECK(resource.UsedBytes() >= 1000U);
+    resource.Deallocate(big, 1000, 8);
+    void* aligned = resource.Allocate(32, 16);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(aligned) % 16, 0U);
+    resource.Deallocate(aligned, 32, 16);
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 0U);
+    BOOST_CHECK_EQUAL(resource.NumChunks(), 1U);
+
+    // A node-based container running off the pool.
+    {
+        std::map<int, int, std::less<int>, PoolAllocator<std::pair<const int, int>, 64, 8> > m{std::less<int>(), PoolAllocator<std::pair<const int, int>, 64, 8>(resource)};
+        for (int i = 0; i < 1000; ++i) {
+            m[i] = i;
+        }
+        BOOST_CHECK(resource.NumChunks() > 1U);
+        BOOST_CHECK(resource.UsedBytes() > 0U);
+        BOOST_CHECK(resource.ReservedBytes() >= resource.UsedBytes());
+        const size_t chunks = resource.NumChunks();
+        m.clear();
+        BOOST_CHECK_EQUAL(resource.UsedBytes(), 0U);
+        for (int i = 0; i < 1000; ++i) {
+            m[i] = i;
+        }
+        BOOST_CHECK_EQUAL(resource.NumChunks(), chunks);
+    }
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -151,4 +151,31 @@ BOOST_AUTO_TEST_CASE(bip32_test3) {
     RunTest(test3);
 }
 
+BOOST_AUTO_TEST_CASE(bip32_derive_range) {
+    std::vector<unsigned char> seed = ParseHex(test1.strHexMaster);
+    CExtKey key;
+    key.SetSeed(seed.data(), seed.size());
+    CExtPubKey pubkey = key.Neuter();
+
+    // Ranges that do not fill the SIMD lanes evenly, on both sides of the hardened boundary
+    for (unsigned int nChildBegin : {0u, 5u, 0x80000000u, 0x80000011u}) {
+        std::vector<CExtKey> keys;
+        BOOST_CHECK(key.DeriveRange(keys, nChildBegin, 13));
+        BOOST_CHECK_EQUAL(keys.size(), 13U);
+        for (unsigned int i = 0; i < keys.size(); i++) {
+            CExtKey expected;
+            BOOST_CHECK(key.Derive(expected, nChildBegin + i));
+            BOOST_CHECK(keys[i] == expected);
+        }
+        if (nChildBegin & 0x80000000) continue;
+
+        std::vector<CExtPubKey> pubkeys;
+        BOOST_CHECK(pubkey.DeriveRange(pubkeys, nChildBegin, 13));
+        BOOST_CHECK_EQUAL(pubkeys.size(), 13U);
+        for (unsigned int i = 0; i < pubkeys.size(); i++) {
+            BOOST_CHECK(pubkeys[i] == keys[i].Neuter());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
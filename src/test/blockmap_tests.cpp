@@ -0,0 +1,77 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockmap.h>
+#include <chain.h>
+#include <memusage.h>
+#include <random.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <unordered_map>
+
+namespace {
+struct CheapHasher {
+    size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(blockmap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockmap_matches_unordered_map)
+{
+    BlockMap map;
+    std::unordered_map<uint256, CBlockIndex*, CheapHasher> reference;
+    std::vector<CBlockIndex> entries(5000);
+    std::vector<uint256> hashes;
+
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(InsecureRand256()) == map.end());
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const uint256 hash = InsecureRand256();
+        hashes.push_back(hash);
+        auto ret = map.emplace(hash, &entries[i]);
+        BOOST_CHECK(ret.second);
+        BOOST_CHECK(ret.first->first == hash);
+        reference.emplace(hash, &entries[i]);
+        // Point into the map as validation does; the pair must never move.
+        entries[i].phashBlock = &ret.first->first;
+    }
+    // Inserting an existing hash keeps the first entry.
+    auto ret = map.emplace(hashes[17], &entries[0]);
+    BOOST_CHECK(!ret.second);
+    BOOST_CHECK(ret.first->second == &entries[17]);
+
+    BOOST_CHECK_EQUAL(map.size(), reference.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        BOOST_CHECK(*entries[i].phashBlock == hashes[i]);
+        BlockMap::const_iterator it = map.find(hashes[i]);
+        BOOST_CHECK(it != map.end());
+        BOOST_CHECK(it->second == reference.at(hashes[i]));
+        BOOST_CHECK_EQUAL(map.count(hashes[i]), 1U);
+    }
+    for (int i = 0; i < 100; ++i) {
+        BOOST_CHECK_EQUAL(map.count(InsecureRand256()), 0U);
+    }
+
+    // Iteration visits every pair once, in insertion order.
+    size_t n = 0;
+    for (const auto& item : map) {
+        BOOST_CHECK(item.first == hashes[n]);
+        ++n;
+    }
+    BOOST_CHECK_EQUAL(n, hashes.size());
+
+    BOOST_CHECK(map.DynamicMemoryUsage() < memusage::DynamicUsage(reference));
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK(map.find(hashes[0]) == map.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
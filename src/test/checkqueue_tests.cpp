@@ -58,6 +58,17 @@ struct FailingCheck {
     };
 };
 
+struct CountingCheck {
+    static std::atomic<size_t> n_calls;
+    bool fails{false};
+    bool operator()()
+    {
+        n_calls.fetch_add(1, std::memory_order_relaxed);
+        return !fails;
+    }
+    void swap(CountingCheck& x) { std::swap(fails, x.fails); };
+};
+
 struct UniqueCheck {
     static std::mutex m;
     static std::unordered_multiset<size_t> results;
@@ -132,12 +143,14 @@ std::condition_variable FrozenCleanupCheck::cv{};
 std::mutex UniqueCheck::m;
 std::unordered_multiset<size_t> UniqueCheck::results;
 std::atomic<size_t> FakeCheckCheckCompletion::n_calls{0};
+std::atomic<size_t> CountingCheck::n_calls{0};
 std::atomic<size_t> MemoryCheck::fake_allocated_memory{0};
 
 // Queue Typedefs
 typedef CCheckQueue<FakeCheckCheckCompletion> Correct_Queue;
 typedef CCheckQueue<FakeCheck> Standard_Queue;
 typedef CCheckQueue<FailingCheck> Failing_Queue;
+typedef CCheckQueue<CountingCheck> Counting_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
@@ -242,6 +255,23 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure)
     tg.interrupt_all();
     tg.join_all();
 }
+// Test that once a check has failed, the remaining ones are not run. Without
+// worker threads the master runs its own deque from the back, so the failing
+// check (added last) is the first one evaluated.
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Aborts_After_Failure)
+{
+    Counting_Queue queue{QUEUE_BATCH_SIZE};
+    for (bool end_fails : {true, false}) {
+        CountingCheck::n_calls = 0;
+        CCheckQueueControl<CountingCheck> control(&queue);
+        std::vector<CountingCheck> vChecks(1000);
+        vChecks.back().fails = end_fails;
+        control.Add(vChecks);
+        BOOST_REQUIRE(control.Wait() != end_fails);
+        BOOST_REQUIRE_EQUAL(CountingCheck::n_calls, end_fails ? 1U : 1000U);
+    }
+}
+
 // Test that a block validation which fails does not interfere with
 // future blocks, ie, the bad state is cleared.
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Recovers_From_Failure)
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <coins.h>
+#include <key.h>
 #include <script/standard.h>
 #include <uint256.h>
 #include <undo.h>
@@ -13,6 +14,7 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #include <boost/test/unit_test.hpp>
 
@@ -34,6 +36,7 @@ class CCoinsViewTest : public CCoinsView
 {
     uint256 hashBestBlock_;
     std::map<COutPoint, Coin> map_;
+    CRollingCoinsStats stats_;
 
 public:
     bool GetCoin(const COutPoint& outpoint, Coin& coin) const override
@@ -52,12 +55,18 @@ public:
 
     uint256 GetBestBlock() const override { return hashBestBlock_; }
 
-    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    bool GetRollingStats(CRollingCoinsStats& stats) const override
+    {
+        stats = stats_;
+        return true;
+    }
+
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, const CRollingCoinsStats& stats) override
     {
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
                 // Same optimization used in CCoinsViewDB is to only write dirty entries.
-                map_[it->first] = it->second.coin;
+                map_[it->first] = it->second.coin.Decompress();
                 if (it->second.coin.IsSpent() && InsecureRandRange(3) == 0) {
                     // Randomly delete empty entries on write.
                     map_.erase(it->first);
@@ -67,6 +76,7 @@ public:
         }
         if (!hashBlock.IsNull())
             hashBestBlock_ = hashBlock;
+        stats_.Apply(stats);
         return true;
     }
 };
@@ -74,7 +84,7 @@ public:
 class CCoinsViewCacheTest : public CCoinsViewCache
 {
 public:
-    explicit CCoinsViewCacheTest(CCoinsView* _base) : CCoinsViewCache(_base) {}
+    explicit CCoinsViewCacheTest(CCoinsView* _base, bool track_stats = true) : CCoinsViewCache(_base, track_stats) {}
 
     void SelfTest() const
     {
@@ -85,18 +95,43 @@ public:
             ret += entry.second.coin.DynamicMemoryUsage();
             ++count;
         }
+        ret += memusage::DynamicUsage(m_stats_added) + memusage::DynamicUsage(m_stats_removed);
+        for (const auto& entry : m_stats_added) {
+            ret += entry.second.DynamicMemoryUsage();
+        }
+        for (const auto& entry : m_stats_removed) {
+            ret += entry.second.DynamicMemoryUsage();
+        }
         BOOST_CHECK_EQUAL(GetCacheSize(), count);
         BOOST_CHECK_EQUAL(DynamicMemoryUsage(), ret);
     }
 
     CCoinsMap& map() const { return cacheCoins; }
     size_t& usage() const { return cachedCoinsUsage; }
+    size_t pending_stats() const { return m_stats_added.size() + m_stats_removed.size(); }
 };
 
 } // namespace
 
 BOOST_FIXTURE_TEST_SUITE(coins_tests, BasicTestingSetup)
 
+static void CheckRollingStats(const CCoinsView& view, const std::map<COutPoint, Coin>& coins)
+{
+    CRollingCoinsStats expected;
+    for (const auto& entry : coins) {
+        if (!entry.second.IsSpent()) expected.Add(entry.first, entry.second);
+    }
+    CRollingCoinsStats stats;
+    BOOST_REQUIRE(view.GetRollingStats(stats));
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, expected.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(stats.nBogoSize, expected.nBogoSize);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, expected.nTotalAmount);
+    unsigned char hash[MuHash3072::OUTPUT_SIZE], expected_hash[MuHash3072::OUTPUT_SIZE];
+    stats.muhash.Finalize(hash);
+    expected.muhash.Finalize(expected_hash);
+    BOOST_CHECK(memcmp(hash, expected_hash, sizeof(hash)) == 0);
+}
+
 static const unsigned int NUM_SIMULATION_ITERATIONS = 40000;
 
 // This is a large randomized insert/remove simulation test on a variable-size
@@ -149,7 +184,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
             bool test_havecoin_after = InsecureRandBits(2) == 0;
 
             bool result_havecoin = test_havecoin_before ? stack.back()->HaveCoin(COutPoint(txid, 0)) : false;
-            const Coin& entry = (InsecureRandRange(500) == 0) ? AccessByTxid(*stack.back(), txid) : stack.back()->AccessCoin(COutPoint(txid, 0));
+            const Coin entry = (InsecureRandRange(500) == 0) ? AccessByTxid(*stack.back(), txid) : stack.back()->AccessCoin(COutPoint(txid, 0));
             BOOST_CHECK(coin == entry);
             BOOST_CHECK(!test_havecoin_before || result_havecoin == !entry.IsSpent());
 
@@ -191,7 +226,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
         if (InsecureRandRange(1000) == 1 || i == NUM_SIMULATION_ITERATIONS - 1) {
             for (const auto& entry : result) {
                 bool have = stack.back()->HaveCoin(entry.first);
-                const Coin& coin = stack.back()->AccessCoin(entry.first);
+                const Coin coin = stack.back()->AccessCoin(entry.first);
                 BOOST_CHECK(have == !coin.IsSpent());
                 BOOST_CHECK(coin == entry.second);
                 if (coin.IsSpent()) {
@@ -204,6 +239,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
             for (const CCoinsViewCacheTest *test : stack) {
                 test->SelfTest();
             }
+            CheckRollingStats(*stack.back(), result);
         }
 
         if (InsecureRandRange(100) == 0) {
@@ -422,7 +458,7 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
         if (InsecureRandRange(1000) == 1 || i == NUM_SIMULATION_ITERATIONS - 1) {
             for (const auto& entry : result) {
                 bool have = stack.back()->HaveCoin(entry.first);
-                const Coin& coin = stack.back()->AccessCoin(entry.first);
+                const Coin coin = stack.back()->AccessCoin(entry.first);
                 BOOST_CHECK(have == !coin.IsSpent());
                 BOOST_CHECK(coin == entry.second);
             }
@@ -561,7 +597,9 @@ static size_t InsertCoinsMapEntry(CCoinsMap& map, CAmount value, char flags)
     assert(flags != NO_ENTRY);
     CCoinsCacheEntry entry;
     entry.flags = flags;
-    SetCoinsValue(value, entry.coin);
+    Coin coin;
+    SetCoinsValue(value, coin);
+    entry.coin = coin;
     auto inserted = map.emplace(OUTPOINT, std::move(entry));
     assert(inserted.second);
     return inserted.first->second.coin.DynamicMemoryUsage();
@@ -577,7 +615,7 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
         if (it->second.coin.IsSpent()) {
             value = PRUNED;
         } else {
-            value = it->second.coin.out.nValue;
+            value = it->second.coin.GetValue();
         }
         flags = it->second.flags;
         assert(flags != NO_ENTRY);
@@ -588,7 +626,7 @@ void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
     CCoinsMap map;
     InsertCoinsMapEntry(map, value, flags);
-    view.BatchWrite(map, {});
+    view.BatchWrite(map, {}, {});
 }
 
 class SingleEntryCacheTest
@@ -656,6 +694,44 @@ BOOST_AUTO_TEST_CASE(ccoins_access)
     CheckAccessCoin(VALUE1, VALUE2, VALUE2, DIRTY|FRESH, DIRTY|FRESH);
 }
 
+static void CheckAddFetchedCoin(CAmount fetched_value, CAmount cache_value, CAmount expected_value, char cache_flags, char expected_flags)
+{
+    SingleEntryCacheTest test(ABSENT, cache_value, cache_flags);
+    BOOST_CHECK_EQUAL(test.cache.HaveEntryInCache(OUTPOINT), cache_value != ABSENT);
+    std::vector<std::pair<COutPoint, Coin>> fetched(1);
+    fetched[0].first = OUTPOINT;
+    if (fetched_value != ABSENT) SetCoinsValue(fetched_value, fetched[0].second);
+    size_t added = test.cache.AddFetchedCoins(fetched);
+    test.cache.SelfTest();
+
+    CAmount result_value;
+    char result_flags;
+    GetCoinsMapEntry(test.cache.map(), result_value, result_flags);
+    BOOST_CHECK_EQUAL(result_value, expected_value);
+    BOOST_CHECK_EQUAL(result_flags, expected_flags);
+    BOOST_CHECK_EQUAL(added, cache_value == ABSENT && expected_value != ABSENT ? 1U : 0U);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_add_fetched)
+{
+    /* Check AddFetchedCoins behavior: coins looked up in the base view ahead
+     * of time are only added where the cache has no entry, and look exactly
+     * like the entries AccessCoin would have created.
+     *
+     *                   Fetched Cache   Result  Cache        Result
+     *                   Value   Value   Value   Flags        Flags
+     */
+    CheckAddFetchedCoin(ABSENT, ABSENT, ABSENT, NO_ENTRY   , NO_ENTRY   );
+    CheckAddFetchedCoin(ABSENT, PRUNED, PRUNED, DIRTY      , DIRTY      );
+    CheckAddFetchedCoin(ABSENT, VALUE2, VALUE2, 0          , 0          );
+    CheckAddFetchedCoin(VALUE1, ABSENT, VALUE1, NO_ENTRY   , 0          );
+    CheckAddFetchedCoin(VALUE1, PRUNED, PRUNED, 0          , 0          );
+    CheckAddFetchedCoin(VALUE1, PRUNED, PRUNED, DIRTY      , DIRTY      );
+    CheckAddFetchedCoin(VALUE1, PRUNED, PRUNED, DIRTY|FRESH, DIRTY|FRESH);
+    CheckAddFetchedCoin(VALUE1, VALUE2, VALUE2, 0          , 0          );
+    CheckAddFetchedCoin(VALUE1, VALUE2, VALUE2, DIRTY      , DIRTY      );
+}
+
 static void CheckSpendCoins(CAmount base_value, CAmount cache_value, CAmount expected_value, char cache_flags, char expected_flags)
 {
     SingleEntryCacheTest test(base_value, cache_value, cache_flags);
@@ -855,4 +931,216 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_map)
+{
+    CCoinsMap map;
+    std::map<COutPoint, CAmount> reference;
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 20000; ++i) {
+        outpoints.emplace_back(InsecureRand256(), InsecureRandRange(4));
+    }
+
+    // Entries do not move when the map grows.
+    const CCoinsCacheEntry* first = &map.try_emplace(outpoints[0]).first->second;
+    reference[outpoints[0]] = first->coin.GetValue();
+
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < 10000; ++i) {
+            const COutPoint& outpoint = outpoints[InsecureRandRange(outpoints.size())];
+            const CAmount value = InsecureRandRange(1000) + 1;
+            Coin coin;
+            coin.out.nValue = value;
+            auto ret = map.try_emplace(outpoint, std::move(coin));
+            BOOST_CHECK_EQUAL(ret.second, reference.emplace(outpoint, value).second);
+            BOOST_CHECK(ret.first->first == outpoint);
+            BOOST_CHECK_EQUAL(ret.first->second.coin.GetValue(), reference[outpoint]);
+        }
+        BOOST_CHECK_EQUAL(map.size(), reference.size());
+        BOOST_CHECK(&map.find(outpoints[0])->second == first);
+
+        // Erase about half of the entries while iterating, as BatchWrite does.
+        const size_t size_before = map.size();
+        size_t visited = 0;
+        for (CCoinsMap::iterator it = map.begin(); it != map.end();) {
+            ++visited;
+            BOOST_CHECK_EQUAL(it->second.coin.GetValue(), reference.at(it->first));
+            if (it->first != outpoints[0] && InsecureRandBool()) {
+                reference.erase(it->first);
+                it = map.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        BOOST_CHECK_EQUAL(visited, size_before);
+        BOOST_CHECK_EQUAL(map.size(), reference.size());
+        for (const COutPoint& outpoint : outpoints) {
+            BOOST_CHECK_EQUAL(map.count(outpoint), reference.count(outpoint));
+        }
+    }
+
+    // Filled from empty, the map takes less memory than the node-based map
+    // it replaced.
+    CCoinsMap filled;
+    std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> node_map;
+    for (const COutPoint& outpoint : outpoints) {
+        filled.try_emplace(outpoint);
+        node_map.emplace(outpoint, CCoinsCacheEntry());
+    }
+    BOOST_CHECK_EQUAL(filled.size(), node_map.size());
+    BOOST_CHECK(filled.DynamicMemoryUsage() < memusage::DynamicUsage(node_map));
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK_EQUAL(map.DynamicMemoryUsage(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(compact_coin)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pubkey = key.GetPubKey();
+    std::vector<CScript> scripts{
+        GetScriptForDestination(pubkey.GetID()),
+        GetScriptForDestination(CScriptID(CScript() << OP_TRUE)),
+        GetScriptForDestination(WitnessV0KeyHash(pubkey.GetID())),
+        GetScriptForDestination(WitnessV0ScriptHash()),
+        GetScriptForRawPubKey(pubkey),
+        CScript(),
+        CScript() << OP_TRUE,
+        CScript() << std::vector<unsigned char>(21, 0x01),
+        // Not quite P2SH: the wrong opcode at the end
+        CScript() << OP_HASH160 << std::vector<unsigned char>(20, 0x02) << OP_EQUALVERIFY,
+        CScript() << std::vector<unsigned char>(500, 0x03),
+    };
+    for (size_t i = 0; i < scripts.size(); ++i) {
+        const Coin coin(CTxOut(i == 0 ? MAX_MONEY : InsecureRandRange(MAX_MONEY), scripts[i]), InsecureRandRange(1 << 20), i % 2);
+        const CompactCoin compact(coin);
+        BOOST_CHECK(!compact.IsSpent());
+        BOOST_CHECK_EQUAL(compact.GetValue(), coin.out.nValue);
+        BOOST_CHECK_EQUAL(compact.GetHeight(), coin.nHeight);
+        BOOST_CHECK_EQUAL(compact.IsCoinBase(), coin.IsCoinBase());
+        BOOST_CHECK(compact.Decompress() == coin);
+        BOOST_CHECK(compact.Decompress().out.scriptPubKey == coin.out.scriptPubKey);
+        // Only the scripts that are neither templates nor short are allocated.
+        BOOST_CHECK_EQUAL(compact.DynamicMemoryUsage() > 0, scripts[i].size() > 22 && i != 0 && i != 1);
+
+        CompactCoin copy(compact);
+        BOOST_CHECK(copy.Decompress() == coin);
+        CompactCoin moved(std::move(copy));
+        BOOST_CHECK(copy.IsSpent());
+        BOOST_CHECK(moved.Decompress() == coin);
+        moved.Clear();
+        BOOST_CHECK(moved.IsSpent());
+        BOOST_CHECK(moved.Decompress().IsSpent());
+        BOOST_CHECK_EQUAL(moved.DynamicMemoryUsage(), 0U);
+    }
+    BOOST_CHECK(CompactCoin(Coin()).IsSpent());
+    BOOST_CHECK(sizeof(CCoinsMap::value_type) < sizeof(std::pair<const COutPoint, Coin>));
+
+    // AccessCoin decompresses into a copy owned by the caller, which costs
+    // the cache no memory.
+    CCoinsView base;
+    CCoinsViewCacheTest cache(&base);
+    const COutPoint outpoint(InsecureRand256(), 0);
+    cache.AddCoin(outpoint, Coin(CTxOut(1, scripts[0]), 1, false), false);
+    const size_t usage = cache.DynamicMemoryUsage();
+    const Coin accessed = cache.AccessCoin(outpoint);
+    BOOST_CHECK(accessed.out.scriptPubKey == scripts[0]);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), usage);
+    cache.SelfTest();
+    BOOST_CHECK(cache.AccessCoin(COutPoint(InsecureRand256(), 0)).IsSpent());
+    BOOST_CHECK(cache.SpendCoin(outpoint));
+    BOOST_CHECK(accessed.out.scriptPubKey == scripts[0]);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_flush_keep)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 100; ++i) {
+        outpoints.emplace_back(InsecureRand256(), i);
+        cache.AddCoin(outpoints.back(), Coin(CTxOut(i + 1, CScript() << OP_TRUE), 1, false), false);
+    }
+
+    // Created coins are recent, so all of them stay, as clean entries.
+    BOOST_CHECK(cache.Flush(1 << 20));
+    BOOST_CHECK_EQUAL(cache.GetKeptSize(), 100U);
+    cache.SelfTest();
+    for (const auto& entry : cache.map()) {
+        BOOST_CHECK_EQUAL(entry.second.flags, 0);
+        BOOST_CHECK(!entry.second.recent);
+    }
+    for (const COutPoint& outpoint : outpoints) {
+        Coin coin;
+        BOOST_CHECK(base.GetCoin(outpoint, coin));
+    }
+
+    // Only the coins used since then survive the next flush.
+    const uint64_t hits = cache.GetCacheHits();
+    for (int i = 0; i < 10; ++i) {
+        BOOST_CHECK(cache.HaveCoin(outpoints[i]));
+    }
+    BOOST_CHECK_EQUAL(cache.GetCacheHits(), hits + 10);
+    BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+    BOOST_CHECK(cache.Flush(1 << 20));
+    BOOST_CHECK_EQUAL(cache.GetKeptSize(), 9U);
+    cache.SelfTest();
+    for (int i = 0; i < 100; ++i) {
+        BOOST_CHECK_EQUAL(cache.HaveCoinInCache(outpoints[i]), i > 0 && i < 10);
+    }
+
+    // Coins that are not cached are read from the base again.
+    const uint64_t misses = cache.GetCacheMisses();
+    BOOST_CHECK(!cache.HaveCoin(outpoints[0]));
+    BOOST_CHECK(cache.HaveCoin(outpoints[50]));
+    BOOST_CHECK_EQUAL(cache.GetCacheMisses(), misses + 2);
+
+    // Without a budget the cache is emptied.
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK_EQUAL(cache.GetKeptSize(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_rolling_stats_deferred)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    std::map<COutPoint, Coin> coins;
+    for (int i = 0; i < 10; ++i) {
+        COutPoint outpoint(InsecureRand256(), i);
+        coins[outpoint] = Coin(CTxOut(i + 1, CScript() << OP_TRUE), 1, false);
+        cache.AddCoin(outpoint, Coin(coins[outpoint]), false);
+    }
+    BOOST_CHECK_EQUAL(cache.pending_stats(), 10U);
+    cache.SelfTest();
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.pending_stats(), 0U);
+    CheckRollingStats(cache, coins);
+
+    // A coin that is created and spent again before the changes are handed
+    // on is never hashed; spending a flushed coin is.
+    COutPoint transient(InsecureRand256(), 0);
+    cache.AddCoin(transient, Coin(CTxOut(1, CScript() << OP_TRUE), 1, false), false);
+    BOOST_CHECK(cache.SpendCoin(transient));
+    BOOST_CHECK_EQUAL(cache.pending_stats(), 0U);
+    BOOST_CHECK(cache.SpendCoin(coins.begin()->first));
+    coins.erase(coins.begin());
+    BOOST_CHECK_EQUAL(cache.pending_stats(), 1U);
+    cache.SelfTest();
+    CheckRollingStats(cache, coins);
+    BOOST_CHECK_EQUAL(cache.pending_stats(), 0U);
+
+    // A view that does not track the statistics has none to report, and
+    // may not be flushed.
+    CCoinsViewCacheTest throwaway(&cache, false);
+    BOOST_CHECK(throwaway.SpendCoin(coins.begin()->first));
+    throwaway.AddCoin(transient, Coin(CTxOut(1, CScript() << OP_TRUE), 1, false), false);
+    BOOST_CHECK_EQUAL(throwaway.pending_stats(), 0U);
+    CRollingCoinsStats stats;
+    BOOST_CHECK(!throwaway.GetRollingStats(stats));
+    BOOST_CHECK_THROW(throwaway.Flush(), std::logic_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
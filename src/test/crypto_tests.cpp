@@ -10,6 +10,8 @@
 #include <crypto/sha512.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/muhash.h>
+#include <hash.h>
 #include <random.h>
 #include <utilstrencodings.h>
 #include <test/test_bitcoin.h>
@@ -524,6 +526,173 @@ BOOST_AUTO_TEST_CASE(chacha20_testvector)
                  "fab78c9");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[64 * 32];
+        unsigned char out1[32 * 32], out2[32 * 32];
+        for (int j = 0; j < 64 * i; ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+        }
+        SHA256D64(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+        // Hashing in place, as done for merkle tree levels, must give the same result.
+        SHA256D64(in, in, i);
+        BOOST_CHECK(memcmp(out1, in, 32 * i) == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sha256_implementations)
+{
+    // Every backend the CPU supports must agree with the generic one.
+    const sha256_implementation::UseImplementation impls[] = {
+        sha256_implementation::STANDARD,
+        sha256_implementation::USE_SSE4,
+        sha256_implementation::USE_SSE4_AND_AVX2,
+        sha256_implementation::USE_SSE4_AND_SHANI,
+    };
+    std::vector<unsigned char> in(64 * 19);
+    for (unsigned char& c : in) {
+        c = InsecureRandBits(8);
+    }
+    SHA256AutoDetect(sha256_implementation::STANDARD);
+    unsigned char ref_hash[CSHA256::OUTPUT_SIZE];
+    std::vector<unsigned char> ref_d64(32 * 19);
+    CSHA256().Write(in.data(), in.size() - 7).Finalize(ref_hash);
+    SHA256D64(ref_d64.data(), in.data(), 19);
+    // Variable-length messages for the multi-buffer engine, including the
+    // lengths around the padding boundaries.
+    std::vector<const unsigned char*> msgs;
+    std::vector<size_t> lens;
+    for (size_t len = 0; len <= 130; ++len) {
+        msgs.push_back(in.data() + len % 64);
+        lens.push_back(len);
+    }
+    for (int i = 0; i < 20; ++i) {
+        lens.push_back(InsecureRandRange(in.size() - 64));
+        msgs.push_back(in.data() + InsecureRandRange(64));
+    }
+    std::vector<unsigned char> ref_multi(32 * msgs.size());
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        CHash256().Write(msgs[i], lens[i]).Finalize(ref_multi.data() + 32 * i);
+    }
+    for (const auto impl : impls) {
+        BOOST_TEST_MESSAGE("Testing SHA256 implementation: " << SHA256AutoDetect(impl));
+        unsigned char hash[CSHA256::OUTPUT_SIZE];
+        std::vector<unsigned char> d64(32 * 19);
+        CSHA256().Write(in.data(), in.size() - 7).Finalize(hash);
+        SHA256D64(d64.data(), in.data(), 19);
+        BOOST_CHECK(memcmp(hash, ref_hash, sizeof(hash)) == 0);
+        BOOST_CHECK(d64 == ref_d64);
+        for (size_t count : {(size_t)0, (size_t)1, (size_t)3, (size_t)9, msgs.size()}) {
+            std::vector<unsigned char> multi(32 * count);
+            SHA256DMultiBuffer(multi.data(), msgs.data(), lens.data(), count);
+            BOOST_CHECK(std::equal(multi.begin(), multi.end(), ref_multi.begin()));
+        }
+    }
+    SHA256AutoDetect();
+}
+
+BOOST_AUTO_TEST_CASE(aes_implementations)
+{
+    // Random messages under one key, each with its own IV, as in a wallet.
+    std::vector<unsigned char> key(AES256_KEYSIZE);
+    for (auto& c : key) c = InsecureRandBits(8);
+    std::vector<std::vector<unsigned char>> plain(50), ivs(50), cipher_ref;
+    for (size_t i = 0; i < plain.size(); ++i) {
+        plain[i].resize(InsecureRandRange(100));
+        for (auto& c : plain[i]) c = InsecureRandBits(8);
+        ivs[i].resize(AES_BLOCKSIZE);
+        for (auto& c : ivs[i]) c = InsecureRandBits(8);
+    }
+
+    for (bool use_aesni : {false, true}) {
+        BOOST_TEST_MESSAGE("Testing AES implementation: " << AESAutoDetect(use_aesni));
+        TestAES256("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f", "00112233445566778899aabbccddeeff", "8ea2b7ca516745bfeafc49904b496089");
+        TestAES256CBC("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4", \
+                      "000102030405060708090A0B0C0D0E0F", true, "6bc1bee22e409f96e93d7e117393172a", \
+                      "f58c4c04d6e5f1ba779eabfb5f7bfbd6485a5c81519cf378fa36d42b8547edc0");
+
+        std::vector<std::vector<unsigned char>> cipher(plain.size()), out(plain.size());
+        std::vector<AESCBCMessage> msgs(plain.size());
+        for (size_t i = 0; i < plain.size(); ++i) {
+            cipher[i].resize(plain[i].size() + AES_BLOCKSIZE);
+            int size = AES256CBCEncrypt(key.data(), ivs[i].data(), true).Encrypt(plain[i].data(), plain[i].size(), cipher[i].data());
+            cipher[i].resize(size);
+            out[i].resize(size);
+            msgs[i] = {ivs[i].data(), cipher[i].data(), size, out[i].data(), 0};
+        }
+        // Both implementations must produce the same ciphertexts
+        if (cipher_ref.empty()) cipher_ref = cipher;
+        BOOST_CHECK(cipher == cipher_ref);
+
+        // A message with corrupted padding and one with a partial block fail
+        msgs[3].iv = ivs[4].data();
+        msgs[7].size -= 1;
+
+        AES256CBCBatchDecrypt(key.data(), true).Decrypt(msgs);
+        for (size_t i = 0; i < plain.size(); ++i) {
+            std::vector<unsigned char> single(cipher[i].size());
+            int written = AES256CBCDecrypt(key.data(), msgs[i].iv, true).Decrypt(cipher[i].data(), msgs[i].size, single.data());
+            BOOST_CHECK_EQUAL(msgs[i].written, written);
+            if (i == 7) {
+                BOOST_CHECK_EQUAL(written, 0);
+            } else if (i != 3) {
+                BOOST_CHECK_EQUAL(written, (int)plain[i].size());
+                BOOST_CHECK(std::equal(plain[i].begin(), plain[i].end(), out[i].begin()));
+                BOOST_CHECK(std::equal(plain[i].begin(), plain[i].end(), single.begin()));
+            }
+        }
+    }
+    AESAutoDetect();
+}
+
+BOOST_AUTO_TEST_CASE(sha512_implementations)
+{
+    std::vector<unsigned char> key(131), in(1000);
+    for (auto& c : key) c = InsecureRandBits(8);
+    for (auto& c : in) c = InsecureRandBits(8);
+    // Lengths around the padding boundaries, and some random ones
+    std::vector<const unsigned char*> msgs;
+    std::vector<size_t> lens;
+    for (size_t len = 0; len <= 260; len += 1 + len / 16) {
+        msgs.push_back(in.data() + len % 64);
+        lens.push_back(len);
+    }
+    for (int i = 0; i < 10; ++i) {
+        lens.push_back(InsecureRandRange(in.size() - 64));
+        msgs.push_back(in.data() + InsecureRandRange(64));
+    }
+
+    for (bool use_avx2 : {false, true}) {
+        BOOST_TEST_MESSAGE("Testing SHA512 implementation: " << SHA512AutoDetect(use_avx2));
+        std::vector<unsigned char> out(64 * msgs.size()), hmac_out(64 * msgs.size());
+        SHA512MultiBuffer(out.data(), nullptr, msgs.data(), lens.data(), msgs.size());
+        SHA512MultiBuffer(hmac_out.data(), in.data(), msgs.data(), lens.data(), msgs.size());
+        for (size_t i = 0; i < msgs.size(); ++i) {
+            unsigned char hash[CSHA512::OUTPUT_SIZE];
+            CSHA512().Write(msgs[i], lens[i]).Finalize(hash);
+            BOOST_CHECK(memcmp(hash, &out[64 * i], 64) == 0);
+            CSHA512().Write(in.data(), 128).Write(msgs[i], lens[i]).Finalize(hash);
+            BOOST_CHECK(memcmp(hash, &hmac_out[64 * i], 64) == 0);
+        }
+
+        // HMAC with a short key and with one longer than a block
+        for (size_t keylen : {(size_t)32, key.size()}) {
+            HMACSHA512Multi(hmac_out.data(), key.data(), keylen, msgs.data(), lens.data(), msgs.size());
+            for (size_t i = 0; i < msgs.size(); ++i) {
+                unsigned char hash[CHMAC_SHA512::OUTPUT_SIZE];
+                CHMAC_SHA512(key.data(), keylen).Write(msgs[i], lens[i]).Finalize(hash);
+                BOOST_CHECK(memcmp(hash, &hmac_out[64 * i], 64) == 0);
+            }
+        }
+    }
+    SHA512AutoDetect();
+}
+
 BOOST_AUTO_TEST_CASE(countbits_tests)
 {
     FastRandomContext ctx;
@@ -546,4 +715,68 @@ BOOST_AUTO_TEST_CASE(countbits_tests)
     }
 }
 
+static MuHash3072 MuHashFromInt(unsigned char i)
+{
+    unsigned char tmp[32] = {i, 0};
+    MuHash3072 ret;
+    ret.Insert(tmp, sizeof(tmp));
+    return ret;
+}
+
+static uint256 MuHashFinalize(MuHash3072 muhash)
+{
+    uint256 out;
+    muhash.Finalize(out.begin());
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    // Order of insertion does not matter, and removal undoes insertion.
+    for (int iter = 0; iter < 10; ++iter) {
+        std::vector<unsigned char> elems[4];
+        for (auto& elem : elems) {
+            elem = insecure_rand_ctx.randbytes(InsecureRandRange(100));
+        }
+        MuHash3072 forward, backward, removed;
+        for (int i = 0; i < 4; ++i) {
+            forward.Insert(elems[i].data(), elems[i].size());
+            backward.Insert(elems[3 - i].data(), elems[3 - i].size());
+            removed.Insert(elems[i].data(), elems[i].size());
+        }
+        removed.Remove(elems[1].data(), elems[1].size());
+        removed.Insert(elems[1].data(), elems[1].size());
+        BOOST_CHECK(MuHashFinalize(forward) == MuHashFinalize(backward));
+        BOOST_CHECK(MuHashFinalize(forward) == MuHashFinalize(removed));
+
+        MuHash3072 partial;
+        partial.Insert(elems[0].data(), elems[0].size());
+        partial.Insert(elems[1].data(), elems[1].size());
+        removed /= partial;
+        MuHash3072 rest;
+        rest.Insert(elems[2].data(), elems[2].size());
+        rest.Insert(elems[3].data(), elems[3].size());
+        BOOST_CHECK(MuHashFinalize(removed) == MuHashFinalize(rest));
+        rest *= partial;
+        BOOST_CHECK(MuHashFinalize(forward) == MuHashFinalize(rest));
+    }
+
+    // The empty set, and serialization.
+    MuHash3072 empty, acc = MuHashFromInt(0);
+    acc /= MuHashFromInt(0);
+    BOOST_CHECK(MuHashFinalize(acc) == MuHashFinalize(empty));
+    unsigned char data[MuHash3072::SERIALIZED_SIZE];
+    acc = MuHashFromInt(3);
+    acc /= MuHashFromInt(4);
+    acc.ToBytes(data);
+    MuHash3072 copy;
+    copy.FromBytes(data);
+    BOOST_CHECK(MuHashFinalize(copy) == MuHashFinalize(acc));
+
+    acc = MuHashFromInt(0);
+    acc *= MuHashFromInt(1);
+    acc /= MuHashFromInt(2);
+    BOOST_CHECK_EQUAL(MuHashFinalize(acc).GetHex(), "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -422,6 +422,10 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
 {
     CTxMemPool pool;
     TestMemPoolEntryHelper entry;
+    // The containers' own allocations (such as the txid index buckets) are
+    // counted too but do not shrink with the pool, so size limits below are
+    // taken relative to the usage of the empty pool.
+    const size_t emptyUsage = pool.DynamicMemoryUsage();
 
     CMutableTransaction tx1 = CMutableTransaction();
     tx1.vin.resize(1);
@@ -443,7 +447,7 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     BOOST_CHECK(pool.exists(tx1.GetHash()));
     BOOST_CHECK(pool.exists(tx2.GetHash()));
 
-    pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4); // should remove the lower-feerate transaction
+    pool.TrimToSize(emptyUsage + (pool.DynamicMemoryUsage() - emptyUsage) * 3 / 4); // should remove the lower-feerate transaction
     BOOST_CHECK(pool.exists(tx1.GetHash()));
     BOOST_CHECK(!pool.exists(tx2.GetHash()));
 
@@ -457,7 +461,7 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     tx3.vout[0].nValue = 10 * COIN;
     pool.addUnchecked(tx3.GetHash(), entry.Fee(20000LL).FromTx(tx3));
 
-    pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4); // tx3 should pay for tx2 (CPFP)
+    pool.TrimToSize(emptyUsage + (pool.DynamicMemoryUsage() - emptyUsage) * 3 / 4); // tx3 should pay for tx2 (CPFP)
     BOOST_CHECK(!pool.exists(tx1.GetHash()));
     BOOST_CHECK(pool.exists(tx2.GetHash()));
     BOOST_CHECK(pool.exists(tx3.GetHash()));
@@ -533,7 +537,9 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
         pool.addUnchecked(tx5.GetHash(), entry.Fee(1000LL).FromTx(tx5));
     pool.addUnchecked(tx7.GetHash(), entry.Fee(9000LL).FromTx(tx7));
 
-    pool.TrimToSize(pool.DynamicMemoryUsage() / 2); // should maximize mempool size by only removing 5/7
+    // Memory the containers keep once entries are removed (free node blocks,
+    // vTxHashes capacity) stays counted, so leave some room above half for it.
+    pool.TrimToSize(emptyUsage + (pool.DynamicMemoryUsage() - emptyUsage) * 3 / 5); // should maximize mempool size by only removing 5/7
     BOOST_CHECK(pool.exists(tx4.GetHash()));
     BOOST_CHECK(!pool.exists(tx5.GetHash()));
     BOOST_CHECK(pool.exists(tx6.GetHash()));
@@ -571,4 +577,168 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolDiamondTest)
+{
+    // A transaction reachable along two paths must be counted once, both in
+    // the ancestor and in the descendant walk.
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    LOCK(pool.cs);
+
+    CMutableTransaction txA;
+    txA.vin.resize(1);
+    txA.vin[0].scriptSig = CScript() << OP_1;
+    txA.vout.resize(2);
+    for (CTxOut& out : txA.vout) {
+        out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        out.nValue = 10 * COIN;
+    }
+    std::vector<CMutableTransaction> txMid(2);
+    for (int i = 0; i < 2; i++) {
+        txMid[i].vin.resize(1);
+        txMid[i].vin[0].prevout = COutPoint(txA.GetHash(), i);
+        txMid[i].vin[0].scriptSig = CScript() << OP_2;
+        txMid[i].vout.resize(1);
+        txMid[i].vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+        txMid[i].vout[0].nValue = 10 * COIN;
+    }
+    CMutableTransaction txD;
+    txD.vin.resize(2);
+    for (int i = 0; i < 2; i++) {
+        txD.vin[i].prevout = COutPoint(txMid[i].GetHash(), 0);
+        txD.vin[i].scriptSig = CScript() << OP_3;
+    }
+    txD.vout.resize(1);
+    txD.vout[0].scriptPubKey = CScript() << OP_3 << OP_EQUAL;
+    txD.vout[0].nValue = 20 * COIN;
+
+    pool.addUnchecked(txA.GetHash(), entry.Fee(1000LL).FromTx(txA));
+    pool.addUnchecked(txMid[0].GetHash(), entry.Fee(1000LL).FromTx(txMid[0]));
+    pool.addUnchecked(txMid[1].GetHash(), entry.Fee(1000LL).FromTx(txMid[1]));
+    pool.addUnchecked(txD.GetHash(), entry.Fee(1000LL).FromTx(txD));
+
+    CTxMemPool::txiter itA = pool.mapTx.find(txA.GetHash());
+    CTxMemPool::txiter itD = pool.mapTx.find(txD.GetHash());
+    BOOST_CHECK_EQUAL(itD->GetCountWithAncestors(), 4U);
+    BOOST_CHECK_EQUAL(itA->GetCountWithDescendants(), 4U);
+    BOOST_CHECK_EQUAL(pool.GetMemPoolChildren(itA).size(), 2U);
+    BOOST_CHECK_EQUAL(pool.GetMemPoolParents(itD).size(), 2U);
+
+    CTxMemPool::setEntries descendants;
+    pool.CalculateDescendants(itA, descendants);
+    BOOST_CHECK_EQUAL(descendants.size(), 4U);
+
+    pool.PrioritiseTransaction(txA.GetHash(), 500);
+    BOOST_CHECK_EQUAL(itD->GetModFeesWithAncestors(), 4500);
+    BOOST_CHECK_EQUAL(itA->GetModFeesWithDescendants(), 4500);
+
+    pool.removeForBlock({MakeTransactionRef(txA)}, 1);
+    BOOST_CHECK_EQUAL(itD->GetCountWithAncestors(), 3U);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(txMid[0].GetHash())->GetCountWithAncestors(), 1U);
+
+    pool.removeRecursive(txMid[0]);
+    BOOST_CHECK_EQUAL(pool.size(), 1U);
+    BOOST_CHECK(pool.exists(txMid[1].GetHash()));
+    BOOST_CHECK_EQUAL(pool.mapTx.find(txMid[1].GetHash())->GetCountWithDescendants(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSnapshotTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_1;
+    tx1.vout.resize(2);
+    for (CTxOut& out : tx1.vout) {
+        out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        out.nValue = 10 * COIN;
+    }
+    CMutableTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vin[0].scriptSig = CScript() << OP_2;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 10 * COIN;
+    CMutableTransaction tx3;
+    tx3.vin.resize(1);
+    tx3.vin[0].prevout = COutPoint(tx2.GetHash(), 0);
+    tx3.vin[0].scriptSig = CScript() << OP_3;
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_3 << OP_EQUAL;
+    tx3.vout[0].nValue = 10 * COIN;
+
+    {
+        LOCK(pool.cs);
+        pool.addUnchecked(tx1.GetHash(), entry.Fee(1000LL).FromTx(tx1));
+        pool.addUnchecked(tx2.GetHash(), entry.Fee(2000LL).FromTx(tx2));
+        pool.addUnchecked(tx3.GetHash(), entry.Fee(3000LL).FromTx(tx3));
+    }
+
+    std::shared_ptr<const CTxMemPoolSnapshot> snapshot = pool.GetSnapshot();
+    BOOST_CHECK_EQUAL(snapshot->entries.size(), 3U);
+    // Unchanged mempool: the same snapshot is handed out again.
+    BOOST_CHECK(pool.GetSnapshot() == snapshot);
+    BOOST_CHECK(snapshot->entries[0].GetHash() == tx1.GetHash());
+    BOOST_CHECK(snapshot->entries[2].GetHash() == tx3.GetHash());
+
+    const CTxMemPoolSnapshot::Entry& e2 = snapshot->entries[1];
+    BOOST_CHECK(e2.GetHash() == tx2.GetHash());
+    BOOST_CHECK_EQUAL(e2.nFee, 2000);
+    BOOST_CHECK_EQUAL(e2.nCountWithAncestors, 2U);
+    BOOST_CHECK_EQUAL(e2.nCountWithDescendants, 2U);
+    BOOST_CHECK(e2.vParents == std::vector<uint256>{tx1.GetHash()});
+    BOOST_CHECK(e2.vChildren == std::vector<uint256>{tx3.GetHash()});
+
+    CTxMemPoolSnapshot::Entry single;
+    BOOST_CHECK(pool.GetSnapshotEntry(tx2.GetHash(), single));
+    BOOST_CHECK(single.vParents == e2.vParents);
+    BOOST_CHECK(!pool.GetSnapshotEntry(uint256(), single));
+
+    // Ancestors and descendants exclude the entry itself and come sorted by txid.
+    std::vector<CTxMemPoolSnapshot::Entry> related;
+    BOOST_CHECK(pool.GetSnapshotAncestors(tx3.GetHash(), related));
+    BOOST_REQUIRE_EQUAL(related.size(), 2U);
+    BOOST_CHECK(related[0].GetHash() < related[1].GetHash());
+    BOOST_CHECK(related[0].GetHash() != tx3.GetHash() && related[1].GetHash() != tx3.GetHash());
+    BOOST_CHECK(pool.GetSnapshotDescendants(tx3.GetHash(), related));
+    BOOST_CHECK(related.empty());
+    BOOST_CHECK(pool.GetSnapshotDescendants(tx1.GetHash(), related));
+    BOOST_REQUIRE_EQUAL(related.size(), 2U);
+    BOOST_CHECK(related[0].GetHash() < related[1].GetHash());
+    BOOST_CHECK(!pool.GetSnapshotAncestors(uint256(), related));
+    BOOST_CHECK(!pool.GetSnapshotDescendants(uint256(), related));
+
+    // Any change is picked up, while the old snapshot stays as it was.
+    pool.PrioritiseTransaction(tx1.GetHash(), 500);
+    std::shared_ptr<const CTxMemPoolSnapshot> prioritised = pool.GetSnapshot();
+    BOOST_CHECK_EQUAL(prioritised->entries[2].nModFeesWithAncestors, 6500);
+    BOOST_CHECK_EQUAL(snapshot->entries[2].nModFeesWithAncestors, 6000);
+
+    BOOST_CHECK(prioritised != snapshot);
+    BOOST_CHECK(pool.GetSnapshot() == prioritised);
+
+    // Removing entries releases the cached snapshot, so it does not keep the
+    // removed transactions alive once no reader holds it.
+    std::weak_ptr<const CTxMemPoolSnapshot> cached = prioritised;
+    prioritised.reset();
+    BOOST_CHECK(!cached.expired());
+    pool.removeRecursive(tx2);
+    BOOST_CHECK(cached.expired());
+    std::shared_ptr<const CTxMemPoolSnapshot> removed = pool.GetSnapshot();
+    BOOST_CHECK_EQUAL(removed->entries.size(), 1U);
+    BOOST_CHECK(removed->entries[0].vChildren.empty());
+    BOOST_CHECK_EQUAL(snapshot->entries.size(), 3U);
+
+    // infoAll() and queryHashes() read the live pool in the same order.
+    std::vector<TxMempoolInfo> infos = pool.infoAll();
+    BOOST_REQUIRE_EQUAL(infos.size(), 1U);
+    BOOST_CHECK(infos[0].tx->GetHash() == tx1.GetHash());
+    std::vector<uint256> txids;
+    pool.queryHashes(txids);
+    BOOST_CHECK(txids == std::vector<uint256>{tx1.GetHash()});
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -155,6 +155,14 @@ BOOST_AUTO_TEST_CASE(sighash_test)
         std::cout << "\n";
         #endif
         BOOST_CHECK(sh == sho);
+
+        // The legacy sighash cache must not change the result, and is only
+        // built once a signature hash asks for it
+        PrecomputedTransactionData txdata(txTo);
+        BOOST_CHECK(!txdata.legacy || txdata.legacy->cache.midstates.empty());
+        BOOST_CHECK(SignatureHash(scriptCode, txTo, nIn, nHashType, 0, SigVersion::BASE, &txdata) == sho);
+        BOOST_CHECK(!txdata.legacy || ((nHashType & 0x1f) == SIGHASH_SINGLE && nIn >= (int)txTo.vout.size()) ||
+                    txdata.legacy->cache.midstates.size() == txTo.vin.size());
     }
     #if defined(PRINT_SIGHASH_JSON)
     std::cout << "]\n";
@@ -206,6 +214,10 @@ BOOST_AUTO_TEST_CASE(sighash_from_data)
 
         sh = SignatureHash(scriptCode, *tx, nIn, nHashType, 0, SigVersion::BASE);
         BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
+
+        PrecomputedTransactionData txdata(*tx);
+        sh = SignatureHash(scriptCode, *tx, nIn, nHashType, 0, SigVersion::BASE, &txdata);
+        BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
     }
 }
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,7 +7,9 @@
 #include <chainparams.h>
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <crypto/aes.h>
 #include <crypto/sha256.h>
+#include <crypto/sha512.h>
 #include <validation.h>
 #include <miner.h>
 #include <net_processing.h>
@@ -48,6 +50,8 @@ std::ostream& operator<<(std::ostream& os, const uint256& num)
 BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
 {
         SHA256AutoDetect();
+        SHA512AutoDetect();
+        AESAutoDetect();
         RandomInit();
         ECC_Start();
         SetupEnvironment();
@@ -84,7 +88,8 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         mempool.setSanityCheck(1.0);
         pblocktree.reset(new CBlockTreeDB(1 << 20, true));
         pcoinsdbview.reset(new CCoinsViewDB(1 << 23, true));
-        pcoinsTip.reset(new CCoinsViewCache(pcoinsdbview.get()));
+        pcoinsflushview.reset(new CCoinsViewBackgroundFlush(pcoinsdbview.get(), true));
+        pcoinsTip.reset(new CCoinsViewCache(pcoinsflushview.get()));
         if (!LoadGenesisBlock(chainparams)) {
             throw std::runtime_error("LoadGenesisBlock failed.");
         }
@@ -95,8 +100,13 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
             }
         }
         nScriptCheckThreads = 3;
-        for (int i=0; i < nScriptCheckThreads-1; i++)
+        for (int i=0; i < nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadCoinsPrefetch);
+        }
+        nBlockReadAhead = DEFAULT_BLOCK_READAHEAD;
+        for (int i = 0; i < BLOCK_READAHEAD_THREADS; i++)
+            threadGroup.create_thread(&ThreadBlockReadAhead);
         g_connman = std::unique_ptr<CConnman>(new CConnman(0x1337, 0x1337)); // Deterministic randomness for tests.
         connman = g_connman.get();
         peerLogic.reset(new PeerLogicValidation(connman, scheduler));
@@ -112,6 +122,7 @@ TestingSetup::~TestingSetup()
         peerLogic.reset();
         UnloadBlockIndex();
         pcoinsTip.reset();
+        pcoinsflushview.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
         fs::remove_all(pathTemp);
@@ -760,4 +760,48 @@ BOOST_AUTO_TEST_CASE(test_IsStandard)
     BOOST_CHECK(!IsStandardTx(t, reason));
 }
 
+BOOST_AUTO_TEST_CASE(batch_transaction_hashes)
+{
+    // A mix of transactions with and without witnesses, of varying sizes.
+    std::vector<CMutableTransaction> txs(37);
+    for (size_t i = 0; i < txs.size(); ++i) {
+        CMutableTransaction& mtx = txs[i];
+        mtx.nLockTime = i;
+        mtx.vin.resize(1 + i % 5);
+        for (size_t j = 0; j < mtx.vin.size(); ++j) {
+            mtx.vin[j].prevout = COutPoint(InsecureRand256(), j);
+            mtx.vin[j].scriptSig = CScript() << std::vector<unsigned char>(i * 3, 0x42);
+            if (i % 3 == 0) mtx.vin[j].scriptWitness.stack.push_back(std::vector<unsigned char>(i + j, 0x17));
+        }
+        mtx.vout.resize(1 + i % 2);
+        mtx.vout[0].nValue = i;
+    }
+
+    std::vector<uint256> txids, wtxids;
+    ComputeTransactionHashes(txs, txids, wtxids);
+    BOOST_CHECK_EQUAL(txids.size(), txs.size());
+    BOOST_CHECK_EQUAL(wtxids.size(), txs.size());
+    std::vector<CTransactionRef> refs = MakeTransactionRefs(std::vector<CMutableTransaction>(txs));
+    for (size_t i = 0; i < txs.size(); ++i) {
+        CTransaction tx(txs[i]);
+        BOOST_CHECK(txids[i] == tx.GetHash());
+        BOOST_CHECK(wtxids[i] == tx.GetWitnessHash());
+        BOOST_CHECK(refs[i]->GetHash() == tx.GetHash());
+        BOOST_CHECK(refs[i]->GetWitnessHash() == tx.GetWitnessHash());
+    }
+
+    // Round trip a block through its batched deserialization.
+    CBlock block;
+    block.vtx = refs;
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << block;
+    CBlock block2;
+    stream >> block2;
+    BOOST_CHECK_EQUAL(block2.vtx.size(), block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        BOOST_CHECK(block2.vtx[i]->GetHash() == block.vtx[i]->GetHash());
+        BOOST_CHECK(block2.vtx[i]->GetWitnessHash() == block.vtx[i]->GetWitnessHash());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,264 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <script/script.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <memory>
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, TestChain100Setup)
+
+static std::map<uint256, CDiskBlockIndex> ReadEntries(CBlockTreeDB& db, bool from_headers_file)
+{
+    std::vector<std::pair<uint256, CDiskBlockIndex>> entries;
+    const Consensus::Params& params = Params().GetConsensus();
+    BOOST_CHECK(from_headers_file ? db.ReadHeadersFile(params, entries, 2) : db.ReadBlockIndexDB(params, entries, 2));
+    std::map<uint256, CDiskBlockIndex> ret;
+    for (const auto& entry : entries) {
+        BOOST_CHECK(ret.emplace(entry.first, entry.second).second);
+    }
+    return ret;
+}
+
+static void CheckEntries(const std::map<uint256, CDiskBlockIndex>& entries)
+{
+    AssertLockHeld(cs_main);
+    BOOST_CHECK_EQUAL(entries.size(), mapBlockIndex.size());
+    for (const auto& item : mapBlockIndex) {
+        const CDiskBlockIndex expected(item.second);
+        auto it = entries.find(item.first);
+        BOOST_REQUIRE(it != entries.end());
+        BOOST_CHECK(it->second.hashPrev == expected.hashPrev);
+        BOOST_CHECK_EQUAL(it->second.nHeight, expected.nHeight);
+        BOOST_CHECK_EQUAL(it->second.nStatus, expected.nStatus);
+        BOOST_CHECK_EQUAL(it->second.nTx, expected.nTx);
+        BOOST_CHECK_EQUAL(it->second.nFile, expected.nFile);
+        BOOST_CHECK_EQUAL(it->second.nDataPos, expected.nDataPos);
+        BOOST_CHECK_EQUAL(it->second.nUndoPos, expected.nUndoPos);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(headers_file)
+{
+    LOCK(cs_main);
+    std::vector<CBlockIndex*> blocks;
+    for (const auto& item : mapBlockIndex) {
+        blocks.push_back(item.second);
+    }
+    const fs::path path = GetBlocksDir() / "headers.dat";
+
+    {
+        CBlockTreeDB db(1 << 20, false, true);
+        // Without a headers file the entries come from the database, which
+        // is empty here, and the file is started.
+        std::vector<std::pair<uint256, CDiskBlockIndex>> entries;
+        BOOST_CHECK(db.LoadBlockIndexGuts(Params().GetConsensus(), entries, 2));
+        BOOST_CHECK(entries.empty());
+        BOOST_CHECK(fs::exists(path));
+
+        BOOST_CHECK(db.WriteBatchSync({}, 0, blocks));
+        // Write some entries again, as a status change would.
+        std::vector<CBlockIndex*> updated(blocks.begin(), blocks.begin() + 10);
+        for (CBlockIndex* pindex : updated) pindex->nStatus |= BLOCK_OPT_WITNESS;
+        BOOST_CHECK(db.WriteBatchSync({}, 0, updated));
+    }
+
+    {
+        CBlockTreeDB db(1 << 20);
+        CheckEntries(ReadEntries(db, false));
+        // Superseded records are skipped.
+        CheckEntries(ReadEntries(db, true));
+    }
+
+    // An append that did not commit leaves bytes past the committed length,
+    // which are ignored.
+    {
+        FILE* file = fsbridge::fopen(path, "ab");
+        BOOST_REQUIRE(file);
+        fwrite("garbage", 1, 7, file);
+        fclose(file);
+        CBlockTreeDB db(1 << 20);
+        CheckEntries(ReadEntries(db, true));
+    }
+
+    // A damaged file is not used; loading falls back to the database and
+    // rewrites the file.
+    {
+        FILE* file = fsbridge::fopen(path, "rb+");
+        BOOST_REQUIRE(file);
+        BOOST_CHECK(TruncateFile(file, fs::file_size(path) - 1));
+        fclose(file);
+        CBlockTreeDB db(1 << 20);
+        std::vector<std::pair<uint256, CDiskBlockIndex>> entries;
+        BOOST_CHECK(!db.ReadHeadersFile(Params().GetConsensus(), entries, 2));
+        BOOST_CHECK(entries.empty());
+        BOOST_CHECK(db.LoadBlockIndexGuts(Params().GetConsensus(), entries, 2));
+        BOOST_CHECK_EQUAL(entries.size(), mapBlockIndex.size());
+        CheckEntries(ReadEntries(db, true));
+    }
+
+    // Appends continue a file that was read back.
+    {
+        CBlockTreeDB db(1 << 20);
+        std::vector<std::pair<uint256, CDiskBlockIndex>> entries;
+        BOOST_CHECK(db.LoadBlockIndexGuts(Params().GetConsensus(), entries, 2));
+        for (const auto& entry : entries) {
+            mapBlockIndex.find(entry.first)->second->nHeaderRecord = entry.second.nHeaderRecord;
+        }
+        std::vector<CBlockIndex*> updated(blocks.end() - 5, blocks.end());
+        for (CBlockIndex* pindex : updated) pindex->nStatus &= ~BLOCK_OPT_WITNESS;
+        BOOST_CHECK(db.WriteBatchSync({}, 0, updated));
+        CheckEntries(ReadEntries(db, true));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(background_flush)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewBackgroundFlush flush(&db, true);
+    CCoinsViewCache cache(&flush);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 1000; ++i) {
+        outpoints.emplace_back(InsecureRand256(), i);
+        CTxOut txout(i + 1, CScript() << OP_TRUE);
+        cache.AddCoin(outpoints.back(), Coin(txout, 1, false), false);
+    }
+    const uint256 block1 = InsecureRand256();
+    cache.SetBestBlock(block1);
+    BOOST_CHECK(cache.Flush());
+
+    // Whether or not the write has finished, reads see the flushed state.
+    BOOST_CHECK(flush.GetBestBlock() == block1);
+    for (const COutPoint& outpoint : outpoints) {
+        BOOST_CHECK(cache.HaveCoin(outpoint));
+    }
+
+    // Spend half of the coins in a second flush, which waits for the first.
+    for (size_t i = 0; i < outpoints.size(); i += 2) {
+        BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+    }
+    const uint256 block2 = InsecureRand256();
+    cache.SetBestBlock(block2);
+    BOOST_CHECK(cache.Flush());
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        BOOST_CHECK_EQUAL(cache.HaveCoin(outpoints[i]), i % 2 == 1);
+    }
+    CRollingCoinsStats in_flight;
+    BOOST_CHECK(flush.GetRollingStats(in_flight));
+
+    BOOST_CHECK(flush.Wait());
+    BOOST_CHECK(db.GetBestBlock() == block2);
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        BOOST_CHECK_EQUAL(db.HaveCoin(outpoints[i]), i % 2 == 1);
+    }
+    CRollingCoinsStats written;
+    BOOST_CHECK(db.GetRollingStats(written));
+    BOOST_CHECK_EQUAL(written.nTransactionOutputs, 500);
+    BOOST_CHECK_EQUAL(in_flight.nTransactionOutputs, written.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(in_flight.nTotalAmount, written.nTotalAmount);
+
+    CoinsFlushStats stats = flush.GetStats();
+    BOOST_CHECK_EQUAL(stats.count, 2U);
+    // The second flush also carries the coins read back into the cache.
+    BOOST_CHECK_EQUAL(stats.coins, 2000U);
+    BOOST_CHECK(!stats.in_progress);
+    BOOST_CHECK_EQUAL(stats.snapshot_usage, 0U);
+}
+
+static std::vector<std::pair<COutPoint, CAmount>> ReadCursor(CCoinsView& view)
+{
+    std::vector<std::pair<COutPoint, CAmount>> ret;
+    std::unique_ptr<CCoinsViewCursor> pcursor(view.Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        COutPoint outpoint;
+        Coin coin;
+        BOOST_CHECK(pcursor->GetKey(outpoint) && pcursor->GetValue(coin));
+        ret.emplace_back(outpoint, coin.out.nValue);
+    }
+    return ret;
+}
+
+BOOST_AUTO_TEST_CASE(sharded_chainstate)
+{
+    CCoinsViewDB db(1 << 20, true);
+    BOOST_CHECK_EQUAL(db.ShardCount(), 1U);
+    CCoinsViewCache cache(&db);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 1000; ++i) {
+        // Several outputs of one transaction end up in different shards.
+        outpoints.emplace_back(i % 2 ? outpoints.back().hash : InsecureRand256(), i);
+        CTxOut txout(i + 1, CScript() << OP_TRUE);
+        cache.AddCoin(outpoints.back(), Coin(txout, 1, false), false);
+    }
+    const uint256 block1 = InsecureRand256();
+    cache.SetBestBlock(block1);
+    BOOST_CHECK(cache.Flush());
+    const auto unsharded = ReadCursor(db);
+    BOOST_CHECK_EQUAL(unsharded.size(), outpoints.size());
+
+    BOOST_CHECK(db.Reshard(4));
+    BOOST_CHECK_EQUAL(db.ShardCount(), 4U);
+    BOOST_CHECK(db.GetBestBlock() == block1);
+    // The cursor merges the shards back into the order of one database.
+    BOOST_CHECK(ReadCursor(db) == unsharded);
+
+    // Spend half of the coins through the shards.
+    for (size_t i = 0; i < outpoints.size(); i += 2) {
+        BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+    }
+    const uint256 block2 = InsecureRand256();
+    cache.SetBestBlock(block2);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(db.GetBestBlock() == block2);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        BOOST_CHECK_EQUAL(db.HaveCoin(outpoints[i]), i % 2 == 1);
+    }
+    const auto sharded = ReadCursor(db);
+    BOOST_CHECK_EQUAL(sharded.size(), 500U);
+
+    // Moving to another number of shards, and back into the main database,
+    // keeps the same set.
+    BOOST_CHECK(db.Reshard(3));
+    BOOST_CHECK_EQUAL(db.ShardCount(), 3U);
+    BOOST_CHECK(ReadCursor(db) == sharded);
+    BOOST_CHECK(db.Reshard(1));
+    BOOST_CHECK_EQUAL(db.ShardCount(), 1U);
+    BOOST_CHECK(ReadCursor(db) == sharded);
+    CRollingCoinsStats stats;
+    BOOST_CHECK(db.GetRollingStats(stats));
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, 500);
+
+    // On disk, the layout is found again at startup and the shards of
+    // other layouts are removed.
+    {
+        CCoinsViewDB disk(1 << 20, false, true);
+        CCoinsViewCache disk_cache(&disk);
+        disk_cache.AddCoin(outpoints[1], Coin(CTxOut(1, CScript() << OP_TRUE), 1, false), false);
+        disk_cache.SetBestBlock(block1);
+        BOOST_CHECK(disk_cache.Flush());
+        BOOST_CHECK(disk.Reshard(2));
+        BOOST_CHECK(disk.Reshard(5));
+    }
+    {
+        CCoinsViewDB disk(1 << 20);
+        BOOST_CHECK_EQUAL(disk.ShardCount(), 5U);
+        BOOST_CHECK(disk.HaveCoin(outpoints[1]));
+        BOOST_CHECK(disk.GetBestBlock() == block1);
+        BOOST_CHECK(fs::exists(GetDataDir() / "chainstate_shards" / "5"));
+        BOOST_CHECK(!fs::exists(GetDataDir() / "chainstate_shards" / "2"));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
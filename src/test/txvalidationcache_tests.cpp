@@ -9,6 +9,7 @@
 #include <pubkey.h>
 #include <txmempool.h>
 #include <random.h>
+#include <script/sigcache.h>
 #include <script/standard.h>
 #include <script/sign.h>
 #include <test/test_bitcoin.h>
@@ -368,4 +369,117 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, TestChain100Setup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(mempool_parallel_script_checks, TestChain100Setup)
+{
+    // The test setup runs script check threads, so a multi-input transaction
+    // has its scripts checked in parallel on the way into the mempool. A bad
+    // input anywhere must still be reported the way a serial check would.
+    BOOST_REQUIRE(nScriptCheckThreads > 0);
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const unsigned int num_inputs = 8;
+    static_assert(num_inputs >= MEMPOOL_PARALLEL_CHECK_MIN_INPUTS, "must take the parallel path");
+
+    CMutableTransaction fan;
+    fan.nVersion = 1;
+    fan.vin.resize(1);
+    fan.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHash(), 0);
+    fan.vout.resize(num_inputs);
+    for (CTxOut& out : fan.vout) {
+        out.nValue = 1 * CENT;
+        out.scriptPubKey = scriptPubKey;
+    }
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(coinbaseKey.Sign(SignatureHash(scriptPubKey, fan, 0, SIGHASH_ALL, 0, SigVersion::BASE), vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    fan.vin[0].scriptSig << vchSig;
+    CreateAndProcessBlock({fan}, scriptPubKey);
+    BOOST_REQUIRE(pcoinsTip->HaveCoin(COutPoint(fan.GetHash(), 0)));
+
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(num_inputs);
+    for (unsigned int i = 0; i < num_inputs; ++i) {
+        spend.vin[i].prevout = COutPoint(fan.GetHash(), i);
+    }
+    spend.vout.resize(1);
+    spend.vout[0].nValue = (num_inputs - 1) * CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    std::vector<std::vector<unsigned char>> sigs(num_inputs);
+    for (unsigned int i = 0; i < num_inputs; ++i) {
+        BOOST_CHECK(coinbaseKey.Sign(SignatureHash(scriptPubKey, spend, i, SIGHASH_ALL, 0, SigVersion::BASE), sigs[i]));
+        sigs[i].push_back((unsigned char)SIGHASH_ALL);
+        spend.vin[i].scriptSig = CScript() << sigs[i];
+    }
+
+    LOCK(cs_main);
+
+    // An invalid signature on one input is a consensus failure.
+    CMutableTransaction bad_sig = spend;
+    bad_sig.vin[5].scriptSig = CScript() << sigs[4];
+    CValidationState state;
+    BOOST_CHECK(!AcceptToMemoryPool(mempool, state, MakeTransactionRef(bad_sig), nullptr, nullptr, true, 0));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "mandatory-script-verify-flag-failed (Signature must be zero for failed CHECK(MULTI)SIG operation)");
+    BOOST_CHECK_EQUAL(state.GetRejectCode(), REJECT_INVALID);
+
+    // A valid signature pushed with a non-minimal opcode only breaks policy.
+    CMutableTransaction bad_push = spend;
+    CScript non_minimal;
+    non_minimal.push_back(OP_PUSHDATA1);
+    non_minimal.push_back((unsigned char)sigs[2].size());
+    non_minimal.insert(non_minimal.end(), sigs[2].begin(), sigs[2].end());
+    bad_push.vin[2].scriptSig = non_minimal;
+    state = CValidationState();
+    BOOST_CHECK(!AcceptToMemoryPool(mempool, state, MakeTransactionRef(bad_push), nullptr, nullptr, true, 0));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "non-mandatory-script-verify-flag (Data push larger than necessary)");
+    BOOST_CHECK_EQUAL(state.GetRejectCode(), REJECT_NONSTANDARD);
+
+    state = CValidationState();
+    BOOST_CHECK(AcceptToMemoryPool(mempool, state, MakeTransactionRef(spend), nullptr, nullptr, true, 0));
+    BOOST_CHECK(mempool.exists(spend.GetHash()));
+    BOOST_CHECK_EQUAL(mempool.size(), 1U);
+    mempool.clear();
+}
+
+BOOST_FIXTURE_TEST_CASE(pubkey_cache, BasicTestingSetup)
+{
+    // Two P2PKH inputs signed by the same key: the second signature check
+    // must find the key already parsed, and a bad signature must still fail.
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    CMutableTransaction tx;
+    tx.vin.resize(2);
+    tx.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    tx.vin[1].prevout = COutPoint(InsecureRand256(), 1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1;
+    for (int i = 0; i < 2; ++i) {
+        std::vector<unsigned char> vchSig;
+        BOOST_CHECK(key.Sign(SignatureHash(scriptPubKey, tx, i, SIGHASH_ALL, 0, SigVersion::BASE), vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[i].scriptSig = CScript() << vchSig << ToByteVector(key.GetPubKey());
+    }
+    const CTransaction txConst(tx);
+    PrecomputedTransactionData txdata(txConst);
+
+    const PubKeyCacheStats before = GetPubKeyCacheStats();
+    for (unsigned int i = 0; i < 2; ++i) {
+        CachingTransactionSignatureChecker checker(&txConst, i, 0, false, txdata);
+        BOOST_CHECK(VerifyScript(txConst.vin[i].scriptSig, scriptPubKey, nullptr, SCRIPT_VERIFY_P2SH, checker));
+    }
+    const PubKeyCacheStats after = GetPubKeyCacheStats();
+    BOOST_CHECK_EQUAL(after.misses, before.misses + 1);
+    BOOST_CHECK_EQUAL(after.hits, before.hits + 1);
+    BOOST_CHECK(after.entries >= 1 && after.entries <= after.capacity);
+
+    // Swap the scriptSigs: the key is cached but the signatures don't match.
+    std::swap(tx.vin[0].scriptSig, tx.vin[1].scriptSig);
+    const CTransaction txSwapped(tx);
+    PrecomputedTransactionData txdataSwapped(txSwapped);
+    CachingTransactionSignatureChecker checker(&txSwapped, 0, 0, false, txdataSwapped);
+    BOOST_CHECK(!VerifyScript(txSwapped.vin[0].scriptSig, scriptPubKey, nullptr, SCRIPT_VERIFY_P2SH, checker));
+    BOOST_CHECK_EQUAL(GetPubKeyCacheStats().hits, after.hits + 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
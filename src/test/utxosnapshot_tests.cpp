@@ -0,0 +1,122 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <coins.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+#include <txdb.h>
+#include <utxosnapshot.h>
+#include <validation.h>
+
+#include <memory>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(utxosnapshot_tests, TestChain100Setup)
+
+static SnapshotInfo DumpTip(const fs::path& path)
+{
+    FlushStateToDisk();
+    std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+    SnapshotInfo info;
+    std::string error;
+    BOOST_REQUIRE_MESSAGE(DumpSnapshot(pcursor.get(), Params().MessageStart(), path, info, error), error);
+    return info;
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_roundtrip)
+{
+    const fs::path path = pathTemp / "utxo.dat";
+    SnapshotInfo info = DumpTip(path);
+    BOOST_CHECK(!fs::exists(path.string() + ".incomplete"));
+    BOOST_CHECK_EQUAL(fs::file_size(path), info.nBytes);
+    BOOST_CHECK(info.base_blockhash == chainActive.Tip()->GetBlockHash());
+
+    size_t coins = 0;
+    std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) ++coins;
+    BOOST_CHECK_EQUAL(info.coins_count, coins);
+    BOOST_CHECK(coins > 0);
+
+    SnapshotInfo read;
+    std::string error;
+    BOOST_REQUIRE_MESSAGE(ReadSnapshotInfo(path, Params().MessageStart(), read, error), error);
+    BOOST_CHECK(read.base_blockhash == info.base_blockhash);
+    BOOST_CHECK(read.hash == info.hash);
+    BOOST_CHECK_EQUAL(read.coins_count, info.coins_count);
+    BOOST_CHECK_EQUAL(read.nBytes, info.nBytes);
+
+    // Load into an empty database; it stays marked as in transition until
+    // the snapshot base is written as its best block.
+    CCoinsViewDB db(1 << 20, true);
+    BOOST_REQUIRE_MESSAGE(LoadSnapshotCoins(path, read, db, error), error);
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+    std::vector<uint256> heads = db.GetHeadBlocks();
+    BOOST_REQUIRE_EQUAL(heads.size(), 2U);
+    BOOST_CHECK(heads[0] == info.base_blockhash);
+    CCoinsMap empty;
+    BOOST_CHECK(db.BatchWrite(empty, info.base_blockhash, {}));
+    BOOST_CHECK(db.GetBestBlock() == info.base_blockhash);
+
+    // The rolling statistics of the loaded set match those of the tip.
+    CRollingCoinsStats tip_stats, loaded_stats;
+    BOOST_REQUIRE(pcoinsTip->GetRollingStats(tip_stats));
+    BOOST_REQUIRE(db.GetRollingStats(loaded_stats));
+    BOOST_CHECK_EQUAL(loaded_stats.nTransactionOutputs, tip_stats.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(loaded_stats.nTotalAmount, tip_stats.nTotalAmount);
+    unsigned char tip_hash[MuHash3072::OUTPUT_SIZE], loaded_hash[MuHash3072::OUTPUT_SIZE];
+    tip_stats.muhash.Finalize(tip_hash);
+    loaded_stats.muhash.Finalize(loaded_hash);
+    BOOST_CHECK(memcmp(tip_hash, loaded_hash, sizeof(tip_hash)) == 0);
+
+    coins = 0;
+    for (pcursor.reset(pcoinsdbview->Cursor()); pcursor->Valid(); pcursor->Next()) {
+        COutPoint outpoint;
+        Coin coin, loaded;
+        BOOST_REQUIRE(pcursor->GetKey(outpoint) && pcursor->GetValue(coin));
+        BOOST_REQUIRE(db.GetCoin(outpoint, loaded));
+        BOOST_CHECK(loaded.out == coin.out);
+        BOOST_CHECK_EQUAL(loaded.nHeight, coin.nHeight);
+        BOOST_CHECK_EQUAL(loaded.fCoinBase, coin.fCoinBase);
+        ++coins;
+    }
+    std::unique_ptr<CCoinsViewCursor> ploaded(db.Cursor());
+    for (; ploaded->Valid(); ploaded->Next()) --coins;
+    BOOST_CHECK_EQUAL(coins, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_reject)
+{
+    const fs::path path = pathTemp / "utxo.dat";
+    SnapshotInfo info = DumpTip(path);
+    SnapshotInfo read;
+    std::string error;
+
+    // Wrong network
+    BOOST_CHECK(!ReadSnapshotInfo(path, CreateChainParams(CBaseChainParams::MAIN)->MessageStart(), read, error));
+
+    // Any flipped byte breaks the hash
+    {
+        FILE* file = fsbridge::fopen(path, "rb+");
+        BOOST_REQUIRE(file);
+        BOOST_REQUIRE_EQUAL(fseek(file, info.nBytes / 2, SEEK_SET), 0);
+        int c = fgetc(file);
+        BOOST_REQUIRE_EQUAL(fseek(file, info.nBytes / 2, SEEK_SET), 0);
+        fputc(c ^ 1, file);
+        fclose(file);
+    }
+    BOOST_CHECK(!ReadSnapshotInfo(path, Params().MessageStart(), read, error));
+
+    // Truncated
+    {
+        FILE* file = fsbridge::fopen(path, "rb+");
+        BOOST_REQUIRE(file);
+        BOOST_REQUIRE(TruncateFile(file, 20));
+        fclose(file);
+    }
+    BOOST_CHECK(!ReadSnapshotInfo(path, Params().MessageStart(), read, error));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -181,4 +181,58 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK_EQUAL(sub.m_expected_tip, chainActive.Tip()->GetBlockHash());
 }
 
+BOOST_AUTO_TEST_CASE(reload_block_index)
+{
+    // A tree of blocks with some forks, all of them connected or tried
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    while (blocks.size() < 50) {
+        blocks.clear();
+        BuildChain(Params().GenesisBlock().GetHash(), 100, 0, 15, 500, blocks);
+    }
+    bool ignored;
+    for (const auto& block : blocks) {
+        ProcessNewBlock(Params(), block, true, &ignored);
+    }
+    FlushStateToDisk();
+
+    struct Entry {
+        int height;
+        arith_uint256 chain_work;
+        unsigned int chain_tx;
+        uint32_t status;
+        uint256 prev;
+        uint256 skip;
+    };
+    std::map<uint256, Entry> before;
+    LOCK(cs_main);
+    for (const auto& item : mapBlockIndex) {
+        const CBlockIndex* pindex = item.second;
+        before[item.first] = Entry{pindex->nHeight, pindex->nChainWork, pindex->nChainTx, pindex->nStatus,
+            pindex->pprev ? pindex->pprev->GetBlockHash() : uint256(), pindex->pskip ? pindex->pskip->GetBlockHash() : uint256()};
+    }
+    const uint256 best_header = pindexBestHeader->GetBlockHash();
+    const uint256 tip = chainActive.Tip()->GetBlockHash();
+
+    UnloadBlockIndex();
+    BOOST_REQUIRE(LoadBlockIndex(Params()));
+    BOOST_REQUIRE(LoadChainTip(Params()));
+
+    BOOST_CHECK_EQUAL(mapBlockIndex.size(), before.size());
+    for (const auto& item : mapBlockIndex) {
+        const CBlockIndex* pindex = item.second;
+        BOOST_CHECK(pindex->GetBlockHash() == item.first);
+        auto it = before.find(item.first);
+        BOOST_REQUIRE(it != before.end());
+        BOOST_CHECK_EQUAL(pindex->nHeight, it->second.height);
+        BOOST_CHECK(pindex->nChainWork == it->second.chain_work);
+        BOOST_CHECK_EQUAL(pindex->nChainTx, it->second.chain_tx);
+        BOOST_CHECK_EQUAL(pindex->nStatus, it->second.status);
+        BOOST_CHECK((pindex->pprev ? pindex->pprev->GetBlockHash() : uint256()) == it->second.prev);
+        BOOST_CHECK((pindex->pskip ? pindex->pskip->GetBlockHash() : uint256()) == it->second.skip);
+    }
+    // Among headers with the same work, which one is best is not kept.
+    BOOST_CHECK(pindexBestHeader->nChainWork == before[best_header].chain_work);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == tip);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -14,7 +14,10 @@
 #include <ui_interface.h>
 #include <init.h>
 
+#include <exception>
+#include <limits>
 #include <stdint.h>
+#include <thread>
 
 #include <boost/thread.hpp>
 
@@ -24,12 +27,15 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_TXINDEX_BLOCK = 'T';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_HEADERS_FILE = 'h';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
+static const char DB_COINS_STATS = 'S';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_SHARDS = 'N';
 
 namespace {
 
@@ -53,18 +59,115 @@ struct CoinEntry {
     }
 };
 
+//! The number of coin databases and the salt that assigns outpoints to them
+struct ShardInfo {
+    uint32_t count;
+    uint64_t k0;
+    uint64_t k1;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(count);
+        READWRITE(k0);
+        READWRITE(k1);
+    }
+};
+
+}
+
+static fs::path ShardsDir()
+{
+    return GetDataDir() / "chainstate_shards";
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+static std::vector<std::unique_ptr<CDBWrapper>> OpenShards(size_t count, size_t nCacheSize, bool fMemory, bool fWipe)
 {
+    std::vector<std::unique_ptr<CDBWrapper>> shards;
+    for (size_t i = 0; i < count; ++i) {
+        shards.emplace_back(new CDBWrapper(ShardsDir() / strprintf("%u", count) / strprintf("%u", i), nCacheSize, fMemory, fWipe, true));
+    }
+    return shards;
+}
+
+//! Delete the shards of layouts other than the one with count databases, left by a move to another layout.
+static void RemoveStaleShards(size_t count)
+{
+    const fs::path dir = ShardsDir();
+    if (!fs::exists(dir)) return;
+    for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it) {
+        if (it->path().filename().string() != strprintf("%u", count)) {
+            LogPrintf("Removing unused chainstate shards %s\n", it->path().string());
+            fs::remove_all(it->path());
+        }
+    }
+}
+
+//! Erase every coin from db, such as those left in the main database when the coins move to shards.
+static void EraseCoins(CDBWrapper& db)
+{
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(DB_COIN);
+    CDBBatch batch(db);
+    COutPoint outpoint;
+    CoinEntry entry(&outpoint);
+    size_t count = 0;
+    while (pcursor->Valid() && pcursor->GetKey(entry) && entry.key == DB_COIN) {
+        batch.Erase(entry);
+        ++count;
+        if (batch.SizeEstimate() > (1 << 24)) {
+            db.WriteBatch(batch);
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+    db.WriteBatch(batch, true);
+    if (count > 0) {
+        LogPrintf("Erased %u coins from the old chainstate layout\n", count);
+        db.CompactRange(DB_COIN, (char)(DB_COIN+1));
+    }
+}
+
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true), m_stats_valid(false), m_cache_size(nCacheSize), m_memory(fMemory)
+{
+    // The main database of a sharded chainstate only holds a few keys, so
+    // its cache stays mostly unused and the shards split nCacheSize.
+    ShardInfo info;
+    if (db.Read(DB_SHARDS, info) && info.count > 1) {
+        m_shards = OpenShards(info.count, nCacheSize / info.count, fMemory, false);
+        m_shard_k0 = info.k0;
+        m_shard_k1 = info.k1;
+        LogPrintf("Using %u chainstate shards\n", info.count);
+    }
+    if (!fMemory) {
+        RemoveStaleShards(ShardCount());
+    }
+
+    if (db.Read(DB_COINS_STATS, m_stats)) {
+        m_stats_valid = true;
+    } else if (GetBestBlock().IsNull() && GetHeadBlocks().empty()) {
+        // An empty database: the statistics start out as those of the empty set.
+        m_stats_valid = true;
+    } else {
+        LogPrintf("Coin database has no rolling UTXO set statistics; gettxoutsetinfo will scan the whole set. Restart with -reindex-chainstate to build them.\n");
+    }
+}
+
+size_t CCoinsViewDB::ShardIndex(const COutPoint &outpoint) const {
+    return SipHashUint256Extra(m_shard_k0, m_shard_k1, outpoint.hash, outpoint.n) % m_shards.size();
+}
+
+const CDBWrapper& CCoinsViewDB::CoinsDB(const COutPoint &outpoint) const {
+    return m_shards.empty() ? db : *m_shards[ShardIndex(outpoint)];
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
-    return db.Read(CoinEntry(&outpoint), coin);
+    return CoinsDB(outpoint).Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
-    return db.Exists(CoinEntry(&outpoint));
+    return CoinsDB(outpoint).Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -82,55 +185,109 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+/**
+ * Add the dirty entries of mapCoins that select accepts to batch, writing it
+ * to db whenever it grows past batch_size. The last batch is left for the
+ * caller to finish. Returns the number of entries added.
+ */
+template <typename Select>
+static size_t WriteCoins(CDBWrapper& db, CDBBatch& batch, const CCoinsMap& mapCoins, Select select, size_t batch_size, int crash_simulate)
+{
+    size_t changed = 0;
+    FastRandomContext rng;
+    // The entries are left in place: a background flush keeps serving reads
+    // from mapCoins while it is being written.
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY) || !select(it->first)) continue;
+        CoinEntry entry(&it->first);
+        if (it->second.coin.IsSpent())
+            batch.Erase(entry);
+        else
+            batch.Write(entry, it->second.coin.Decompress());
+        changed++;
+        if (batch.SizeEstimate() > batch_size) {
+            LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
+            db.WriteBatch(batch);
+            batch.Clear();
+            if (crash_simulate) {
+                if (rng.randrange(crash_simulate) == 0) {
+                    LogPrintf("Simulating a crash. Goodbye.\n");
+                    _Exit(0);
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CRollingCoinsStats &stats) {
     CDBBatch batch(db);
-    size_t count = 0;
+    size_t count = mapCoins.size();
     size_t changed = 0;
     size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
     uint256 old_tip = GetBestBlock();
+    bool replaying = false;
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
         std::vector<uint256> old_heads = GetHeadBlocks();
         if (old_heads.size() == 2) {
             assert(old_heads[0] == hashBlock);
             old_tip = old_heads[1];
+            replaying = true;
         }
     }
 
+    // The statistics for hashBlock go into the first batch. When replaying,
+    // that batch was already written and the change passed in is relative to
+    // a partially written set, so the stored statistics stand.
+    CRollingCoinsStats new_stats = m_stats;
+    if (!replaying) {
+        new_stats.Apply(stats);
+    }
+
     // In the first batch, mark the database as being in the middle of a
     // transition from old_tip to hashBlock.
     // A vector is used for future extensibility, as we may want to support
     // interrupting after partial writes from multiple independent reorgs.
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
+    if (m_stats_valid) {
+        batch.Write(DB_COINS_STATS, new_stats);
+    }
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
-        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            CoinEntry entry(&it->first);
-            if (it->second.coin.IsSpent())
-                batch.Erase(entry);
-            else
-                batch.Write(entry, it->second.coin);
-            changed++;
-        }
-        count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
-        if (batch.SizeEstimate() > batch_size) {
-            LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
-            db.WriteBatch(batch);
-            batch.Clear();
-            if (crash_simulate) {
-                static FastRandomContext rng;
-                if (rng.randrange(crash_simulate) == 0) {
-                    LogPrintf("Simulating a crash. Goodbye.\n");
-                    _Exit(0);
+    if (m_shards.empty()) {
+        changed = WriteCoins(db, batch, mapCoins, [](const COutPoint&) { return true; }, batch_size, crash_simulate);
+    } else {
+        // The marker must be durable before any shard changes, and every
+        // shard synced before the best block is written below.
+        db.WriteBatch(batch, true);
+        batch.Clear();
+        // Each thread picks its own entries out of the map, which saves
+        // partitioning it up front at the cost of hashing dirty outpoints
+        // once per shard.
+        std::vector<std::thread> threads;
+        std::vector<size_t> shard_changed(m_shards.size(), 0);
+        std::vector<std::exception_ptr> errors(m_shards.size());
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            threads.emplace_back([&, i] {
+                try {
+                    CDBWrapper& shard = *m_shards[i];
+                    CDBBatch shard_batch(shard);
+                    shard_changed[i] = WriteCoins(shard, shard_batch, mapCoins, [&](const COutPoint& outpoint) { return ShardIndex(outpoint) == i; }, batch_size, crash_simulate);
+                    shard.WriteBatch(shard_batch, true);
+                } catch (...) {
+                    errors[i] = std::current_exception();
                 }
-            }
+            });
         }
+        for (std::thread& thread : threads) thread.join();
+        for (const std::exception_ptr& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+        for (size_t n : shard_changed) changed += n;
     }
 
     // In the last batch, mark the database as consistent with hashBlock again.
@@ -140,15 +297,297 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
     LogPrint(BCLog::COINDB, "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    if (ret) {
+        m_stats = new_stats;
+    }
     return ret;
 }
 
+bool CCoinsViewDB::GetRollingStats(CRollingCoinsStats &stats) const {
+    if (!m_stats_valid) return false;
+    stats = m_stats;
+    return true;
+}
+
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsView* view, bool background) : CCoinsViewBacked(view), m_background(background) {}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    if (m_thread.joinable()) m_thread.join();
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    if (m_writing) {
+        CCoinsMap::const_iterator it = m_snapshot.find(outpoint);
+        if (it != m_snapshot.end()) {
+            it->second.coin.Decompress(coin);
+            return !coin.IsSpent();
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint &outpoint) const
+{
+    Coin coin;
+    return GetCoin(outpoint, coin);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const
+{
+    return m_writing ? m_snapshot_block : base->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundFlush::GetRollingStats(CRollingCoinsStats &stats) const
+{
+    if (!m_writing) return base->GetRollingStats(stats);
+    if (!m_snapshot_stats_valid) return false;
+    stats = m_snapshot_stats;
+    return true;
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CRollingCoinsStats &stats)
+{
+    if (!Wait()) return false;
+    const int64_t nStart = GetTimeMicros();
+    if (!m_background) {
+        const size_t count = mapCoins.size();
+        const bool ret = base->BatchWrite(mapCoins, hashBlock, stats);
+        const int64_t nDuration = GetTimeMicros() - nStart;
+        LOCK(cs_stats);
+        if (ret) {
+            m_stats.count++;
+            m_stats.coins += count;
+            m_stats.last_duration = nDuration;
+            m_stats.total_duration += nDuration;
+        }
+        m_stats.total_wait += nDuration;
+        return ret;
+    }
+
+    // The statistics as of hashBlock answer GetRollingStats until the write
+    // is done; the base view has not seen the change yet.
+    m_snapshot.swap(mapCoins);
+    m_snapshot_block = hashBlock;
+    m_snapshot_delta = stats;
+    m_snapshot_stats_valid = base->GetRollingStats(m_snapshot_stats);
+    if (m_snapshot_stats_valid) m_snapshot_stats.Apply(stats);
+    m_writing = true;
+    m_done = false;
+    {
+        LOCK(cs_stats);
+        m_stats.in_progress = true;
+        m_stats.snapshot_usage = m_snapshot.DynamicMemoryUsage();
+        m_stats.total_wait += GetTimeMicros() - nStart;
+    }
+    m_thread = std::thread([this] {
+        RenameThread("bitcoin-coinsflush");
+        ThreadWrite();
+    });
+    return true;
+}
+
+void CCoinsViewBackgroundFlush::ThreadWrite()
+{
+    const int64_t nStart = GetTimeMicros();
+    bool ret = false;
+    try {
+        ret = base->BatchWrite(m_snapshot, m_snapshot_block, m_snapshot_delta);
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+    const int64_t nDuration = GetTimeMicros() - nStart;
+    if (ret) {
+        LogPrint(BCLog::COINDB, "Flushed %u coins to the coin database in the background in %.2fms\n", m_snapshot.size(), nDuration * 0.001);
+    } else {
+        LogPrintf("Error: background flush to the coin database failed\n");
+    }
+    {
+        LOCK(cs_stats);
+        if (ret) {
+            m_stats.count++;
+            m_stats.coins += m_snapshot.size();
+            m_stats.last_duration = nDuration;
+            m_stats.total_duration += nDuration;
+        }
+        m_stats.in_progress = false;
+    }
+    m_write_ok = ret;
+    m_done = true;
+}
+
+bool CCoinsViewBackgroundFlush::Poll()
+{
+    if (m_thread.joinable() && !m_done) return true;
+    return Wait();
+}
+
+bool CCoinsViewBackgroundFlush::Wait()
+{
+    if (m_thread.joinable()) {
+        const int64_t nStart = GetTimeMicros();
+        const bool waited = !m_done;
+        m_thread.join();
+        const int64_t nWait = GetTimeMicros() - nStart;
+        if (waited) LogPrint(BCLog::COINDB, "Waited %.2fms for the background flush to the coin database\n", nWait * 0.001);
+        LOCK(cs_stats);
+        m_stats.total_wait += nWait;
+    }
+    if (!m_write_ok) return false;
+    if (m_writing) {
+        m_writing = false;
+        m_snapshot.clear();
+        LOCK(cs_stats);
+        m_stats.snapshot_usage = 0;
+    }
+    return true;
+}
+
+CoinsFlushStats CCoinsViewBackgroundFlush::GetStats() const
+{
+    LOCK(cs_stats);
+    return m_stats;
+}
+
+bool CCoinsViewDB::BeginSnapshotLoad(const uint256 &hashBlock) {
+    // Same marker as the first batch of BatchWrite, so that a load cut short
+    // shows up as a failed replay instead of a silently partial UTXO set.
+    CDBBatch batch(db);
+    batch.Erase(DB_BEST_BLOCK);
+    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, GetBestBlock()});
+    // Only an empty database can take a snapshot, so the statistics start
+    // from the empty set and are written once the snapshot base is.
+    m_stats = CRollingCoinsStats();
+    m_stats_valid = true;
+    return db.WriteBatch(batch, true);
+}
+
+bool CCoinsViewDB::WriteSnapshotCoins(const std::vector<std::pair<COutPoint, Coin>> &coins) {
+    if (!m_shards.empty()) {
+        std::vector<std::unique_ptr<CDBBatch>> batches;
+        for (const auto& shard : m_shards) batches.emplace_back(new CDBBatch(*shard));
+        for (const auto& coin : coins) {
+            batches[ShardIndex(coin.first)]->Write(CoinEntry(&coin.first), coin.second);
+            m_stats.Add(coin.first, coin.second);
+        }
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            m_shards[i]->WriteBatch(*batches[i]);
+        }
+        return true;
+    }
+    CDBBatch batch(db);
+    for (const auto& coin : coins) {
+        batch.Write(CoinEntry(&coin.first), coin.second);
+        m_stats.Add(coin.first, coin.second);
+    }
+    LogPrint(BCLog::COINDB, "Writing snapshot batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
+    return db.WriteBatch(batch);
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
-    return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
+    if (m_shards.empty()) return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
+    size_t size = 0;
+    for (const auto& shard : m_shards) {
+        size += shard->EstimateSize(DB_COIN, (char)(DB_COIN+1));
+    }
+    return size;
+}
+
+bool CCoinsViewDB::Reshard(size_t count)
+{
+    count = std::max<size_t>(count, 1);
+    const size_t old_count = ShardCount();
+    if (count == old_count) return true;
+
+    LogPrintf("Moving the UTXO set from %u to %u database(s)...\n", old_count, count);
+    LogPrintf("[0%%]..."); /* Continued */
+    uiInterface.ShowProgress(_("Resharding UTXO database"), 0, true);
+    const uint64_t k0 = GetRand(std::numeric_limits<uint64_t>::max());
+    const uint64_t k1 = GetRand(std::numeric_limits<uint64_t>::max());
+    std::vector<std::unique_ptr<CDBWrapper>> shards;
+    std::vector<CDBWrapper*> targets;
+    if (count > 1) {
+        shards = OpenShards(count, m_cache_size / count, m_memory, true);
+        for (const auto& shard : shards) targets.push_back(shard.get());
+    } else {
+        // Coins left in the main database by an earlier move are stale.
+        EraseCoins(db);
+        targets.push_back(&db);
+    }
+
+    std::vector<std::unique_ptr<CDBBatch>> batches;
+    for (CDBWrapper* target : targets) batches.emplace_back(new CDBBatch(*target));
+    std::unique_ptr<CCoinsViewCursor> pcursor(Cursor());
+    int64_t moved = 0;
+    int reportDone = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) {
+            break;
+        }
+        COutPoint outpoint;
+        Coin coin;
+        if (!pcursor->GetKey(outpoint) || !pcursor->GetValue(coin)) {
+            return error("%s: unable to read coin", __func__);
+        }
+        if (moved++ % 256 == 0) {
+            uint32_t high = 0x100 * *outpoint.hash.begin() + *(outpoint.hash.begin() + 1);
+            int percentageDone = (int)(high * 100.0 / 65536.0 + 0.5);
+            uiInterface.ShowProgress(_("Resharding UTXO database"), percentageDone, true);
+            if (reportDone < percentageDone/10) {
+                // report max. every 10% step
+                LogPrintf("[%d%%]...", percentageDone); /* Continued */
+                reportDone = percentageDone/10;
+            }
+        }
+        const size_t i = count > 1 ? SipHashUint256Extra(k0, k1, outpoint.hash, outpoint.n) % count : 0;
+        batches[i]->Write(CoinEntry(&outpoint), coin);
+        if (batches[i]->SizeEstimate() > (1 << 24)) {
+            targets[i]->WriteBatch(*batches[i]);
+            batches[i]->Clear();
+        }
+        pcursor->Next();
+    }
+    pcursor.reset();
+    uiInterface.ShowProgress("", 100, false);
+    LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
+    if (ShutdownRequested()) return false;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        targets[i]->WriteBatch(*batches[i], true);
+    }
+
+    // Switch over. Until this write, the old layout is the valid one and
+    // the new shards are removed at the next startup.
+    if (count > 1) {
+        db.Write(DB_SHARDS, ShardInfo{(uint32_t)count, k0, k1}, true);
+    } else {
+        db.Erase(DB_SHARDS, true);
+    }
+    m_shards.swap(shards);
+    m_shard_k0 = k0;
+    m_shard_k1 = k1;
+    if (old_count == 1) {
+        EraseCoins(db);
+    }
+    shards.clear();
+    if (!m_memory) {
+        RemoveStaleShards(count);
+    }
+    LogPrintf("Moved %u coins\n", moved);
+    return true;
+}
+
+static fs::path BlockTreeDBPath()
+{
+    return gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index";
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(BlockTreeDBPath(), nCacheSize, fMemory, fWipe) {
+    if (!fMemory) {
+        m_headers_path = BlockTreeDBPath().parent_path() / "headers.dat";
+    }
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -173,27 +612,56 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COIN);
-    // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
+    if (m_shards.empty()) {
+        i->AddSource(const_cast<CDBWrapper&>(db).NewIterator());
     } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+        for (const auto& shard : m_shards) {
+            i->AddSource(shard->NewIterator());
+        }
     }
+    i->Select();
     return i;
 }
 
+void CCoinsViewDBCursor::AddSource(CDBIterator* pcursorIn)
+{
+    sources.emplace_back();
+    sources.back().pcursor.reset(pcursorIn);
+    sources.back().pcursor->Seek(DB_COIN);
+    // Cache key of first record
+    ReadKey(sources.back());
+}
+
+void CCoinsViewDBCursor::ReadKey(Source& source)
+{
+    CoinEntry entry(&source.keyTmp.second);
+    if (!source.pcursor->Valid() || !source.pcursor->GetKey(entry)) {
+        source.keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+    } else {
+        source.keyTmp.first = entry.key;
+        source.keyRaw.clear();
+        CVectorWriter(SER_DISK, CLIENT_VERSION, source.keyRaw, 0, entry);
+    }
+}
+
+void CCoinsViewDBCursor::Select()
+{
+    current = nullptr;
+    for (Source& source : sources) {
+        if (source.keyTmp.first != DB_COIN) continue;
+        if (!current || source.keyRaw < current->keyRaw) current = &source;
+    }
+}
+
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
-    if (keyTmp.first == DB_COIN) {
-        key = keyTmp.second;
+    if (current) {
+        key = current->keyTmp.second;
         return true;
     }
     return false;
@@ -201,40 +669,78 @@ bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 
 bool CCoinsViewDBCursor::GetValue(Coin &coin) const
 {
-    return pcursor->GetValue(coin);
+    return current->pcursor->GetValue(coin);
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
 {
-    return pcursor->GetValueSize();
+    return current->pcursor->GetValueSize();
 }
 
 bool CCoinsViewDBCursor::Valid() const
 {
-    return keyTmp.first == DB_COIN;
+    return current != nullptr;
 }
 
 void CCoinsViewDBCursor::Next()
 {
-    pcursor->Next();
-    CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
-        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
-    } else {
-        keyTmp.first = entry.key;
-    }
+    current->pcursor->Next();
+    ReadKey(*current);
+    Select();
+}
+
+/**
+ * Append a headers file record: the number plus one of the record it
+ * supersedes, the entry, and a checksum keyed by the file id and the
+ * record's own number.
+ */
+static void WriteHeaderRecord(CDataStream& ss, uint64_t id, uint32_t record, uint32_t prev_record, const CDiskBlockIndex& diskindex)
+{
+    const size_t begin = ss.size();
+    ss << prev_record << diskindex;
+    ss << CSipHasher(id, record).Write((const unsigned char*)ss.data() + begin, ss.size() - begin).Finalize();
 }
 
-bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
+bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<CBlockIndex*>& blockinfo) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<int, const CBlockFileInfo*> >::const_iterator it=fileInfo.begin(); it != fileInfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_FILES, it->first), *it->second);
     }
     batch.Write(DB_LAST_BLOCK, nLastFile);
-    for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
+    for (std::vector<CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
-    return WriteBatch(batch, true);
+
+    // The appended records must be durable before the batch commits the
+    // length that covers them.
+    uint64_t size = m_headers_size;
+    uint32_t records = m_headers_records;
+    if (m_headers_synced && !blockinfo.empty()) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        for (CBlockIndex* pindex : blockinfo) {
+            WriteHeaderRecord(ss, m_headers_id, records, pindex->nHeaderRecord, CDiskBlockIndex(pindex));
+            pindex->nHeaderRecord = ++records;
+        }
+        FILE* file = fsbridge::fopen(m_headers_path, "rb+");
+        const bool ok = file && fseek(file, size, SEEK_SET) == 0 && fwrite(ss.data(), 1, ss.size(), file) == ss.size() && FileCommit(file);
+        if (file) fclose(file);
+        if (ok) {
+            size += ss.size();
+        } else {
+            LogPrintf("%s: failed to append to %s, the block index will be read from the database at the next startup\n", __func__, m_headers_path.string());
+            m_headers_synced = false;
+        }
+    }
+    if (m_headers_synced) {
+        batch.Write(DB_HEADERS_FILE, std::make_pair(m_headers_id, size));
+    } else {
+        batch.Erase(DB_HEADERS_FILE);
+    }
+    if (!WriteBatch(batch, true))
+        return false;
+    m_headers_size = size;
+    m_headers_records = records;
+    return true;
 }
 
 bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
@@ -260,44 +766,216 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::vector<std::pair<uint256, CDiskBlockIndex>>& entries, int nThreads)
 {
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    if (ReadHeadersFile(consensusParams, entries, nThreads)) {
+        // Compact the file once superseded records outnumber the live ones.
+        if (m_headers_records > 2 * entries.size()) {
+            LogPrintf("%s: compacting %s (%u records, %u entries)\n", __func__, m_headers_path.string(), m_headers_records, entries.size());
+            RewriteHeadersFile(entries);
+        }
+        return true;
+    }
 
-    pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
+    if (!m_headers_path.empty() && fs::exists(m_headers_path)) {
+        LogPrintf("%s: headers file not usable, reading the block index database\n", __func__);
+    }
+    if (!ReadBlockIndexDB(consensusParams, entries, nThreads))
+        return false;
+    // If this fails the database is read again at the next startup.
+    RewriteHeadersFile(entries);
+    return true;
+}
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
+bool CBlockTreeDB::ReadHeadersFile(const Consensus::Params& consensusParams, std::vector<std::pair<uint256, CDiskBlockIndex>>& entries, int nThreads)
+{
+    std::pair<uint64_t, uint64_t> committed;
+    if (m_headers_path.empty() || !Read(DB_HEADERS_FILE, committed))
+        return false;
+
+    // Read the committed part in one go, and drop anything past it.
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    {
+        FILE* file = fsbridge::fopen(m_headers_path, "rb+");
+        if (!file)
+            return error("%s: cannot open %s", __func__, m_headers_path.string());
+        ss.resize(committed.second);
+        const bool ok = fread(ss.data(), 1, ss.size(), file) == ss.size() && TruncateFile(file, committed.second);
+        fclose(file);
+        if (!ok)
+            return error("%s: %s is shorter than its committed length %u", __func__, m_headers_path.string(), committed.second);
+    }
+
+    std::vector<CDiskBlockIndex> records;
+    std::vector<char> superseded;
+    try {
+        uint64_t id;
+        ss >> id;
+        if (id != committed.first)
+            return error("%s: %s does not belong to this database", __func__, m_headers_path.string());
+        while (!ss.empty()) {
+            const uint32_t record = records.size();
+            const char* begin = ss.data();
+            const size_t remaining = ss.size();
+            uint32_t prev_record;
             CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
-                    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
-
-                pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
+            ss >> prev_record >> diskindex;
+            uint64_t checksum;
+            if (ss.size() < sizeof(checksum))
+                return error("%s: truncated record %u in %s", __func__, record, m_headers_path.string());
+            const uint64_t expected = CSipHasher(id, record).Write((const unsigned char*)begin, remaining - ss.size()).Finalize();
+            ss >> checksum;
+            if (checksum != expected || prev_record > record)
+                return error("%s: bad record %u in %s", __func__, record, m_headers_path.string());
+            if (prev_record > 0) superseded[prev_record - 1] = true;
+            diskindex.nHeaderRecord = record + 1;
+            records.push_back(std::move(diskindex));
+            superseded.push_back(false);
+        }
+    } catch (const std::exception& e) {
+        return error("%s: deserialize error in %s: %s", __func__, m_headers_path.string(), e.what());
+    }
+
+    std::vector<size_t> live;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (!superseded[i]) live.push_back(i);
+    }
+
+    // Hash the headers and check their proof of work concurrently.
+    nThreads = std::max(1, nThreads);
+    std::vector<uint256> hashes(records.size());
+    std::vector<char> shard_ok(nThreads, 1);
+    auto check_shard = [&](int t) {
+        for (size_t j = live.size() * t / nThreads; j < live.size() * (t + 1) / nThreads; ++j) {
+            const size_t i = live[j];
+            hashes[i] = records[i].GetBlockHash();
+            if (!CheckProofOfWork(hashes[i], records[i].nBits, consensusParams)) {
+                shard_ok[t] = error("%s: CheckProofOfWork failed: %s", __func__, hashes[i].ToString());
+                return;
             }
-        } else {
-            break;
         }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < nThreads; ++t) {
+        threads.emplace_back(check_shard, t);
+    }
+    check_shard(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < nThreads; ++t) {
+        if (!shard_ok[t]) return false;
+    }
+
+    entries.reserve(entries.size() + live.size());
+    for (size_t i : live) {
+        entries.emplace_back(hashes[i], std::move(records[i]));
+    }
+
+    m_headers_synced = true;
+    m_headers_id = committed.first;
+    m_headers_size = committed.second;
+    m_headers_records = records.size();
+    return true;
+}
+
+bool CBlockTreeDB::RewriteHeadersFile(std::vector<std::pair<uint256, CDiskBlockIndex>>& entries)
+{
+    if (m_headers_path.empty())
+        return true;
+    m_headers_synced = false;
+
+    // Write a new file next to the old one and move it into place before
+    // committing its id; until then the old file fails the id check.
+    const uint64_t id = GetRand(std::numeric_limits<uint64_t>::max());
+    const fs::path path_tmp = m_headers_path.parent_path() / "headers.dat.new";
+    FILE* file = fsbridge::fopen(path_tmp, "wb");
+    if (!file)
+        return error("%s: cannot create %s", __func__, path_tmp.string());
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << id;
+    uint64_t size = 0;
+    bool ok = true;
+    for (size_t i = 0; i < entries.size() && ok; ++i) {
+        WriteHeaderRecord(ss, id, i, 0, entries[i].second);
+        if (ss.size() >= (1 << 20)) {
+            ok = fwrite(ss.data(), 1, ss.size(), file) == ss.size();
+            size += ss.size();
+            ss.clear();
+        }
+    }
+    if (ok && !ss.empty()) {
+        ok = fwrite(ss.data(), 1, ss.size(), file) == ss.size();
+        size += ss.size();
+    }
+    ok = ok && FileCommit(file);
+    fclose(file);
+    if (!ok || !RenameOver(path_tmp, m_headers_path) || !Write(DB_HEADERS_FILE, std::make_pair(id, size), true))
+        return error("%s: failed to write %s", __func__, m_headers_path.string());
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i].second.nHeaderRecord = i + 1;
+    }
+    m_headers_synced = true;
+    m_headers_id = id;
+    m_headers_size = size;
+    m_headers_records = entries.size();
+    return true;
+}
+
+bool CBlockTreeDB::ReadBlockIndexDB(const Consensus::Params& consensusParams, std::vector<std::pair<uint256, CDiskBlockIndex>>& entries, int nThreads)
+{
+    // Keys are DB_BLOCK_INDEX followed by the block hash, so shard i covers
+    // the hashes whose first byte is in [256 * i / nThreads, 256 * (i + 1) / nThreads).
+    nThreads = std::max(1, std::min(nThreads, 256));
+    std::vector<std::vector<std::pair<uint256, CDiskBlockIndex>>> shards(nThreads);
+    std::vector<char> shard_ok(nThreads, 1);
+
+    auto load_shard = [&](int i) {
+        const int begin = 256 * i / nThreads;
+        const int end = 256 * (i + 1) / nThreads;
+        uint256 start;
+        *start.begin() = begin;
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, start));
+        while (pcursor->Valid()) {
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX || *key.second.begin() >= end) break;
+            CDiskBlockIndex diskindex;
+            if (!pcursor->GetValue(diskindex)) {
+                shard_ok[i] = error("%s: failed to read value", __func__);
+                return;
+            }
+            const uint256 hash = diskindex.GetBlockHash();
+            if (!CheckProofOfWork(hash, diskindex.nBits, consensusParams)) {
+                shard_ok[i] = error("%s: CheckProofOfWork failed: %s", __func__, hash.ToString());
+                return;
+            }
+            shards[i].emplace_back(hash, std::move(diskindex));
+            pcursor->Next();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; ++i) {
+        threads.emplace_back(load_shard, i);
+    }
+    load_shard(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    boost::this_thread::interruption_point();
+
+    size_t count = 0;
+    for (int i = 0; i < nThreads; ++i) {
+        if (!shard_ok[i]) return false;
+        count += shards[i].size();
+    }
+    entries.reserve(entries.size() + count);
+    for (auto& shard : shards) {
+        std::move(shard.begin(), shard.end(), std::back_inserter(entries));
+        shard.clear();
+        shard.shrink_to_fit();
     }
 
     return true;
@@ -10,10 +10,13 @@
 #include <dbwrapper.h>
 #include <chain.h>
 #include <primitives/block.h>
+#include <sync.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -25,6 +28,14 @@ class uint256;
 static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 //! -dbcache default (MiB)
 static const int64_t nDefaultDbCache = 450;
+//! -dbcachekeep default (percent of the coins cache)
+static const int64_t nDefaultDbCacheKeep = 25;
+//! max. -dbcachekeep (percent)
+static const int64_t nMaxDbCacheKeep = 90;
+//! -chainstateshards default
+static const int64_t nDefaultChainstateShards = 1;
+//! max. -chainstateshards
+static const int64_t nMaxChainstateShards = 64;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
 //! max. -dbcache (MiB)
@@ -65,11 +76,35 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
-/** CCoinsView backed by the coin database (chainstate/) */
+/**
+ * CCoinsView backed by the coin database (chainstate/)
+ *
+ * The coins may be sharded: spread over several databases in
+ * chainstate_shards/<count>/, by a salted hash of the outpoint. The main
+ * database then holds only the best block, the head-blocks marker and the
+ * statistics. BatchWrite writes the shards in parallel, between a synced
+ * head-blocks marker in the main database and the best block after all
+ * shards are synced, so an interrupted flush is replayed as usual. Cursor
+ * merges the shards back into key order.
+ */
 class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    //! Rolling statistics of the coins as of the best block; only usable if m_stats_valid.
+    CRollingCoinsStats m_stats;
+    bool m_stats_valid;
+    const size_t m_cache_size;
+    const bool m_memory;
+    //! The databases holding the coins if sharded, otherwise empty and the coins are in db
+    std::vector<std::unique_ptr<CDBWrapper>> m_shards;
+    //! Salt of the hash that assigns outpoints to shards
+    uint64_t m_shard_k0 = 0;
+    uint64_t m_shard_k1 = 0;
+
+    //! The shard holding outpoint; only valid if sharded
+    size_t ShardIndex(const COutPoint &outpoint) const;
+    const CDBWrapper& CoinsDB(const COutPoint &outpoint) const;
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -77,15 +112,105 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CRollingCoinsStats &stats) override;
+    bool GetRollingStats(CRollingCoinsStats &stats) const override;
     CCoinsViewCursor *Cursor() const override;
 
+    //! Mark the database as in transition to a UTXO snapshot based at hashBlock, so an interrupted load is caught at startup.
+    bool BeginSnapshotLoad(const uint256 &hashBlock);
+    //! Write coins loaded from a UTXO snapshot. The transition completes with the next BatchWrite for the snapshot base.
+    bool WriteSnapshotCoins(const std::vector<std::pair<COutPoint, Coin>> &coins);
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    //! Number of databases the coins are spread over, 1 if they are in the main database.
+    size_t ShardCount() const { return m_shards.empty() ? 1 : m_shards.size(); }
+    /**
+     * Move the coins into count databases if they are spread differently.
+     * The new layout takes effect once every coin is copied; an interrupted
+     * move starts over at the next startup. Returns false on error or shutdown.
+     */
+    bool Reshard(size_t count);
+};
+
+/** Statistics of the flushes through a CCoinsViewBackgroundFlush. Durations are in microseconds. */
+struct CoinsFlushStats
+{
+    //! Completed flushes, and the cache entries they wrote
+    uint64_t count = 0;
+    uint64_t coins = 0;
+    int64_t last_duration = 0;
+    int64_t total_duration = 0;
+    //! Time the flushing thread spent waiting for writes to finish
+    int64_t total_wait = 0;
+    bool in_progress = false;
+    //! Memory held by the snapshot being written
+    size_t snapshot_usage = 0;
+};
+
+/**
+ * CCoinsView between the coins cache and the database that writes flushes
+ * on a background thread.
+ *
+ * BatchWrite takes over the flushed entries as an immutable snapshot and
+ * returns immediately, so validation continues on the emptied cache while
+ * the snapshot is written. Until the write is done, reads check the
+ * snapshot before falling through to the base view. Only one flush is in
+ * progress at a time; the next one waits for it. The base view's BatchWrite
+ * must leave the map it is given intact, as CCoinsViewDB does.
+ *
+ * While a flush is in progress, the memory of its snapshot comes on top of
+ * the cache's. A failed write is reported by the next BatchWrite, Poll or
+ * Wait, and the snapshot is kept for reads.
+ *
+ * Calls must not overlap with BatchWrite, Poll or Wait; in the node they are
+ * serialized by cs_main. Reads may run concurrently with each other.
+ */
+class CCoinsViewBackgroundFlush final : public CCoinsViewBacked
+{
+private:
+    const bool m_background;
+    CCoinsMap m_snapshot;
+    //! Whether reads go through m_snapshot
+    bool m_writing = false;
+    uint256 m_snapshot_block;
+    CRollingCoinsStats m_snapshot_delta;
+    CRollingCoinsStats m_snapshot_stats;
+    bool m_snapshot_stats_valid = false;
+    std::thread m_thread;
+    std::atomic<bool> m_done{false};
+    bool m_write_ok = true;
+
+    mutable CCriticalSection cs_stats;
+    CoinsFlushStats m_stats;
+
+    void ThreadWrite();
+
+public:
+    //! With background false, BatchWrite writes synchronously and only the statistics are kept.
+    CCoinsViewBackgroundFlush(CCoinsView* view, bool background);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CRollingCoinsStats &stats) override;
+    bool GetRollingStats(CRollingCoinsStats &stats) const override;
+
+    //! Release the snapshot if its write has finished. Returns false if a write failed.
+    bool Poll();
+    //! Wait for the flush in progress. Returns false if a write failed.
+    bool Wait();
+    CoinsFlushStats GetStats() const;
 };
 
-/** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
+/**
+ * Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB. The
+ * coins of a sharded database come out in the key order of an unsharded
+ * one, so the serialized hash of the set does not depend on the layout.
+ */
 class CCoinsViewDBCursor: public CCoinsViewCursor
 {
 public:
@@ -99,21 +224,44 @@ public:
     void Next() override;
 
 private:
-    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
-    std::unique_ptr<CDBIterator> pcursor;
-    std::pair<char, COutPoint> keyTmp;
+    //! An iterator over one database, with its cached key
+    struct Source {
+        std::unique_ptr<CDBIterator> pcursor;
+        std::pair<char, COutPoint> keyTmp;
+        //! The key as stored, to merge several sources in database order
+        std::vector<unsigned char> keyRaw;
+    };
+
+    explicit CCoinsViewDBCursor(const uint256 &hashBlockIn):
+        CCoinsViewCursor(hashBlockIn) {}
+    void AddSource(CDBIterator* pcursorIn);
+    void ReadKey(Source& source);
+    void Select();
+
+    std::vector<Source> sources;
+    //! The source at the smallest key, or nullptr after the last record
+    Source* current = nullptr;
 
     friend class CCoinsViewDB;
 };
 
-/** Access to the block database (blocks/index/) */
+/**
+ * Access to the block database (blocks/index/)
+ *
+ * Block index entries are also appended to a flat file, blocks/headers.dat,
+ * which can be read back in one sequential pass at startup. The database
+ * stays authoritative: WriteBatchSync appends and syncs the records first,
+ * then stores the file's id and committed length in the same batch as the
+ * entries. Bytes past that length are an interrupted append and are
+ * ignored. A file with another id, a shorter length or a bad record is not
+ * used; the entries are read from the database and the file is rewritten.
+ */
 class CBlockTreeDB : public CDBWrapper
 {
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
-    bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
+    bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
@@ -122,7 +270,35 @@ public:
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Read all block index entries and check their proof of work, from the
+     * headers file if it is usable and otherwise from the database, after
+     * which the headers file is rewritten. Entries come back keyed by block
+     * hash, in no particular order.
+     */
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::vector<std::pair<uint256, CDiskBlockIndex>>& entries, int nThreads);
+    /**
+     * Read the entries from the database. The key space is split into
+     * nThreads ranges that are read concurrently.
+     */
+    bool ReadBlockIndexDB(const Consensus::Params& consensusParams, std::vector<std::pair<uint256, CDiskBlockIndex>>& entries, int nThreads);
+    /**
+     * Read the entries from the headers file, if it matches the database.
+     * Superseded records are skipped and each entry's nHeaderRecord is set.
+     */
+    bool ReadHeadersFile(const Consensus::Params& consensusParams, std::vector<std::pair<uint256, CDiskBlockIndex>>& entries, int nThreads);
+    /** Replace the headers file with one record per entry and set their nHeaderRecord. */
+    bool RewriteHeadersFile(std::vector<std::pair<uint256, CDiskBlockIndex>>& entries);
+
+private:
+    //! blocks/headers.dat, or empty when the database is in memory
+    fs::path m_headers_path;
+    //! Whether the headers file holds every entry written so far, so that appends may continue it
+    bool m_headers_synced = false;
+    //! Random id in the file's first bytes, tying it to the committed length in the database
+    uint64_t m_headers_id = 0;
+    uint64_t m_headers_size = 0;
+    uint32_t m_headers_records = 0;
 };
 
 /**
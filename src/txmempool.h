@@ -20,6 +20,7 @@
 #include <primitives/transaction.h>
 #include <sync.h>
 #include <random.h>
+#include <support/allocators/pool.h>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/hashed_index.hpp>
@@ -128,6 +129,7 @@ public:
     int64_t GetSigOpCostWithAncestors() const { return nSigOpCostWithAncestors; }
 
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
+    mutable uint64_t m_epoch; //!< epoch when last touched, see CTxMemPool::EpochGuard
 };
 
 // Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
@@ -365,6 +367,60 @@ public:
     }
 };
 
+/**
+ * Immutable copy of the mempool contents at one point in time, for readers
+ * such as getrawmempool or REST that walk many entries. It is built under
+ * mempool.cs but is then read, and may be kept, without holding any lock.
+ * See CTxMemPool::GetSnapshot().
+ */
+class CTxMemPoolSnapshot
+{
+public:
+    struct Entry
+    {
+        CTransactionRef tx;
+        uint256 wtxid;
+        CAmount nFee;
+        CAmount nModifiedFee;
+        size_t nTxSize;
+        int64_t nTime;
+        unsigned int nHeight;
+
+        uint64_t nCountWithDescendants;
+        uint64_t nSizeWithDescendants;
+        CAmount nModFeesWithDescendants;
+        uint64_t nCountWithAncestors;
+        uint64_t nSizeWithAncestors;
+        CAmount nModFeesWithAncestors;
+
+        //! In-mempool parents and children, sorted by txid.
+        std::vector<uint256> vParents;
+        std::vector<uint256> vChildren;
+
+        const uint256& GetHash() const { return tx->GetHash(); }
+    };
+
+    //! Entries sorted by ancestor count and then fee rate, as infoAll() and queryHashes() return them.
+    std::vector<Entry> entries;
+    //! CTxMemPool::GetTransactionsUpdated() at the time the snapshot was taken.
+    unsigned int nTransactionsUpdated;
+
+    friend class CTxMemPool;
+};
+
+/**
+ * Pool for the per-transaction nodes of a CTxMemPool: the mapTx node (an entry
+ * together with the links of its four indices), and the mapLinks and mapNextTx
+ * nodes. Blocks are rounded to 8 bytes; the hashed index's bucket array is
+ * larger than the biggest size class and comes from operator new, but is
+ * counted by the pool all the same. DynamicMemoryUsage() counts everything
+ * the pool holds, including free blocks.
+ */
+static const size_t MEMPOOL_POOL_MAX_BLOCK_BYTES = 512;
+typedef PoolResource<MEMPOOL_POOL_MAX_BLOCK_BYTES, alignof(uint64_t)> MemPoolResource;
+template <class T>
+using MemPoolAllocator = PoolAllocator<T, MEMPOOL_POOL_MAX_BLOCK_BYTES, alignof(uint64_t)>;
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -450,6 +506,14 @@ private:
     mutable int64_t lastRollingFeeUpdate;
     mutable bool blockSinceLastRollingFeeBump;
     mutable double rollingMinimumFeeRate; //!< minimum fee to get into the pool, decreases exponentially
+    mutable uint64_t m_epoch;
+    mutable bool m_has_epoch_guard;
+    //! Latest snapshot, shared until the mempool changes. Dropped as soon as
+    //! an entry is removed, so it never keeps evicted or mined transactions.
+    mutable std::shared_ptr<const CTxMemPoolSnapshot> m_snapshot;
+
+    //! Node memory for mapTx, mapLinks and mapNextTx; declared first so that it outlives them.
+    MemPoolResource m_pool_resource;
 
     void trackPackageRemoved(const CFeeRate& rate) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -480,7 +544,8 @@ public:
                 boost::multi_index::identity<CTxMemPoolEntry>,
                 CompareTxMemPoolEntryByAncestorFee
             >
-        >
+        >,
+        MemPoolAllocator<CTxMemPoolEntry>
     > indexed_transaction_set;
 
     mutable CCriticalSection cs;
@@ -495,27 +560,53 @@ public:
         }
     };
     typedef std::set<txiter, CompareIteratorByHash> setEntries;
+    typedef std::vector<txiter> vecEntries;
 
-    const setEntries & GetMemPoolParents(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
-    const setEntries & GetMemPoolChildren(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** In-mempool parents and children of an entry, sorted by CompareIteratorByHash. */
+    const vecEntries & GetMemPoolParents(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    const vecEntries & GetMemPoolChildren(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 private:
-    typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
+    typedef std::map<txiter, vecEntries, CompareIteratorByHash> cacheMap;
 
     struct TxLinks {
-        setEntries parents;
-        setEntries children;
+        vecEntries parents;
+        vecEntries children;
     };
 
-    typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
+    typedef std::map<txiter, TxLinks, CompareIteratorByHash, MemPoolAllocator<std::pair<const txiter, TxLinks> > > txlinksMap;
     txlinksMap mapLinks;
 
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
+    /** Add or remove it from a sorted link vector, keeping cachedInnerUsage in step. */
+    void UpdateLink(vecEntries& links, txiter it, bool add);
+
+    /** Scope of a single walk over the transaction graph. Entries reached
+     *  during the walk are tagged with a fresh epoch (see visited()), which
+     *  replaces the std::set lookups otherwise needed to avoid walking an
+     *  entry twice. Walks do not nest.
+     */
+    class EpochGuard {
+        const CTxMemPool& pool;
+    public:
+        explicit EpochGuard(const CTxMemPool& in);
+        ~EpochGuard();
+    };
+    /** Tag an entry with the current epoch; returns whether it already was. */
+    bool visited(txiter it) const EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        assert(m_has_epoch_guard);
+        const bool ret = it->m_epoch == m_epoch;
+        it->m_epoch = m_epoch;
+        return ret;
+    }
 
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    CTxMemPoolSnapshot::Entry MakeSnapshotEntry(txiter it) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
 public:
-    indirectmap<COutPoint, const CTransaction*> mapNextTx GUARDED_BY(cs);
+    typedef indirectmap<COutPoint, const CTransaction*, MemPoolAllocator<std::pair<const COutPoint* const, const CTransaction*> > > txspendsMap;
+    txspendsMap mapNextTx GUARDED_BY(cs);
     std::map<uint256, CAmount> mapDeltas;
 
     /** Create a new CTxMemPool.
@@ -644,6 +735,18 @@ public:
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
+    /** Snapshot of the current contents. Snapshots are built on demand and
+     *  shared by all callers until the mempool next changes, so readers that
+     *  poll do not copy the mempool, nor hold cs, each time. */
+    std::shared_ptr<const CTxMemPoolSnapshot> GetSnapshot() const;
+    /** Snapshot of a single entry; returns false if txid is not in the mempool. */
+    bool GetSnapshotEntry(const uint256& txid, CTxMemPoolSnapshot::Entry& entry) const;
+    /** Snapshots of all in-mempool ancestors or descendants of txid, excluding
+     *  itself and sorted by txid; returns false if txid is not in the mempool.
+     *  Only the entries found are copied. */
+    bool GetSnapshotAncestors(const uint256& txid, std::vector<CTxMemPoolSnapshot::Entry>& entries) const;
+    bool GetSnapshotDescendants(const uint256& txid, std::vector<CTxMemPoolSnapshot::Entry>& entries) const;
+
     size_t DynamicMemoryUsage() const;
 
     boost::signals2::signal<void (CTransactionRef)> NotifyEntryAdded;
@@ -666,14 +769,21 @@ private:
     void UpdateForDescendants(txiter updateIt,
             cacheMap &cachedDescendants,
             const std::set<uint256> &setExclude) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Vector-based versions of CalculateMemPoolAncestors and CalculateDescendants,
+     *  which walk the graph under an EpochGuard instead of accumulating a set.
+     *  descendants starts with the (deduplicated) roots. */
+    bool CalculateAncestors(const CTxMemPoolEntry &entry, vecEntries &ancestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents = true) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void CalculateDescendants(const vecEntries& roots, vecEntries& descendants) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    bool addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry, const vecEntries &ancestors, bool validFeeEstimate);
+    void RemoveStaged(const vecEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Update ancestors of hash to add/remove it as a descendant transaction. */
-    void UpdateAncestorsOf(bool add, txiter hash, setEntries &setAncestors) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void UpdateAncestorsOf(bool add, txiter hash, const vecEntries &ancestors) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Set ancestor state for an entry */
-    void UpdateEntryForAncestors(txiter it, const setEntries &setAncestors) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void UpdateEntryForAncestors(txiter it, const vecEntries &ancestors) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** For each transaction being removed, update ancestors and any direct children.
       * If updateDescendants is true, then also update in-mempool descendants'
       * ancestor state. */
-    void UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void UpdateForRemoveFromMempool(const vecEntries &entriesToRemove, bool updateDescendants) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Sever link between specified transaction and direct children. */
     void UpdateChildrenForRemoval(txiter entry) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -0,0 +1,428 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <utxosnapshot.h>
+
+#include <clientversion.h>
+#include <coins.h>
+#include <hash.h>
+#include <serialize.h>
+#include <streams.h>
+#include <txdb.h>
+#include <util.h>
+#include <utilstrencodings.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+static const unsigned char SNAPSHOT_MAGIC[5] = {'u', 't', 'x', 'o', 0xff};
+//! Serialized size of SnapshotHeader
+static const uint64_t SNAPSHOT_HEADER_SIZE = 5 + 2 + 4 + 32;
+//! Serialized size of the trailer: coins count and hash
+static const uint64_t SNAPSHOT_TRAILER_SIZE = 8 + 32;
+//! Chunks or batches in flight between two stages of a pipeline
+static const size_t SNAPSHOT_QUEUE_DEPTH = 8;
+//! Coins per database batch when loading a snapshot
+static const size_t SNAPSHOT_LOAD_BATCH = 16384;
+
+struct SnapshotHeader
+{
+    unsigned char magic[5];
+    uint16_t nVersion;
+    CMessageHeader::MessageStartChars message_start;
+    uint256 base_blockhash;
+
+    SnapshotHeader() : nVersion(0)
+    {
+        memset(magic, 0, sizeof(magic));
+        memset(message_start, 0, sizeof(message_start));
+    }
+
+    SnapshotHeader(const CMessageHeader::MessageStartChars& message_start_in, const uint256& base_blockhash_in) : nVersion(SNAPSHOT_VERSION), base_blockhash(base_blockhash_in)
+    {
+        memcpy(magic, SNAPSHOT_MAGIC, sizeof(magic));
+        memcpy(message_start, message_start_in, sizeof(message_start));
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write((const char*)magic, sizeof(magic));
+        s << nVersion;
+        s.write((const char*)message_start, sizeof(message_start));
+        s << base_blockhash;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        s.read((char*)magic, sizeof(magic));
+        s >> nVersion;
+        s.read((char*)message_start, sizeof(message_start));
+        s >> base_blockhash;
+    }
+
+    bool Check(const CMessageHeader::MessageStartChars& message_start_in, std::string& error) const
+    {
+        if (memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+            error = "Not a UTXO snapshot file";
+            return false;
+        }
+        if (nVersion != SNAPSHOT_VERSION) {
+            error = strprintf("Unsupported UTXO snapshot version %u", nVersion);
+            return false;
+        }
+        if (memcmp(message_start, message_start_in, sizeof(message_start)) != 0) {
+            error = "UTXO snapshot is for a different network";
+            return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * Bounded queue handing chunks from one stage of a snapshot pipeline to the
+ * next. The producer closes it when done; the consumer closes it to abort,
+ * which makes further pushes fail.
+ */
+template <typename T>
+class SnapshotQueue
+{
+private:
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<T> queue;
+    const size_t nMaxSize;
+    bool fClosed = false;
+
+public:
+    explicit SnapshotQueue(size_t nMaxSizeIn) : nMaxSize(nMaxSizeIn) {}
+
+    //! Returns false if the queue was closed.
+    bool Push(T&& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return fClosed || queue.size() < nMaxSize; });
+        if (fClosed) return false;
+        queue.push_back(std::move(item));
+        cond.notify_all();
+        return true;
+    }
+
+    //! Returns false once the queue is closed and drained.
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return fClosed || !queue.empty(); });
+        if (queue.empty()) return false;
+        item = std::move(queue.front());
+        queue.pop_front();
+        cond.notify_all();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fClosed = true;
+        cond.notify_all();
+    }
+};
+
+} // namespace
+
+bool DumpSnapshot(CCoinsViewCursor* pcursor, const CMessageHeader::MessageStartChars& message_start, const fs::path& path, SnapshotInfo& info, std::string& error)
+{
+    const fs::path temppath = path.string() + ".incomplete";
+    CAutoFile file(fsbridge::fopen(temppath, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        error = strprintf("Unable to open %s for writing", temppath.string());
+        return false;
+    }
+
+    info = SnapshotInfo();
+    info.base_blockhash = pcursor->GetBestBlock();
+
+    // Serialize on this thread; hash and write on another.
+    SnapshotQueue<CDataStream> queue(SNAPSHOT_QUEUE_DEPTH);
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    bool fWriteOk = true;
+    std::thread writer([&] {
+        RenameThread("bitcoin-snapwrite");
+        CDataStream chunk(SER_DISK, CLIENT_VERSION);
+        while (queue.Pop(chunk)) {
+            hasher.write(chunk.data(), chunk.size());
+            if (fwrite(chunk.data(), 1, chunk.size(), file.Get()) != chunk.size()) {
+                fWriteOk = false;
+                queue.Close();
+                return;
+            }
+            info.nBytes += chunk.size();
+        }
+    });
+
+    CDataStream header(SER_DISK, CLIENT_VERSION);
+    header << SnapshotHeader(message_start, info.base_blockhash);
+    bool fOk = queue.Push(std::move(header));
+
+    CDataStream payload(SER_DISK, CLIENT_VERSION);
+    auto push_chunk = [&] {
+        CDataStream chunk(SER_DISK, CLIENT_VERSION);
+        WriteCompactSize(chunk, payload.size());
+        chunk.write(payload.data(), payload.size());
+        payload.clear();
+        return queue.Push(std::move(chunk));
+    };
+
+    // Coins come out of the cursor ordered by txid, so outputs of the same
+    // transaction are grouped to serialize the txid only once.
+    uint256 txid;
+    std::vector<std::pair<uint32_t, Coin>> outputs;
+    auto write_group = [&] {
+        if (outputs.empty()) return;
+        payload << txid;
+        WriteCompactSize(payload, outputs.size());
+        for (const auto& output : outputs) {
+            payload << VARINT(output.first) << output.second;
+        }
+        outputs.clear();
+    };
+
+    while (fOk && pcursor->Valid()) {
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+            error = "Unable to read UTXO set";
+            fOk = false;
+            break;
+        }
+        if (key.hash != txid) {
+            write_group();
+            if (payload.size() >= SNAPSHOT_CHUNK_SIZE) fOk = push_chunk();
+            txid = key.hash;
+        }
+        outputs.emplace_back(key.n, std::move(coin));
+        ++info.coins_count;
+        pcursor->Next();
+    }
+    if (fOk) {
+        write_group();
+        if (!payload.empty()) fOk = push_chunk();
+    }
+    if (fOk) {
+        CDataStream trailer(SER_DISK, CLIENT_VERSION);
+        WriteCompactSize(trailer, 0);
+        trailer << info.coins_count;
+        fOk = queue.Push(std::move(trailer));
+    }
+    queue.Close();
+    writer.join();
+
+    if (fOk && fWriteOk) {
+        info.hash = hasher.GetHash();
+        try {
+            file << info.hash;
+            info.nBytes += sizeof(info.hash);
+        } catch (const std::exception&) {
+            fWriteOk = false;
+        }
+        fWriteOk = fWriteOk && FileCommit(file.Get());
+    }
+    file.fclose();
+    if (!fWriteOk) {
+        error = strprintf("Unable to write %s", temppath.string());
+        fOk = false;
+    }
+    if (fOk && !RenameOver(temppath, path)) {
+        error = strprintf("Unable to rename %s to %s", temppath.string(), path.string());
+        fOk = false;
+    }
+    if (!fOk) {
+        fs::remove(temppath);
+        return false;
+    }
+    return true;
+}
+
+bool ReadSnapshotInfo(const fs::path& path, const CMessageHeader::MessageStartChars& message_start, SnapshotInfo& info, std::string& error)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        error = strprintf("Unable to open %s", path.string());
+        return false;
+    }
+
+    info = SnapshotInfo();
+    SnapshotHeader header;
+    uint256 hash;
+    try {
+        info.nBytes = fs::file_size(path);
+        if (info.nBytes < SNAPSHOT_HEADER_SIZE + 1 + SNAPSHOT_TRAILER_SIZE) {
+            error = "UTXO snapshot file is truncated";
+            return false;
+        }
+        file >> header;
+        if (!header.Check(message_start, error)) return false;
+        if (fseek(file.Get(), info.nBytes - SNAPSHOT_TRAILER_SIZE, SEEK_SET) != 0) {
+            throw std::ios_base::failure("seek failed");
+        }
+        file >> info.coins_count >> hash;
+        if (fseek(file.Get(), 0, SEEK_SET) != 0) throw std::ios_base::failure("seek failed");
+    } catch (const std::exception& e) {
+        error = strprintf("Unable to read %s: %s", path.string(), e.what());
+        return false;
+    }
+    info.base_blockhash = header.base_blockhash;
+
+    // Read on another thread and hash on this one.
+    SnapshotQueue<std::vector<char>> queue(SNAPSHOT_QUEUE_DEPTH);
+    bool fReadOk = true;
+    std::thread reader([&] {
+        RenameThread("bitcoin-snapread");
+        uint64_t nRemaining = info.nBytes - sizeof(hash);
+        while (nRemaining > 0) {
+            std::vector<char> block(std::min<uint64_t>(nRemaining, SNAPSHOT_CHUNK_SIZE));
+            if (fread(block.data(), 1, block.size(), file.Get()) != block.size()) {
+                fReadOk = false;
+                break;
+            }
+            nRemaining -= block.size();
+            if (!queue.Push(std::move(block))) break;
+        }
+        queue.Close();
+    });
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    std::vector<char> block;
+    while (queue.Pop(block)) {
+        hasher.write(block.data(), block.size());
+    }
+    reader.join();
+
+    if (!fReadOk) {
+        error = strprintf("Unable to read %s", path.string());
+        return false;
+    }
+    info.hash = hasher.GetHash();
+    if (info.hash != hash) {
+        error = "UTXO snapshot file is corrupt (hash mismatch)";
+        return false;
+    }
+    return true;
+}
+
+bool LoadSnapshotCoins(const fs::path& path, const SnapshotInfo& info, CCoinsViewDB& db, std::string& error)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        error = strprintf("Unable to open %s", path.string());
+        return false;
+    }
+    if (!db.BeginSnapshotLoad(info.base_blockhash)) {
+        error = "Unable to write to the coins database";
+        return false;
+    }
+
+    // Read and hash on one thread, parse on this one, and write database
+    // batches on a third. The hash is checked again so that a file changed
+    // since ReadSnapshotInfo is caught.
+    SnapshotQueue<CDataStream> chunks(SNAPSHOT_QUEUE_DEPTH);
+    SnapshotQueue<std::vector<std::pair<COutPoint, Coin>>> batches(SNAPSHOT_QUEUE_DEPTH);
+    std::string read_error;
+    uint64_t coins_count_read = 0;
+    uint256 hash;
+    std::thread reader([&] {
+        RenameThread("bitcoin-snapread");
+        try {
+            CHashVerifier<CAutoFile> verifier(&file);
+            SnapshotHeader header;
+            verifier >> header;
+            if (header.base_blockhash != info.base_blockhash) throw std::ios_base::failure("snapshot base changed");
+            while (true) {
+                uint64_t nSize = ReadCompactSize(verifier);
+                if (nSize == 0) break;
+                CDataStream chunk(SER_DISK, CLIENT_VERSION);
+                chunk.resize(nSize);
+                verifier.read(chunk.data(), nSize);
+                if (!chunks.Push(std::move(chunk))) break;
+            }
+            verifier >> coins_count_read;
+            hash = verifier.GetHash();
+        } catch (const std::exception& e) {
+            read_error = e.what();
+        }
+        chunks.Close();
+    });
+
+    bool fWriteOk = true;
+    std::thread writer([&] {
+        RenameThread("bitcoin-snapdb");
+        std::vector<std::pair<COutPoint, Coin>> batch;
+        while (batches.Pop(batch)) {
+            if (!db.WriteSnapshotCoins(batch)) {
+                fWriteOk = false;
+                batches.Close();
+                return;
+            }
+        }
+    });
+
+    uint64_t coins_count = 0;
+    bool fOk = true;
+    std::vector<std::pair<COutPoint, Coin>> batch;
+    batch.reserve(SNAPSHOT_LOAD_BATCH);
+    CDataStream chunk(SER_DISK, CLIENT_VERSION);
+    try {
+        while (fOk && chunks.Pop(chunk)) {
+            while (fOk && !chunk.empty()) {
+                uint256 txid;
+                chunk >> txid;
+                uint64_t nOutputs = ReadCompactSize(chunk);
+                for (uint64_t i = 0; i < nOutputs; ++i) {
+                    uint32_t n;
+                    Coin coin;
+                    chunk >> VARINT(n) >> coin;
+                    if (coin.IsSpent()) throw std::ios_base::failure("spent coin in snapshot");
+                    batch.emplace_back(COutPoint(txid, n), std::move(coin));
+                    ++coins_count;
+                }
+                if (batch.size() >= SNAPSHOT_LOAD_BATCH) {
+                    fOk = batches.Push(std::move(batch));
+                    batch.clear();
+                    batch.reserve(SNAPSHOT_LOAD_BATCH);
+                }
+            }
+        }
+        if (fOk && !batch.empty()) fOk = batches.Push(std::move(batch));
+    } catch (const std::exception& e) {
+        error = strprintf("UTXO snapshot file is corrupt (%s)", e.what());
+        fOk = false;
+    }
+    // Unblock the reader if we stopped early.
+    chunks.Close();
+    batches.Close();
+    reader.join();
+    writer.join();
+
+    if (!fOk || !fWriteOk) {
+        if (!fWriteOk) error = "Unable to write to the coins database";
+        return false;
+    }
+    if (!read_error.empty()) {
+        error = strprintf("Unable to read %s: %s", path.string(), read_error);
+        return false;
+    }
+    if (hash != info.hash || coins_count != info.coins_count || coins_count_read != info.coins_count) {
+        error = "UTXO snapshot file changed while loading";
+        return false;
+    }
+    return true;
+}
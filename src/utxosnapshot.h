@@ -0,0 +1,63 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOSNAPSHOT_H
+#define BITCOIN_UTXOSNAPSHOT_H
+
+#include <fs.h>
+#include <protocol.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <string>
+
+class CCoinsViewCursor;
+class CCoinsViewDB;
+
+/**
+ * UTXO set snapshots, as written by dumptxoutset and read by loadtxoutset.
+ *
+ * File format (all integers little endian):
+ * - header: 5-byte magic "utxo\xff", uint16 version, 4-byte network magic,
+ *   uint256 hash of the block the snapshot is based on
+ * - body: chunks, each a CompactSize length followed by that many bytes; a
+ *   zero length ends the body. A chunk holds groups of one txid, a
+ *   CompactSize count and that many (VARINT output index, Coin) pairs.
+ * - trailer: uint64 number of coins, then the double-SHA256 of every byte of
+ *   the file before it.
+ *
+ * Chunks let serialization, hashing and I/O run in separate threads.
+ */
+
+static const uint16_t SNAPSHOT_VERSION = 1;
+//! Target size of a body chunk
+static const size_t SNAPSHOT_CHUNK_SIZE = 1 << 20;
+
+struct SnapshotInfo
+{
+    uint256 base_blockhash;
+    uint64_t coins_count = 0;
+    //! Hash committing to the whole file (see above)
+    uint256 hash;
+    uint64_t nBytes = 0;
+};
+
+/**
+ * Write the coins under pcursor to a new snapshot file at path. The file is
+ * written as path.incomplete and renamed once complete.
+ */
+bool DumpSnapshot(CCoinsViewCursor* pcursor, const CMessageHeader::MessageStartChars& message_start, const fs::path& path, SnapshotInfo& info, std::string& error);
+
+/** Check the header and the hash of a snapshot file without loading it. */
+bool ReadSnapshotInfo(const fs::path& path, const CMessageHeader::MessageStartChars& message_start, SnapshotInfo& info, std::string& error);
+
+/**
+ * Bulk-write the coins of a snapshot file, previously checked with
+ * ReadSnapshotInfo, into the coins database. The file must not change in
+ * between. The database is left marked as being in transition to the
+ * snapshot base; the caller completes it with a regular flush.
+ */
+bool LoadSnapshotCoins(const fs::path& path, const SnapshotInfo& info, CCoinsViewDB& db, std::string& error);
+
+#endif // BITCOIN_UTXOSNAPSHOT_H
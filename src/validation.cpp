@@ -38,11 +38,14 @@
 #include <util.h>
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
+#include <utxosnapshot.h>
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <deque>
 #include <future>
 #include <sstream>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -151,6 +154,10 @@ private:
      */
     CCriticalSection m_cs_chainstate;
 
+    /** Entries read by LoadBlockIndex, allocated together. Owns them, unlike the other entries in mapBlockIndex. */
+    std::unique_ptr<CBlockIndex[]> m_block_index_arena;
+    size_t m_block_index_arena_size = 0;
+
 public:
     CChain chainActive;
     BlockMap mapBlockIndex;
@@ -183,11 +190,18 @@ public:
 
     bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
     bool RewindBlockIndex(const CChainParams& params);
+    bool LoadSnapshot(const fs::path& path, const SnapshotInfo& info, const CChainParams& chainparams, std::string& error);
     bool LoadGenesisBlock(const CChainParams& chainparams);
 
     void PruneBlockIndexCandidates();
 
     void UnloadBlockIndex();
+    //! Whether pindex belongs to the entries read by LoadBlockIndex, which are not deleted individually.
+    bool IsBlockIndexInArena(const CBlockIndex* pindex) const
+    {
+        return std::less_equal<const CBlockIndex*>()(m_block_index_arena.get(), pindex) &&
+               std::less<const CBlockIndex*>()(pindex, m_block_index_arena.get() + m_block_index_arena_size);
+    }
 
 private:
     bool ActivateBestChainStep(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace);
@@ -222,15 +236,18 @@ CWaitableCriticalSection g_best_block_mutex;
 CConditionVariable g_best_block_cv;
 uint256 g_best_block;
 int nScriptCheckThreads = 0;
+int nBlockReadAhead = 0;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fHavePruned = false;
+bool fLoadedSnapshot = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
+size_t nCoinCacheKeepUsage = 0;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
@@ -295,6 +312,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 std::unique_ptr<CCoinsViewDB> pcoinsdbview;
+std::unique_ptr<CCoinsViewBackgroundFlush> pcoinsflushview;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
 std::unique_ptr<CBlockTreeDB> pblocktree;
 
@@ -310,6 +328,7 @@ static bool FlushStateToDisk(const CChainParams& chainParams, CValidationState &
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight);
 static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
+static bool CheckInputsForMempool(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, unsigned int flags, PrecomputedTransactionData& txdata);
 static FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 
 bool CheckFinalTx(const CTransaction &tx, int flags)
@@ -535,7 +554,7 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
 
     assert(!tx.IsCoinBase());
     for (const CTxIn& txin : tx.vin) {
-        const Coin& coin = view.AccessCoin(txin.prevout);
+        const Coin coin = view.AccessCoin(txin.prevout);
 
         // At this point we haven't actually checked if the coins are all
         // available (or shouldn't assume we have, since CheckInputs does).
@@ -549,7 +568,7 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
             assert(txFrom->vout.size() > txin.prevout.n);
             assert(txFrom->vout[txin.prevout.n] == coin.out);
         } else {
-            const Coin& coinFromDisk = pcoinsTip->AccessCoin(txin.prevout);
+            const Coin coinFromDisk = pcoinsTip->AccessCoin(txin.prevout);
             assert(!coinFromDisk.IsSpent());
             assert(coinFromDisk.out == coin.out);
         }
@@ -558,18 +577,12 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
     return CheckInputs(tx, state, view, true, flags, cacheSigStore, true, txdata);
 }
 
-static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
-                              bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool test_accept)
+/**
+ * Checks AcceptToMemoryPoolWorker makes on a transaction on its own, before
+ * looking at the mempool or the transaction's inputs.
+ */
+static bool CheckTransactionForMempool(const CChainParams& chainparams, const CTransaction& tx, CValidationState& state)
 {
-    const CTransaction& tx = *ptx;
-    const uint256 hash = tx.GetHash();
-    AssertLockHeld(cs_main);
-    LOCK(pool.cs); // mempool "read lock" (held through GetMainSignals().TransactionAddedToMempool())
-    if (pfMissingInputs) {
-        *pfMissingInputs = false;
-    }
-
     if (!CheckTransaction(tx, state))
         return false; // state filled in by CheckTransaction
 
@@ -600,6 +613,74 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
     if (!CheckFinalTx(tx, STANDARD_LOCKTIME_VERIFY_FLAGS))
         return state.DoS(0, false, REJECT_NONSTANDARD, "non-final");
 
+    return true;
+}
+
+/**
+ * Checks AcceptToMemoryPoolWorker makes on a transaction's inputs, all of
+ * which must be in view, before running any of its scripts. Fills in the
+ * fee, the fee including any PrioritiseTransaction delta, and the sigop cost.
+ */
+static bool CheckTxInputsForMempool(const CTxMemPool& pool, const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view,
+                                    bool bypass_limits, CAmount& nFees, CAmount& nModifiedFees, int64_t& nSigOpsCost)
+{
+    if (!Consensus::CheckTxInputs(tx, state, view, GetSpendHeight(view), nFees)) {
+        return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
+    }
+
+    // Check for non-standard pay-to-script-hash in inputs
+    if (fRequireStandard && !AreInputsStandard(tx, view))
+        return state.Invalid(false, REJECT_NONSTANDARD, "bad-txns-nonstandard-inputs");
+
+    // Check for non-standard witness in P2WSH
+    if (tx.HasWitness() && fRequireStandard && !IsWitnessStandard(tx, view))
+        return state.DoS(0, false, REJECT_NONSTANDARD, "bad-witness-nonstandard", true);
+
+    nSigOpsCost = GetTransactionSigOpCost(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
+
+    // nModifiedFees includes any fee deltas from PrioritiseTransaction
+    nModifiedFees = nFees;
+    pool.ApplyDelta(tx.GetHash(), nModifiedFees);
+
+    // Check that the transaction doesn't have an excessive number of
+    // sigops, making it impossible to mine. Since the coinbase transaction
+    // itself can contain sigops MAX_STANDARD_TX_SIGOPS is less than
+    // MAX_BLOCK_SIGOPS; we still consider this an invalid rather than
+    // merely non-standard transaction.
+    if (nSigOpsCost > MAX_STANDARD_TX_SIGOPS_COST)
+        return state.DoS(0, false, REJECT_NONSTANDARD, "bad-txns-too-many-sigops", false,
+            strprintf("%d", nSigOpsCost));
+
+    // The same size as CTxMemPoolEntry::GetTxSize()
+    int64_t nSize = GetVirtualTransactionSize(tx, nSigOpsCost);
+    CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+    if (!bypass_limits && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nModifiedFees, mempoolRejectFee));
+    }
+
+    // No transactions are allowed below minRelayTxFee except from disconnected blocks
+    if (!bypass_limits && nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "min relay fee not met", false, strprintf("%d < %d", nModifiedFees, ::minRelayTxFee.GetFee(nSize)));
+    }
+
+    return true;
+}
+
+static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
+                              bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
+                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool test_accept)
+{
+    const CTransaction& tx = *ptx;
+    const uint256 hash = tx.GetHash();
+    AssertLockHeld(cs_main);
+    LOCK(pool.cs); // mempool "read lock" (held through GetMainSignals().TransactionAddedToMempool())
+    if (pfMissingInputs) {
+        *pfMissingInputs = false;
+    }
+
+    if (!CheckTransactionForMempool(chainparams, tx, state))
+        return false; // state filled in by CheckTransactionForMempool
+
     // is it already in the memory pool?
     if (pool.exists(hash)) {
         return state.Invalid(false, REJECT_DUPLICATE, "txn-already-in-mempool");
@@ -650,7 +731,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
 
     {
         CCoinsView dummy;
-        CCoinsViewCache view(&dummy);
+        CCoinsViewCache view(&dummy, false);
 
         LockPoints lp;
         CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
@@ -692,29 +773,16 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             return state.DoS(0, false, REJECT_NONSTANDARD, "non-BIP68-final");
 
         CAmount nFees = 0;
-        if (!Consensus::CheckTxInputs(tx, state, view, GetSpendHeight(view), nFees)) {
-            return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
-        }
-
-        // Check for non-standard pay-to-script-hash in inputs
-        if (fRequireStandard && !AreInputsStandard(tx, view))
-            return state.Invalid(false, REJECT_NONSTANDARD, "bad-txns-nonstandard-inputs");
-
-        // Check for non-standard witness in P2WSH
-        if (tx.HasWitness() && fRequireStandard && !IsWitnessStandard(tx, view))
-            return state.DoS(0, false, REJECT_NONSTANDARD, "bad-witness-nonstandard", true);
-
-        int64_t nSigOpsCost = GetTransactionSigOpCost(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
-
-        // nModifiedFees includes any fee deltas from PrioritiseTransaction
-        CAmount nModifiedFees = nFees;
-        pool.ApplyDelta(hash, nModifiedFees);
+        CAmount nModifiedFees = 0;
+        int64_t nSigOpsCost = 0;
+        if (!CheckTxInputsForMempool(pool, tx, state, view, bypass_limits, nFees, nModifiedFees, nSigOpsCost))
+            return false; // state filled in by CheckTxInputsForMempool
 
         // Keep track of transactions that spend a coinbase, which we re-scan
         // during reorgs to ensure COINBASE_MATURITY is still met.
         bool fSpendsCoinbase = false;
         for (const CTxIn &txin : tx.vin) {
-            const Coin &coin = view.AccessCoin(txin.prevout);
+            const Coin coin = view.AccessCoin(txin.prevout);
             if (coin.IsCoinBase()) {
                 fSpendsCoinbase = true;
                 break;
@@ -725,25 +793,6 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                               fSpendsCoinbase, nSigOpsCost, lp);
         unsigned int nSize = entry.GetTxSize();
 
-        // Check that the transaction doesn't have an excessive number of
-        // sigops, making it impossible to mine. Since the coinbase transaction
-        // itself can contain sigops MAX_STANDARD_TX_SIGOPS is less than
-        // MAX_BLOCK_SIGOPS; we still consider this an invalid rather than
-        // merely non-standard transaction.
-        if (nSigOpsCost > MAX_STANDARD_TX_SIGOPS_COST)
-            return state.DoS(0, false, REJECT_NONSTANDARD, "bad-txns-too-many-sigops", false,
-                strprintf("%d", nSigOpsCost));
-
-        CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
-        if (!bypass_limits && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
-            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nModifiedFees, mempoolRejectFee));
-        }
-
-        // No transactions are allowed below minRelayTxFee except from disconnected blocks
-        if (!bypass_limits && nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
-            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "min relay fee not met", false, strprintf("%d < %d", nModifiedFees, ::minRelayTxFee.GetFee(nSize)));
-        }
-
         if (nAbsurdFee && nFees > nAbsurdFee)
             return state.Invalid(false,
                 REJECT_HIGHFEE, "absurdly-high-fee",
@@ -911,7 +960,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         PrecomputedTransactionData txdata(tx);
-        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
+        if (!CheckInputsForMempool(tx, state, view, scriptVerifyFlags, txdata)) {
             // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
             // need to turn both off, and compare against just turning off CLEANSTACK
             // to see if the failure is specifically due to witness validation.
@@ -1045,7 +1094,7 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
         }
 
         if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
-            const Coin& coin = AccessByTxid(*pcoinsTip, hash);
+            const Coin coin = AccessByTxid(*pcoinsTip, hash);
             if (!coin.IsSpent()) pindexSlow = chainActive[coin.nHeight];
         }
     }
@@ -1435,7 +1484,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
 
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
-                const Coin& coin = inputs.AccessCoin(prevout);
+                const Coin coin = inputs.AccessCoin(prevout);
                 assert(!coin.IsSpent());
 
                 // We very carefully only pass in things to CScriptCheck which
@@ -1581,7 +1630,7 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
         // Missing undo metadata (height and coinbase). Older versions included this
         // information only in undo records for the last spend of a transactions'
         // outputs. This implies that it must be present for some other output of the same tx.
-        const Coin& alternate = AccessByTxid(view, out.hash);
+        const Coin alternate = AccessByTxid(view, out.hash);
         if (!alternate.IsSpent()) {
             undo.nHeight = alternate.nHeight;
             undo.fCoinBase = alternate.fCoinBase;
@@ -1713,6 +1762,149 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * CheckInputs for a transaction entering the mempool. The script checks of a
+ * transaction with several inputs are spread over the script check threads,
+ * and all of them have finished by the time this returns, so the caller still
+ * sees the outcome before it looks at conflicts or touches the mempool.
+ *
+ * The queue only reports that some check failed. In that case the inputs are
+ * checked again serially, which fills in state with the error of the first
+ * failing input, as a serial check would have.
+ */
+static bool CheckInputsForMempool(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, unsigned int flags, PrecomputedTransactionData& txdata)
+{
+    AssertLockHeld(cs_main);
+    if (!nScriptCheckThreads || tx.vin.size() < MEMPOOL_PARALLEL_CHECK_MIN_INPUTS) {
+        return CheckInputs(tx, state, inputs, true, flags, true, false, txdata);
+    }
+
+    std::vector<CScriptCheck> vChecks;
+    if (!CheckInputs(tx, state, inputs, true, flags, true, false, txdata, &vChecks)) {
+        return false;
+    }
+    if (vChecks.empty()) {
+        return true; // script execution cache hit
+    }
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    if (control.Wait()) {
+        return true;
+    }
+
+    if (CheckInputs(tx, state, inputs, true, flags, true, false, txdata)) {
+        return error("%s: parallel script checks of %s failed, but serial ones passed", __func__, tx.GetHash().ToString());
+    }
+    return false;
+}
+
+void PreverifyMempoolScripts(const CTxMemPool& pool, const std::vector<CTransactionRef>& txs)
+{
+    AssertLockHeld(cs_main);
+    // Without script check threads this would only check everything twice.
+    if (!nScriptCheckThreads) return;
+
+    unsigned int flags = STANDARD_SCRIPT_VERIFY_FLAGS;
+    if (!Params().RequireStandard()) {
+        flags = gArgs.GetArg("-promiscuousmempoolflags", flags);
+    }
+
+    LOCK(pool.cs);
+    CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
+    CCoinsViewCache view(&viewMemPool, false);
+    // The script checks point into these until the queue is done.
+    std::vector<std::unique_ptr<PrecomputedTransactionData>> txdata;
+    txdata.reserve(std::min<size_t>(txs.size(), MAX_MEMPOOL_BATCH_SIZE));
+
+    // Workers start on the first transaction's checks while the later ones
+    // are still being collected. Once a check fails the queue skips the rest,
+    // which only costs the remaining transactions their head start.
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    for (const CTransactionRef& tx : txs) {
+        if (txdata.size() >= MAX_MEMPOOL_BATCH_SIZE) break;
+
+        // Only spend script checks on transactions that get past the checks
+        // AcceptToMemoryPoolWorker makes before its own script checks. Their
+        // reject reasons are reported when it runs on the transaction.
+        CValidationState state;
+        if (!CheckTransactionForMempool(Params(), *tx, state) || pool.exists(tx->GetHash())) continue;
+        bool fHaveInputs = true;
+        for (const CTxIn& txin : tx->vin) {
+            if (!view.HaveCoin(txin.prevout)) {
+                fHaveInputs = false;
+                break;
+            }
+        }
+        if (!fHaveInputs) continue;
+        CAmount nFees = 0;
+        CAmount nModifiedFees = 0;
+        int64_t nSigOpsCost = 0;
+        if (!CheckTxInputsForMempool(pool, *tx, state, view, false, nFees, nModifiedFees, nSigOpsCost)) continue;
+
+        txdata.push_back(MakeUnique<PrecomputedTransactionData>(*tx));
+        std::vector<CScriptCheck> vChecks;
+        CheckInputs(*tx, state, view, true, flags, true, false, *txdata.back(), &vChecks);
+        control.Add(vChecks);
+        // Let later transactions of the batch find this one's outputs, and
+        // not find the coins it spends, so that of two transactions of the
+        // batch spending the same coin only the first is checked.
+        for (const CTxIn& txin : tx->vin) {
+            view.SpendCoin(txin.prevout);
+        }
+        AddCoins(view, *tx, MEMPOOL_HEIGHT, true);
+    }
+    control.Wait();
+}
+
+/**
+ * Looks up a run of block inputs in the coins database ahead of ConnectBlock,
+ * see PrefetchBlockInputs. Outpoints that are not found, or whose lookup
+ * failed, are left as spent coins; ConnectBlock then finds (or fails to find)
+ * them the normal way.
+ */
+class CCoinsPrefetchCheck
+{
+private:
+    const CCoinsView* view;
+    std::pair<COutPoint, Coin>* begin;
+    std::pair<COutPoint, Coin>* end;
+    std::atomic<int64_t>* lookup_time;
+
+public:
+    CCoinsPrefetchCheck() : view(nullptr), begin(nullptr), end(nullptr), lookup_time(nullptr) {}
+    CCoinsPrefetchCheck(const CCoinsView* viewIn, std::pair<COutPoint, Coin>* beginIn, std::pair<COutPoint, Coin>* endIn, std::atomic<int64_t>* lookup_timeIn) :
+        view(viewIn), begin(beginIn), end(endIn), lookup_time(lookup_timeIn) {}
+
+    bool operator()()
+    {
+        int64_t nTimeStart = GetTimeMicros();
+        for (auto it = begin; it != end; ++it) {
+            try {
+                if (!view->GetCoin(it->first, it->second)) it->second.Clear();
+            } catch (const std::runtime_error&) {
+                it->second.Clear();
+            }
+        }
+        *lookup_time += GetTimeMicros() - nTimeStart;
+        return true;
+    }
+
+    void swap(CCoinsPrefetchCheck& check)
+    {
+        std::swap(view, check.view);
+        std::swap(begin, check.begin);
+        std::swap(end, check.end);
+        std::swap(lookup_time, check.lookup_time);
+    }
+};
+
+static CCheckQueue<CCoinsPrefetchCheck> prefetchqueue(1);
+
+void ThreadCoinsPrefetch() {
+    RenameThread("bitcoin-prefetch");
+    prefetchqueue.Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2140,6 +2332,8 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             }
             if (!setFilesToPrune.empty()) {
                 fFlushForPrune = true;
+                // The coins database must not fall behind the pruned blocks,
+                // so the flush this comes with is completed synchronously.
                 if (!fHavePruned) {
                     pblocktree->WriteFlag("prunedblockfiles", true);
                     fHavePruned = true;
@@ -2182,7 +2376,7 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                     vFiles.push_back(std::make_pair(*it, &vinfoBlockFile[*it]));
                     setDirtyFileInfo.erase(it++);
                 }
-                std::vector<const CBlockIndex*> vBlocks;
+                std::vector<CBlockIndex*> vBlocks;
                 vBlocks.reserve(setDirtyBlockIndex.size());
                 for (std::set<CBlockIndex*>::iterator it = setDirtyBlockIndex.begin(); it != setDirtyBlockIndex.end(); ) {
                     vBlocks.push_back(*it);
@@ -2193,8 +2387,11 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                 }
             }
             // Finally remove any pruned files
-            if (fFlushForPrune)
+            if (fFlushForPrune) {
+                if (!pcoinsflushview->Wait())
+                    return AbortNode(state, "Failed to write to coin database");
                 UnlinkPrunedFiles(setFilesToPrune);
+            }
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2206,12 +2403,19 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
-            // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // Flush the chainstate (which may refer to block index entries),
+            // keeping the hot part of the cache unless shutting down or
+            // handing the database to a caller.
+            if (!pcoinsTip->Flush(mode == FlushStateMode::ALWAYS ? 0 : nCoinCacheKeepUsage))
                 return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
             full_flush_completed = true;
         }
+        // Callers of an explicit flush read the database directly, so wait
+        // for the background write; otherwise only reap a finished one.
+        const bool fWait = mode == FlushStateMode::ALWAYS || fFlushForPrune;
+        if (!(fWait ? pcoinsflushview->Wait() : pcoinsflushview->Poll()))
+            return AbortNode(state, "Failed to write to coin database");
     }
     if (full_flush_completed) {
         // Update best block in wallet (so we can detect restored wallets).
@@ -2363,6 +2567,8 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
+static int64_t nTimePrefetchSaved = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2433,6 +2639,250 @@ public:
     }
 };
 
+/**
+ * Pipeline that reads, deserializes and checks the next blocks along the best
+ * chain on helper threads, while the block before them is being connected.
+ *
+ * ActivateBestChainStep announces the blocks it is about to connect with
+ * Request(); helper threads pick them up in order, and also warm the coins
+ * database with their inputs. ConnectTip collects a block with Take(), which
+ * only blocks if a helper is working on it right now; blocks a helper did not
+ * get to yet are read by ConnectTip itself. Connecting stays strictly in
+ * order on the validation thread, the helpers never touch chain state.
+ */
+class CBlockReadAhead
+{
+public:
+    //! How ConnectTip obtained its block, for -debug=bench.
+    enum class Result { HIT, STALLED, NOT_STARTED, NOT_QUEUED };
+
+private:
+    struct Entry {
+        const CBlockIndex* pindex;
+        uint256 hash;
+        CDiskBlockPos pos;
+        std::shared_ptr<CBlock> block; //!< Set once read; nullptr if reading failed
+        bool started{false};
+        bool done{false};
+    };
+
+    boost::mutex mutex;
+    boost::condition_variable condHelper;
+    boost::condition_variable condDone;
+    //! Blocks requested, in connection order
+    std::deque<std::shared_ptr<Entry>> window;
+    const CCoinsView* coinsdb{nullptr};
+    const Consensus::Params* consensus{nullptr};
+    int nHelpers{0};
+
+    void Process(Entry& entry, const CCoinsView* db, const Consensus::Params& params)
+    {
+        std::shared_ptr<CBlock> block = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*block, entry.pos, params) || block->GetHash() != entry.hash) {
+            block.reset();
+        } else {
+            // Leaves block->fChecked set on success, so ConnectBlock skips
+            // it; on failure ConnectBlock repeats it and reports the error.
+            CValidationState state;
+            CheckBlock(*block, state, params);
+            if (db) WarmInputs(*block, *db);
+        }
+        boost::unique_lock<boost::mutex> lock(mutex);
+        entry.block = std::move(block);
+        entry.done = true;
+        condDone.notify_all();
+    }
+
+    //! Look up the block's inputs so the database pages are cached by the time
+    //! the block is connected; results are discarded, as they may be stale.
+    static void WarmInputs(const CBlock& block, const CCoinsView& db)
+    {
+        std::vector<uint256> created;
+        for (const auto& tx : block.vtx) created.push_back(tx->GetHash());
+        std::sort(created.begin(), created.end());
+        Coin coin;
+        for (const auto& tx : block.vtx) {
+            if (tx->IsCoinBase()) continue;
+            for (const CTxIn& txin : tx->vin) {
+                if (std::binary_search(created.begin(), created.end(), txin.prevout.hash)) continue;
+                try {
+                    db.GetCoin(txin.prevout, coin);
+                } catch (const std::runtime_error&) {
+                    return;
+                }
+            }
+        }
+    }
+
+public:
+    void Thread()
+    {
+        // Keep nHelpers accurate when the thread is interrupted, so that no
+        // blocks are requested from helpers that are gone.
+        struct HelperCount {
+            CBlockReadAhead& parent;
+            explicit HelperCount(CBlockReadAhead& p) : parent(p) { boost::unique_lock<boost::mutex> lock(parent.mutex); parent.nHelpers++; }
+            ~HelperCount() { boost::unique_lock<boost::mutex> lock(parent.mutex); parent.nHelpers--; if (parent.nHelpers == 0) parent.window.clear(); }
+        } count(*this);
+        while (true) {
+            std::shared_ptr<Entry> entry;
+            const CCoinsView* db;
+            const Consensus::Params* params;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (true) {
+                    auto it = std::find_if(window.begin(), window.end(), [](const std::shared_ptr<Entry>& e) { return !e->started; });
+                    if (it != window.end()) {
+                        entry = *it;
+                        break;
+                    }
+                    condHelper.wait(lock);
+                }
+                entry->started = true;
+                db = coinsdb;
+                params = consensus;
+            }
+            Process(*entry, db, *params);
+        }
+    }
+
+    /**
+     * Replace the set of blocks to read ahead with the given ones (in the
+     * order they will be connected). Blocks already being read are kept.
+     */
+    void Request(const std::vector<const CBlockIndex*>& vpindex, const CCoinsView* db, const Consensus::Params& params)
+    {
+        AssertLockHeld(cs_main);
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (nHelpers == 0) return;
+        coinsdb = db;
+        consensus = &params;
+        std::deque<std::shared_ptr<Entry>> newWindow;
+        for (const CBlockIndex* pindex : vpindex) {
+            auto it = std::find_if(window.begin(), window.end(), [pindex](const std::shared_ptr<Entry>& e) { return e->pindex == pindex; });
+            if (it != window.end()) {
+                newWindow.push_back(*it);
+            } else {
+                std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+                entry->pindex = pindex;
+                entry->hash = pindex->GetBlockHash();
+                entry->pos = pindex->GetBlockPos();
+                newWindow.push_back(std::move(entry));
+            }
+        }
+        window.swap(newWindow);
+        condHelper.notify_all();
+    }
+
+    /**
+     * Return the block for pindex if it was read ahead, waiting for a helper
+     * that is reading it. Returns nullptr if the caller has to read it.
+     */
+    std::shared_ptr<const CBlock> Take(const CBlockIndex* pindex, Result& result, size_t& depth)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        auto it = std::find_if(window.begin(), window.end(), [pindex](const std::shared_ptr<Entry>& e) { return e->pindex == pindex; });
+        if (it == window.end()) {
+            result = Result::NOT_QUEUED;
+            depth = 0;
+            return nullptr;
+        }
+        std::shared_ptr<Entry> entry = *it;
+        window.erase(it);
+        depth = std::count_if(window.begin(), window.end(), [](const std::shared_ptr<Entry>& e) { return e->done; });
+        if (!entry->started) {
+            result = Result::NOT_STARTED;
+            return nullptr;
+        }
+        result = entry->done ? Result::HIT : Result::STALLED;
+        while (!entry->done) condDone.wait(lock);
+        return entry->block;
+    }
+
+    //! Forget all requested blocks (on a failed or interrupted connect).
+    void Clear()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        window.clear();
+    }
+};
+
+static CBlockReadAhead g_blockreadahead;
+
+void ThreadBlockReadAhead() {
+    RenameThread("bitcoin-readahd");
+    g_blockreadahead.Thread();
+}
+
+/** Number of outpoints looked up per prefetch job; small enough to spread a
+ *  block over all workers, large enough to read neighbouring keys together. */
+static const size_t PREFETCH_BATCH_SIZE = 64;
+
+/**
+ * Warm pcoinsTip with all inputs of a block that is about to be connected, so
+ * that ConnectBlock does not do its database lookups one by one on the
+ * critical path. Outputs created in the block itself and outpoints that are
+ * already cached are skipped; the rest are sorted (so that the database reads
+ * are roughly in key order) and looked up in parallel by the prefetch
+ * threads. Does nothing without worker threads.
+ */
+static void PrefetchBlockInputs(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    if (!nScriptCheckThreads || !pcoinsflushview) return;
+    int64_t nTimeStart = GetTimeMicros();
+
+    std::vector<uint256> created;
+    created.reserve(block.vtx.size());
+    for (const auto& tx : block.vtx) created.push_back(tx->GetHash());
+    std::sort(created.begin(), created.end());
+
+    std::vector<COutPoint> prevouts;
+    size_t nInputs = 0, nInBlock = 0;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase()) continue;
+        for (const CTxIn& txin : tx->vin) {
+            ++nInputs;
+            if (std::binary_search(created.begin(), created.end(), txin.prevout.hash)) {
+                ++nInBlock;
+                continue;
+            }
+            prevouts.push_back(txin.prevout);
+        }
+    }
+    std::sort(prevouts.begin(), prevouts.end());
+    prevouts.erase(std::unique(prevouts.begin(), prevouts.end()), prevouts.end());
+
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    coins.reserve(prevouts.size());
+    for (const COutPoint& prevout : prevouts) {
+        if (!pcoinsTip->HaveEntryInCache(prevout)) coins.emplace_back(prevout, Coin());
+    }
+    const size_t nCached = prevouts.size() - coins.size();
+
+    std::atomic<int64_t> nLookupTime{0};
+    int64_t nTime1 = GetTimeMicros();
+    if (!coins.empty()) {
+        CCheckQueueControl<CCoinsPrefetchCheck> control(&prefetchqueue);
+        std::vector<CCoinsPrefetchCheck> vChecks;
+        for (size_t i = 0; i < coins.size(); i += PREFETCH_BATCH_SIZE) {
+            vChecks.emplace_back(pcoinsflushview.get(), &coins[i], &coins[0] + std::min(i + PREFETCH_BATCH_SIZE, coins.size()), &nLookupTime);
+        }
+        control.Add(vChecks);
+        control.Wait();
+    }
+    int64_t nTime2 = GetTimeMicros();
+    const size_t nFetched = pcoinsTip->AddFetchedCoins(coins);
+
+    const int64_t nSaved = std::max<int64_t>(0, nLookupTime - (nTime2 - nTime1));
+    int64_t nTime3 = GetTimeMicros(); nTimePrefetch += nTime3 - nTimeStart;
+    nTimePrefetchSaved += nSaved;
+    const size_t nOutside = nInputs - nInBlock;
+    LogPrint(BCLog::BENCH, "  - Prefetch inputs: %u cached, %u fetched, %u in block, %.1f%% hit rate: %.2fms (%.2fms saved) [%.2fs (%.2fs saved)]\n",
+        (unsigned)nCached, (unsigned)nFetched, (unsigned)nInBlock, nOutside ? 100.0 * (nCached + nFetched) / nOutside : 100.0,
+        (nTime3 - nTimeStart) * MILLI, nSaved * MILLI, nTimePrefetch * MICRO, nTimePrefetchSaved * MICRO);
+}
+
 /**
  * Connect a new block to chainActive. pblock is either nullptr or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
@@ -2445,19 +2895,31 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
     std::shared_ptr<const CBlock> pthisBlock;
+    CBlockReadAhead::Result readahead = CBlockReadAhead::Result::NOT_QUEUED;
+    size_t nReadAheadDepth = 0;
     if (!pblock) {
+        pthisBlock = g_blockreadahead.Take(pindexNew, readahead, nReadAheadDepth);
+    } else {
+        pthisBlock = pblock;
+    }
+    if (!pthisBlock) {
         std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
         if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
             return AbortNode(state, "Failed to read block");
         pthisBlock = pblockNew;
-    } else {
-        pthisBlock = pblock;
     }
     const CBlock& blockConnecting = *pthisBlock;
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
-    LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    if (pblock) {
+        LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    } else {
+        static const char* const READAHEAD_RESULT[] = {"read ahead", "stalled on read-ahead", "read-ahead not started", "not read ahead"};
+        LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms (%s, %u more ready) [%.2fs]\n", (nTime2 - nTime1) * MILLI,
+            READAHEAD_RESULT[static_cast<int>(readahead)], (unsigned)nReadAheadDepth, nTimeReadFromDisk * MICRO);
+    }
+    PrefetchBlockInputs(blockConnecting);
     {
         CCoinsViewCache view(pcoinsTip.get());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
@@ -2605,9 +3067,20 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
         }
         nHeight = nTargetHeight;
 
+        // Have the next blocks read and checked in the background while
+        // connecting the ones before them.
+        if (nBlockReadAhead > 0) {
+            std::vector<const CBlockIndex*> vpindexAhead;
+            for (auto it = vpindexToConnect.rbegin(); it != vpindexToConnect.rend() && (int)vpindexAhead.size() < nBlockReadAhead; ++it) {
+                if (*it != pindexMostWork || !pblock) vpindexAhead.push_back(*it);
+            }
+            g_blockreadahead.Request(vpindexAhead, pcoinsdbview.get(), chainparams.GetConsensus());
+        }
+
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
+                g_blockreadahead.Clear();
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
                     if (!state.CorruptionPossible()) {
@@ -3586,7 +4059,7 @@ bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams,
 {
     AssertLockHeld(cs_main);
     assert(pindexPrev && pindexPrev == chainActive.Tip());
-    CCoinsViewCache viewNew(pcoinsTip.get());
+    CCoinsViewCache viewNew(pcoinsTip.get(), false);
     uint256 block_hash(block.GetHash());
     CBlockIndex indexDummy(block);
     indexDummy.pprev = pindexPrev;
@@ -3830,26 +4303,110 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
     return pindexNew;
 }
 
+/** Run fn(begin, end) on consecutive ranges covering [0, count), one per thread. */
+static void ParallelForRanges(size_t count, int threads, const std::function<void(size_t, size_t)>& fn)
+{
+    threads = std::max(1, std::min<int>(threads, count / 1024 + 1));
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back(fn, count * i / threads, count * (i + 1) / threads);
+    }
+    fn(0, count / threads);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
 bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash){ return this->InsertBlockIndex(hash); }))
+    const int threads = std::max(1, nScriptCheckThreads);
+    int64_t nTimeStart = GetTimeMicros();
+
+    std::vector<std::pair<uint256, CDiskBlockIndex>> entries;
+    if (!blocktree.LoadBlockIndexGuts(consensus_params, entries, threads))
         return false;
 
     boost::this_thread::interruption_point();
+    int64_t nTime1 = GetTimeMicros();
+
+    // Construct the entries in one allocation and index them in bulk.
+    assert(!m_block_index_arena);
+    m_block_index_arena.reset(new CBlockIndex[entries.size()]);
+    m_block_index_arena_size = entries.size();
+    mapBlockIndex.reserve(mapBlockIndex.size() + entries.size());
+    std::vector<CBlockIndex*> vIndex(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        BlockMap::iterator mi = mapBlockIndex.emplace(entries[i].first, &m_block_index_arena[i]).first;
+        vIndex[i] = mi->second;
+        vIndex[i]->phashBlock = &mi->first;
+    }
+    int64_t nTime2 = GetTimeMicros();
+
+    // Fill in the entries and link them to their parents. Each entry's own
+    // proof is kept in nChainWork until the parent's is known.
+    std::mutex cs_shared;
+    std::vector<size_t> vMissingPrev;
+    int nMaxHeight = 0;
+    ParallelForRanges(entries.size(), threads, [&](size_t begin, size_t end) {
+        std::vector<size_t> missing;
+        int max_height = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const CDiskBlockIndex& diskindex = entries[i].second;
+            CBlockIndex* pindexNew = vIndex[i];
+            if (!diskindex.hashPrev.IsNull()) {
+                BlockMap::const_iterator mi = mapBlockIndex.find(diskindex.hashPrev);
+                if (mi != mapBlockIndex.end()) {
+                    pindexNew->pprev = mi->second;
+                } else {
+                    missing.push_back(i);
+                }
+            }
+            pindexNew->nHeight        = diskindex.nHeight;
+            pindexNew->nFile          = diskindex.nFile;
+            pindexNew->nDataPos       = diskindex.nDataPos;
+            pindexNew->nUndoPos       = diskindex.nUndoPos;
+            pindexNew->nVersion       = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime          = diskindex.nTime;
+            pindexNew->nBits          = diskindex.nBits;
+            pindexNew->nNonce         = diskindex.nNonce;
+            pindexNew->nStatus        = diskindex.nStatus;
+            pindexNew->nTx            = diskindex.nTx;
+            pindexNew->nHeaderRecord  = diskindex.nHeaderRecord;
+            pindexNew->nChainWork     = GetBlockProof(*pindexNew);
+            max_height = std::max(max_height, pindexNew->nHeight);
+        }
+        std::lock_guard<std::mutex> lock(cs_shared);
+        vMissingPrev.insert(vMissingPrev.end(), missing.begin(), missing.end());
+        nMaxHeight = std::max(nMaxHeight, max_height);
+    });
+    for (size_t i : vMissingPrev) {
+        // A parent missing from the database gets a blank placeholder entry.
+        vIndex[i]->pprev = InsertBlockIndex(entries[i].second.hashPrev);
+    }
+    entries.clear();
+    entries.shrink_to_fit();
+    int64_t nTime3 = GetTimeMicros();
+
+    // Order by height, counting entries per height instead of sorting.
+    std::vector<size_t> vHeightStart(nMaxHeight + 2, 0);
+    for (const CBlockIndex* pindex : vIndex) {
+        ++vHeightStart[pindex->nHeight + 1];
+    }
+    for (size_t h = 1; h < vHeightStart.size(); ++h) {
+        vHeightStart[h] += vHeightStart[h - 1];
+    }
+    std::vector<CBlockIndex*> vSortedByHeight(vIndex.size());
+    for (CBlockIndex* pindex : vIndex) {
+        vSortedByHeight[vHeightStart[pindex->nHeight]++] = pindex;
+    }
+    vIndex.clear();
+    vIndex.shrink_to_fit();
 
     // Calculate nChainWork
-    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
-    for (const std::pair<uint256, CBlockIndex*>& item : mapBlockIndex)
-    {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
-    }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
+    for (CBlockIndex* pindex : vSortedByHeight)
     {
-        CBlockIndex* pindex = item.second;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        if (pindex->pprev) pindex->nChainWork += pindex->pprev->nChainWork;
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
         // We can link the chain of blocks for which we've received transactions at some point.
         // Pruned nodes may have deleted the block.
@@ -3873,11 +4430,31 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
             setBlockIndexCandidates.insert(pindex);
         if (pindex->nStatus & BLOCK_FAILED_MASK && (!pindexBestInvalid || pindex->nChainWork > pindexBestInvalid->nChainWork))
             pindexBestInvalid = pindex;
-        if (pindex->pprev)
-            pindex->BuildSkip();
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == nullptr || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
+    int64_t nTime4 = GetTimeMicros();
+
+    // Build the skiplist. Entries on the best header chain, normally nearly
+    // all of them, look up their skip target in that chain and can be done
+    // concurrently; the others follow in height order.
+    CChain chainBestHeader;
+    chainBestHeader.SetTip(pindexBestHeader);
+    ParallelForRanges(vSortedByHeight.size(), threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (chainBestHeader.Contains(vSortedByHeight[i]))
+                vSortedByHeight[i]->BuildSkip(chainBestHeader);
+        }
+    });
+    for (CBlockIndex* pindex : vSortedByHeight) {
+        if (pindex->pprev && !chainBestHeader.Contains(pindex))
+            pindex->BuildSkip();
+    }
+    int64_t nTime5 = GetTimeMicros();
+
+    LogPrintf("%s: %u entries: read %.2fms (%d threads), map %.2fms, link %.2fms, chain work %.2fms, skiplist %.2fms\n", __func__,
+        vSortedByHeight.size(), (nTime1 - nTimeStart) * MILLI, threads, (nTime2 - nTime1) * MILLI, (nTime3 - nTime2) * MILLI,
+        (nTime4 - nTime3) * MILLI, (nTime5 - nTime4) * MILLI);
 
     return true;
 }
@@ -3927,6 +4504,11 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     if (fHavePruned)
         LogPrintf("LoadBlockIndexDB(): Block files have previously been pruned\n");
 
+    // Check whether the chainstate was loaded from a UTXO snapshot
+    pblocktree->ReadFlag("loadedsnapshot", fLoadedSnapshot);
+    if (fLoadedSnapshot)
+        LogPrintf("LoadBlockIndexDB(): Chainstate was loaded from a UTXO snapshot\n");
+
     // Check whether we need to continue reindexing
     bool fReindexing = false;
     pblocktree->ReadReindexing(fReindexing);
@@ -3989,7 +4571,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         nCheckDepth = chainActive.Height();
     nCheckLevel = std::max(0, std::min(4, nCheckLevel));
     LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
-    CCoinsViewCache coins(coinsview);
+    CCoinsViewCache coins(coinsview, false);
     CBlockIndex* pindexState = chainActive.Tip();
     CBlockIndex* pindexFailure = nullptr;
     int nGoodTransactions = 0;
@@ -4008,9 +4590,10 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone, false);
         if (pindex->nHeight < chainActive.Height()-nCheckDepth)
             break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-            // If pruning, only go back as far as we have data.
-            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+        if ((fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) || (fLoadedSnapshot && !(pindex->nStatus & BLOCK_HAVE_UNDO))) {
+            // If pruning, only go back as far as we have data. Blocks up to
+            // a snapshot base were never connected here and have no undo data.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (%s)\n", pindex->nHeight, fPruneMode ? "pruning, no data" : "snapshot base");
             break;
         }
         CBlock block;
@@ -4113,13 +4696,13 @@ bool CChainState::ReplayBlocks(const CChainParams& params, CCoinsView* view)
     if (mapBlockIndex.count(hashHeads[0]) == 0) {
         return error("ReplayBlocks(): reorganization to unknown block requested");
     }
-    pindexNew = mapBlockIndex[hashHeads[0]];
+    pindexNew = mapBlockIndex.find(hashHeads[0])->second;
 
     if (!hashHeads[1].IsNull()) { // The old tip is allowed to be 0, indicating it's the first flush.
         if (mapBlockIndex.count(hashHeads[1]) == 0) {
             return error("ReplayBlocks(): reorganization from unknown block requested");
         }
-        pindexOld = mapBlockIndex[hashHeads[1]];
+        pindexOld = mapBlockIndex.find(hashHeads[1])->second;
         pindexFork = LastCommonAncestor(pindexOld, pindexNew);
         assert(pindexFork != nullptr);
     }
@@ -4162,6 +4745,140 @@ bool ReplayBlocks(const CChainParams& params, CCoinsView* view) {
     return g_chainstate.ReplayBlocks(params, view);
 }
 
+bool CChainState::LoadSnapshot(const fs::path& path, const SnapshotInfo& info, const CChainParams& chainparams, std::string& error)
+{
+    LOCK(m_cs_chainstate);
+    LOCK(cs_main);
+
+    CBlockIndex* pindexBase = LookupBlockIndex(info.base_blockhash);
+    if (!pindexBase) {
+        error = strprintf("Unknown snapshot base block %s; the headers must be synced first", info.base_blockhash.ToString());
+        return false;
+    }
+    if (pindexBase->nHeight == 0 || (pindexBase->nStatus & BLOCK_FAILED_MASK)) {
+        error = "Invalid snapshot base block";
+        return false;
+    }
+    if (chainActive.Height() != 0) {
+        error = "A UTXO snapshot can only be loaded into an empty chainstate";
+        return false;
+    }
+    CValidationState state;
+    if (!FlushStateToDisk(chainparams, state, FlushStateMode::ALWAYS)) {
+        error = FormatStateMessage(state);
+        return false;
+    }
+    if (std::unique_ptr<CCoinsViewCursor>(pcoinsdbview->Cursor())->Valid()) {
+        error = "A UTXO snapshot can only be loaded into an empty chainstate";
+        return false;
+    }
+
+    int64_t nStart = GetTimeMillis();
+    LogPrintf("Loading UTXO snapshot of %u coins based at %s (height %d)\n", info.coins_count, info.base_blockhash.ToString(), pindexBase->nHeight);
+    if (!LoadSnapshotCoins(path, info, *pcoinsdbview, error)) {
+        // The coins database is marked as being in transition, and this
+        // process cannot roll it back.
+        AbortNode(strprintf("Failed to load UTXO snapshot: %s", error), _("Loading the UTXO snapshot failed. Restart with -reindex-chainstate."));
+        return false;
+    }
+    pcoinsTip->SetBestBlock(info.base_blockhash);
+
+    // Treat the blocks up to the base as received, fully validated and
+    // pruned, the way a pruning node sees blocks below its tip.
+    CBlockIndex* pindexFirstUnlinked = nullptr;
+    for (CBlockIndex* pindex = pindexBase; pindex->pprev; pindex = pindex->pprev) {
+        if (pindex->nTx == 0) {
+            pindex->nTx = 1;
+            if (IsWitnessEnabled(pindex->pprev, chainparams.GetConsensus())) {
+                pindex->nStatus |= BLOCK_OPT_WITNESS;
+            }
+        }
+        pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        setDirtyBlockIndex.insert(pindex);
+        if (pindex->nChainTx == 0) pindexFirstUnlinked = pindex;
+    }
+    chainActive.SetTip(pindexBase);
+
+    // Link the path and any blocks received before the snapshot that were
+    // waiting for it, as in ReceivedBlockTransactions.
+    std::deque<CBlockIndex*> queue;
+    if (pindexFirstUnlinked) queue.push_back(pindexFirstUnlinked);
+    while (!queue.empty()) {
+        CBlockIndex *pindex = queue.front();
+        queue.pop_front();
+        if (pindex->nChainTx) continue;
+        pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+        {
+            LOCK(cs_nBlockSequenceId);
+            pindex->nSequenceId = nBlockSequenceId++;
+        }
+        if (!setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
+            setBlockIndexCandidates.insert(pindex);
+        }
+        std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
+            queue.push_back(it->second);
+            range.first++;
+            mapBlocksUnlinked.erase(it);
+        }
+        if (pindex != pindexBase && pindexBase->GetAncestor(pindex->nHeight) == pindex) {
+            queue.push_back(pindexBase->GetAncestor(pindex->nHeight + 1));
+        }
+    }
+    PruneBlockIndexCandidates();
+
+    // The block index is written before the coins database completes its
+    // transition to the base, so a crash in between is caught at startup.
+    fLoadedSnapshot = true;
+    pblocktree->WriteFlag("loadedsnapshot", true);
+    if (!FlushStateToDisk(chainparams, state, FlushStateMode::ALWAYS)) {
+        error = FormatStateMessage(state);
+        return false;
+    }
+    LogPrintf("Loaded UTXO snapshot in %dms: hashBestChain=%s height=%d\n", GetTimeMillis() - nStart, pindexBase->GetBlockHash().ToString(), pindexBase->nHeight);
+
+    CheckBlockIndex(chainparams.GetConsensus());
+    return true;
+}
+
+bool LoadSnapshotChainstate(const fs::path& path, const CChainParams& chainparams, SnapshotInfo& info, std::string& error)
+{
+    if (!ReadSnapshotInfo(path, chainparams.MessageStart(), info, error)) return false;
+
+    const MapSnapshotHashes& hashes = chainparams.Snapshots().mapSnapshotHashes;
+    MapSnapshotHashes::const_iterator it = hashes.find(info.base_blockhash);
+    if (it != hashes.end()) {
+        if (it->second != info.hash) {
+            error = strprintf("UTXO snapshot hash %s does not match the expected %s", info.hash.ToString(), it->second.ToString());
+            return false;
+        }
+    } else if (!chainparams.MineBlocksOnDemand()) {
+        error = strprintf("No UTXO snapshot is known for block %s", info.base_blockhash.ToString());
+        return false;
+    }
+
+    if (!g_chainstate.LoadSnapshot(path, info, chainparams, error)) return false;
+
+    const CBlockIndex* pindexBase;
+    bool fInitialDownload;
+    {
+        LOCK(cs_main);
+        pindexBase = LookupBlockIndex(info.base_blockhash);
+        fInitialDownload = IsInitialBlockDownload();
+    }
+    GetMainSignals().UpdatedBlockTip(pindexBase, pindexBase->GetAncestor(0), fInitialDownload);
+    uiInterface.NotifyBlockTip(fInitialDownload, pindexBase);
+
+    // Connect any blocks above the base we already have.
+    CValidationState state;
+    if (!ActivateBestChain(state, chainparams)) {
+        error = FormatStateMessage(state);
+        return false;
+    }
+    return true;
+}
+
 bool CChainState::RewindBlockIndex(const CChainParams& params)
 {
     LOCK(cs_main);
@@ -4273,11 +4990,30 @@ bool RewindBlockIndex(const CChainParams& params) {
 }
 
 void CChainState::UnloadBlockIndex() {
+    m_block_index_arena.reset();
+    m_block_index_arena_size = 0;
     nBlockSequenceId = 1;
     m_failed_blocks.clear();
     setBlockIndexCandidates.clear();
 }
 
+BlockIndexMemoryStats GetBlockIndexMemoryStats()
+{
+    AssertLockHeld(cs_main);
+    BlockIndexMemoryStats stats;
+    stats.entries = mapBlockIndex.size();
+    stats.index_usage = 0;
+    for (const auto& entry : mapBlockIndex) {
+        stats.index_usage += g_chainstate.IsBlockIndexInArena(entry.second) ? sizeof(CBlockIndex) : memusage::MallocUsage(sizeof(CBlockIndex));
+    }
+    stats.map_usage = mapBlockIndex.DynamicMemoryUsage();
+    // A node per entry and about one bucket pointer per entry, at the
+    // default maximum load factor of 1.
+    stats.node_map_usage = memusage::MallocUsage(sizeof(memusage::unordered_node<BlockMap::value_type>)) * stats.entries +
+                           memusage::MallocUsage(sizeof(void*) * stats.entries);
+    return stats;
+}
+
 // May NOT be used after any connections are up as much
 // of the peer-processing logic assumes a consistent
 // block index state
@@ -4299,10 +5035,13 @@ void UnloadBlockIndex()
     }
 
     for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
+        if (!g_chainstate.IsBlockIndexInArena(entry.second)) {
+            delete entry.second;
+        }
     }
     mapBlockIndex.clear();
     fHavePruned = false;
+    fLoadedSnapshot = false;
 
     g_chainstate.UnloadBlockIndex();
 }
@@ -4543,7 +5282,7 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
         if (pindex->nChainTx == 0) assert(pindex->nSequenceId <= 0);  // nSequenceId can't be set positive for blocks that aren't linked (negative is used for preciousblock)
         // VALID_TRANSACTIONS is equivalent to nTx > 0 for all nodes (whether or not pruning has occurred).
         // HAVE_DATA is only equivalent to nTx > 0 (or VALID_TRANSACTIONS) if no pruning has occurred.
-        if (!fHavePruned) {
+        if (!fHavePruned && !fLoadedSnapshot) {
             // If we've never pruned, then HAVE_DATA should be equivalent to nTx > 0
             assert(!(pindex->nStatus & BLOCK_HAVE_DATA) == (pindex->nTx == 0));
             assert(pindexFirstMissing == pindexFirstNeverProcessed);
@@ -4602,7 +5341,7 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
         if (pindexFirstMissing == nullptr) assert(!foundInUnlinked); // We aren't missing data for any parent -- cannot be in mapBlocksUnlinked.
         if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed == nullptr && pindexFirstMissing != nullptr) {
             // We HAVE_DATA for this block, have received data for all parents at some point, but we're currently missing data for some parent.
-            assert(fHavePruned); // We must have pruned.
+            assert(fHavePruned || fLoadedSnapshot); // We must have pruned, or skipped blocks below a snapshot.
             // This block may have entered mapBlocksUnlinked if:
             //  - it has a descendant that at some point had more work than the
             //    tip, and
@@ -4853,7 +5592,8 @@ public:
         // block headers
         BlockMap::iterator it1 = mapBlockIndex.begin();
         for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+            if (!g_chainstate.IsBlockIndexInArena((*it1).second))
+                delete (*it1).second;
         mapBlockIndex.clear();
     }
 } instance_of_cmaincleanup;
@@ -11,6 +11,7 @@
 #endif
 
 #include <amount.h>
+#include <blockmap.h>
 #include <coins.h>
 #include <fs.h>
 #include <protocol.h> // For CMessageHeader::MessageStartChars
@@ -34,6 +35,7 @@
 class CBlockIndex;
 class CBlockTreeDB;
 class CChainParams;
+class CCoinsViewBackgroundFlush;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
@@ -45,6 +47,7 @@ struct ChainTxData;
 
 struct PrecomputedTransactionData;
 struct LockPoints;
+struct SnapshotInfo;
 
 /** Default for -whitelistrelay. */
 static const bool DEFAULT_WHITELISTRELAY = true;
@@ -81,6 +84,16 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Loose transactions with at least this many inputs have their script checks spread over the script-checking threads */
+static const unsigned int MEMPOOL_PARALLEL_CHECK_MIN_INPUTS = 2;
+/** Maximum number of transactions submitted, and script-checked ahead of acceptance, as one batch */
+static const unsigned int MAX_MEMPOOL_BATCH_SIZE = 1000;
+/** -blockreadahead default (number of blocks past the tip read and checked in the background, 0 = off) */
+static const int DEFAULT_BLOCK_READAHEAD = 8;
+/** Maximum number of blocks past the tip that are read ahead (ActivateBestChainStep looks at most 32 blocks ahead) */
+static const int MAX_BLOCK_READAHEAD = 32;
+/** Number of threads reading blocks ahead of the tip */
+static const int BLOCK_READAHEAD_THREADS = 2;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -134,6 +147,8 @@ static const bool DEFAULT_TXINDEX = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -backgroundflush */
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
 /** Default for -mempoolreplacement */
 static const bool DEFAULT_ENABLE_REPLACEMENT = true;
 /** Default for using fee filter */
@@ -150,17 +165,11 @@ static const bool DEFAULT_PEERBLOOMFILTERS = true;
 /** Default for -stopatheight */
 static const int DEFAULT_STOPATHEIGHT = 0;
 
-struct BlockHasher
-{
-    size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
-};
-
 extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
 extern CBlockPolicyEstimator feeEstimator;
 extern CTxMemPool mempool;
 extern std::atomic_bool g_is_mempool_loaded;
-typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern BlockMap& mapBlockIndex;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockWeight;
@@ -171,11 +180,14 @@ extern uint256 g_best_block;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
+extern int nBlockReadAhead;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
 extern size_t nCoinCacheUsage;
+/** Memory of recently used coins that a flush of the coins cache keeps (see -dbcachekeep) */
+extern size_t nCoinCacheKeepUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
 /** Absolute maximum transaction fee (in satoshis) used by wallet and mempool (rejects high fee in sendrawtransaction) */
@@ -199,6 +211,8 @@ static const uint64_t nMinDiskSpace = 52428800;
 /** Pruning-related variables and constants */
 /** True if any block files have ever been pruned. */
 extern bool fHavePruned;
+/** True if the chainstate was loaded from a UTXO snapshot, so blocks below its base have no data. */
+extern bool fLoadedSnapshot;
 /** True if we're running in -prune mode. */
 extern bool fPruneMode;
 /** Number of MiB of block files that we're trying to stay below. */
@@ -272,8 +286,25 @@ bool LoadBlockIndex(const CChainParams& chainparams);
 bool LoadChainTip(const CChainParams& chainparams);
 /** Unload database information */
 void UnloadBlockIndex();
+
+struct BlockIndexMemoryStats
+{
+    size_t entries;         //!< Entries in mapBlockIndex
+    size_t index_usage;     //!< Memory used by the CBlockIndex objects
+    size_t map_usage;       //!< Memory used by mapBlockIndex itself
+    size_t node_map_usage;  //!< Estimate of what a node-based std::unordered_map would use instead
+};
+
+/** Memory used by the block index. Requires cs_main. */
+BlockIndexMemoryStats GetBlockIndexMemoryStats();
+/** Check a UTXO snapshot file against chainparams, load it into the empty chainstate and make its base the tip. */
+bool LoadSnapshotChainstate(const fs::path& path, const CChainParams& chainparams, SnapshotInfo& info, std::string& error);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the block input prefetch thread */
+void ThreadCoinsPrefetch();
+/** Run an instance of the thread reading blocks ahead of the tip */
+void ThreadBlockReadAhead();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -311,6 +342,19 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, const CAmount nAbsurdFee, bool test_accept=false);
 
+/**
+ * Verify the scripts of a batch of loose transactions together on the script
+ * check threads, so that the signature cache already holds the results when
+ * AcceptToMemoryPool then takes the transactions one at a time. The batch must
+ * list parents before children; a transaction may spend from the chain, the
+ * mempool or an earlier transaction of the batch. This only warms the cache:
+ * nothing is added to the mempool and failures are left to AcceptToMemoryPool.
+ * Scripts are only queued for transactions that pass AcceptToMemoryPool's
+ * cheaper policy checks, and for at most MAX_MEMPOOL_BATCH_SIZE of them.
+ * Requires cs_main.
+ */
+void PreverifyMempoolScripts(const CTxMemPool& pool, const std::vector<CTransactionRef>& txs);
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -460,6 +504,9 @@ extern CChain& chainActive;
 /** Global variable that points to the coins database (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 
+/** Global variable that points to the view writing coins cache flushes to the database (protected by cs_main) */
+extern std::unique_ptr<CCoinsViewBackgroundFlush> pcoinsflushview;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewCache> pcoinsTip;
 
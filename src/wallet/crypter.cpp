@@ -10,6 +10,7 @@
 #include <script/standard.h>
 #include <util.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -128,12 +129,36 @@ static bool DecryptSecret(const CKeyingMaterial& vMasterKey, const std::vector<u
     return cKeyCrypter.Decrypt(vchCiphertext, *((CKeyingMaterial*)&vchPlaintext));
 }
 
-static bool DecryptKey(const CKeyingMaterial& vMasterKey, const std::vector<unsigned char>& vchCryptedSecret, const CPubKey& vchPubKey, CKey& key)
+/** Number of keys Unlock decrypts at once. This bounds how many plaintext
+ *  secrets are held together, and how much locked memory they take. */
+static const size_t UNLOCK_DECRYPT_BATCH_SIZE = 1024;
+
+/** Decrypt the secrets of the nCount keys starting at mi, sharing one AES key schedule.
+ *  A secret that fails to decrypt is left empty. */
+static bool DecryptSecrets(const CKeyingMaterial& vMasterKey, CryptedKeyMap::const_iterator mi, size_t nCount, std::vector<CKeyingMaterial>& vSecrets)
 {
-    CKeyingMaterial vchSecret;
-    if(!DecryptSecret(vMasterKey, vchCryptedSecret, vchPubKey.GetHash(), vchSecret))
+    if (vMasterKey.size() != WALLET_CRYPTO_KEY_SIZE)
         return false;
 
+    std::vector<uint256> vIV(nCount);
+    std::vector<AESCBCMessage> vMsgs(nCount);
+    vSecrets.assign(nCount, CKeyingMaterial());
+    for (size_t i = 0; i < nCount; ++i, ++mi) {
+        const std::vector<unsigned char>& vchCryptedSecret = mi->second.second;
+        vIV[i] = mi->second.first.GetHash();
+        vSecrets[i].resize(vchCryptedSecret.size());
+        vMsgs[i] = {vIV[i].begin(), vchCryptedSecret.data(), (int)vchCryptedSecret.size(), vSecrets[i].data(), 0};
+    }
+
+    AES256CBCBatchDecrypt(vMasterKey.data(), true).Decrypt(vMsgs);
+    for (size_t i = 0; i < nCount; ++i) {
+        vSecrets[i].resize(vMsgs[i].written);
+    }
+    return true;
+}
+
+static bool SetKeyFromSecret(const CKeyingMaterial& vchSecret, const CPubKey& vchPubKey, CKey& key)
+{
     if (vchSecret.size() != 32)
         return false;
 
@@ -141,6 +166,15 @@ static bool DecryptKey(const CKeyingMaterial& vMasterKey, const std::vector<unsi
     return key.VerifyPubKey(vchPubKey);
 }
 
+static bool DecryptKey(const CKeyingMaterial& vMasterKey, const std::vector<unsigned char>& vchCryptedSecret, const CPubKey& vchPubKey, CKey& key)
+{
+    CKeyingMaterial vchSecret;
+    if(!DecryptSecret(vMasterKey, vchCryptedSecret, vchPubKey.GetHash(), vchSecret))
+        return false;
+
+    return SetKeyFromSecret(vchSecret, vchPubKey, key);
+}
+
 bool CCryptoKeyStore::SetCrypted()
 {
     LOCK(cs_KeyStore);
@@ -184,20 +218,29 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
 
         bool keyPass = false;
         bool keyFail = false;
+        // Once all keys have been checked, checking the first one suffices
+        size_t nRemaining = fDecryptionThoroughlyChecked ? std::min<size_t>(1, mapCryptedKeys.size()) : mapCryptedKeys.size();
+        std::vector<CKeyingMaterial> vSecrets;
         CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
-        for (; mi != mapCryptedKeys.end(); ++mi)
+        while (nRemaining > 0 && !keyFail)
         {
-            const CPubKey &vchPubKey = (*mi).second.first;
-            const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-            CKey key;
-            if (!DecryptKey(vMasterKeyIn, vchCryptedSecret, vchPubKey, key))
+            const size_t nBatch = std::min(nRemaining, UNLOCK_DECRYPT_BATCH_SIZE);
+            if (!DecryptSecrets(vMasterKeyIn, mi, nBatch, vSecrets))
+                return false;
+            for (size_t i = 0; i < nBatch; ++i, ++mi)
             {
-                keyFail = true;
-                break;
+                const CPubKey &vchPubKey = (*mi).second.first;
+                CKey key;
+                if (!SetKeyFromSecret(vSecrets[i], vchPubKey, key))
+                {
+                    keyFail = true;
+                    break;
+                }
+                keyPass = true;
             }
-            keyPass = true;
-            if (fDecryptionThoroughlyChecked)
-                break;
+            // The secure allocator wipes the secrets as they are freed.
+            vSecrets.clear();
+            nRemaining -= nBatch;
         }
         if (keyPass && keyFail)
         {
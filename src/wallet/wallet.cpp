@@ -176,11 +176,18 @@ CPubKey CWallet::GenerateNewKey(WalletBatch &batch, bool internal)
         SetMinVersion(FEATURE_COMPRPUBKEY);
     }
 
+    return AddGeneratedKey(batch, secret, metadata);
+}
+
+CPubKey CWallet::AddGeneratedKey(WalletBatch &batch, const CKey& secret, const CKeyMetadata& metadata)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
+
     CPubKey pubkey = secret.GetPubKey();
     assert(secret.VerifyPubKey(pubkey));
 
     mapKeyMetadata[pubkey.GetID()] = metadata;
-    UpdateTimeFirstKey(nCreationTime);
+    UpdateTimeFirstKey(metadata.nCreateTime);
 
     if (!AddKeyPubKeyWithDB(batch, secret, pubkey)) {
         throw std::runtime_error(std::string(__func__) + ": AddKey failed");
@@ -188,14 +195,12 @@ CPubKey CWallet::GenerateNewKey(WalletBatch &batch, bool internal)
     return pubkey;
 }
 
-void CWallet::DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey& secret, bool internal)
+void CWallet::DeriveChainKey(CExtKey& chainChildKey, bool internal)
 {
     // for now we use a fixed keypath scheme of m/0'/0'/k
     CKey seed;                     //seed (256bit)
     CExtKey masterKey;             //hd master key
     CExtKey accountKey;            //key at m/0'
-    CExtKey chainChildKey;         //key at m/0'/0' (external) or m/0'/1' (internal)
-    CExtKey childKey;              //key at m/0'/0'/<n>'
 
     // try to get the seed
     if (!GetKey(hdChain.seed_id, seed))
@@ -210,6 +215,14 @@ void CWallet::DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey
     // derive m/0'/0' (external chain) OR m/0'/1' (internal chain)
     assert(internal ? CanSupportFeature(FEATURE_HD_SPLIT) : true);
     accountKey.Derive(chainChildKey, BIP32_HARDENED_KEY_LIMIT+(internal ? 1 : 0));
+}
+
+void CWallet::DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey& secret, bool internal)
+{
+    CExtKey chainChildKey;         //key at m/0'/0' (external) or m/0'/1' (internal)
+    CExtKey childKey;              //key at m/0'/0'/<n>'
+
+    DeriveChainKey(chainChildKey, internal);
 
     // derive child key at next index, skip keys already known to the wallet
     do {
@@ -234,6 +247,42 @@ void CWallet::DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey
         throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
 }
 
+void CWallet::DeriveNewChildKeys(WalletBatch &batch, const CKeyMetadata& metadata, std::vector<std::pair<CKey, CKeyMetadata>>& keys, unsigned int count, bool internal)
+{
+    CExtKey chainChildKey;         //key at m/0'/0' (external) or m/0'/1' (internal)
+    std::vector<CExtKey> childKeys; //keys at m/0'/0'/<n>'..m/0'/0'/<n+k>'
+
+    keys.clear();
+    if (count == 0)
+        return;
+    keys.reserve(count);
+
+    DeriveChainKey(chainChildKey, internal);
+
+    uint32_t& counter = internal ? hdChain.nInternalChainCounter : hdChain.nExternalChainCounter;
+    const std::string keypath = internal ? "m/0'/1'/" : "m/0'/0'/";
+    while (keys.size() < count) {
+        // always derive hardened keys, hashing the whole range at once; the
+        // range may not run past the last hardened index
+        if (counter >= BIP32_HARDENED_KEY_LIMIT)
+            throw std::runtime_error(std::string(__func__) + ": HD chain counter exhausted");
+        unsigned int n = std::min<uint64_t>(count - keys.size(), BIP32_HARDENED_KEY_LIMIT - counter);
+        chainChildKey.DeriveRange(childKeys, counter | BIP32_HARDENED_KEY_LIMIT, n);
+        for (const CExtKey& childKey : childKeys) {
+            const uint32_t index = counter++;
+            // skip invalid children and keys already known to the wallet
+            if (!childKey.key.IsValid() || HaveKey(childKey.key.GetPubKey().GetID()))
+                continue;
+            keys.emplace_back(childKey.key, metadata);
+            keys.back().second.hdKeypath = keypath + std::to_string(index) + "'";
+            keys.back().second.hd_seed_id = hdChain.seed_id;
+        }
+    }
+    // update the chain model in the database
+    if (!batch.WriteHDChain(hdChain))
+        throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
+}
+
 bool CWallet::AddKeyPubKeyWithDB(WalletBatch &batch, const CKey& secret, const CPubKey &pubkey)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
@@ -3397,6 +3446,16 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         }
         bool internal = false;
         WalletBatch batch(*database);
+
+        // HD keys of each chain are derived in one batch, sharing the chain
+        // key derivation and the HMAC-SHA512 passes
+        std::vector<std::pair<CKey, CKeyMetadata>> derivedExternal, derivedInternal;
+        if (IsHDEnabled()) {
+            CKeyMetadata metadata(GetTime());
+            DeriveNewChildKeys(batch, metadata, derivedExternal, missingExternal, false);
+            DeriveNewChildKeys(batch, metadata, derivedInternal, missingInternal, true);
+        }
+
         for (int64_t i = missingInternal + missingExternal; i--;)
         {
             if (i < missingInternal) {
@@ -3406,7 +3465,14 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             assert(m_max_keypool_index < std::numeric_limits<int64_t>::max()); // How in the hell did you use so many keys?
             int64_t index = ++m_max_keypool_index;
 
-            CPubKey pubkey(GenerateNewKey(batch, internal));
+            CPubKey pubkey;
+            if (IsHDEnabled()) {
+                // external keys are taken first, in derivation order
+                const std::pair<CKey, CKeyMetadata>& derived = internal ? derivedInternal[missingInternal - 1 - i] : derivedExternal[missingExternal - 1 - (i - missingInternal)];
+                pubkey = AddGeneratedKey(batch, derived.first, derived.second);
+            } else {
+                pubkey = GenerateNewKey(batch, internal);
+            }
             if (!batch.WritePool(index, CKeyPool(pubkey, internal))) {
                 throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
             }
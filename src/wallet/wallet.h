@@ -713,9 +713,18 @@ private:
     /* the HD chain data model (external chain counters) */
     CHDChain hdChain;
 
+    /* HD derive the chain key m/0'/0' (external) or m/0'/1' (internal) */
+    void DeriveChainKey(CExtKey& chainChildKey, bool internal) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey& secret, bool internal = false) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /* HD derive count new child keys in one batch, each with a copy of metadata carrying its own keypath */
+    void DeriveNewChildKeys(WalletBatch &batch, const CKeyMetadata& metadata, std::vector<std::pair<CKey, CKeyMetadata>>& keys, unsigned int count, bool internal = false) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    /* Store a freshly generated key with its metadata */
+    CPubKey AddGeneratedKey(WalletBatch &batch, const CKey& secret, const CKeyMetadata& metadata) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     std::set<int64_t> setInternalKeyPool;
     std::set<int64_t> setExternalKeyPool;
     std::set<int64_t> set_pre_split_keypool;
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test dumptxoutset and loadtxoutset.
+
+- Mine a chain on node0 and dump its UTXO set.
+- Give node1 the headers only, then load the snapshot and check it is at the
+  same tip with the same UTXO set.
+- Check corrupt snapshots and non-empty chainstates are rejected.
+- Connect the nodes and check node1 syncs the blocks above the snapshot base,
+  also after a restart.
+"""
+import os
+
+from test_framework.messages import CBlockHeader, FromHex, msg_headers
+from test_framework.mininode import P2PInterface, network_thread_start, network_thread_join
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes_bi,
+    sync_blocks,
+)
+
+ADDRESS = "mjTkW3DjgyZck4KbiRusZsqTgaYTxdSz6z"
+
+class UTXOSnapshotTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [[], ["-checkblockindex=1"]]
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        node0.generatetoaddress(150, ADDRESS)
+        tip = node0.getbestblockhash()
+
+        self.log.info("Dump the UTXO set of node0")
+        path = os.path.join(self.options.tmpdir, "utxo.dat")
+        dump = node0.dumptxoutset(path)
+        assert_equal(dump['base_hash'], tip)
+        assert_equal(dump['base_height'], 150)
+        assert_equal(dump['coins'], node0.gettxoutsetinfo()['txouts'])
+        assert_equal(dump['size'], os.path.getsize(path))
+        assert_raises_rpc_error(-8, "already exists", node0.dumptxoutset, path)
+
+        self.log.info("Send node1 the headers only")
+        assert_raises_rpc_error(-1, "headers must be synced first", node1.loadtxoutset, path)
+        headers = msg_headers()
+        for height in range(1, 151):
+            header_hex = node0.getblockheader(node0.getblockhash(height), False)
+            headers.headers.append(FromHex(CBlockHeader(), header_hex))
+        node1.add_p2p_connection(P2PInterface())
+        network_thread_start()
+        node1.p2p.wait_for_verack()
+        node1.p2p.send_and_ping(headers)
+        assert_equal(node1.getblockcount(), 0)
+
+        self.log.info("Reject a corrupt snapshot")
+        bad_path = os.path.join(self.options.tmpdir, "utxo_bad.dat")
+        with open(path, 'rb') as f:
+            data = bytearray(f.read())
+        data[len(data) // 2] ^= 1
+        with open(bad_path, 'wb') as f:
+            f.write(data)
+        assert_raises_rpc_error(-1, "hash mismatch", node1.loadtxoutset, bad_path)
+
+        self.log.info("Load the snapshot into node1")
+        load = node1.loadtxoutset(path)
+        assert_equal(load['hash'], dump['hash'])
+        assert_equal(node1.getbestblockhash(), tip)
+        assert_equal(node1.gettxoutsetinfo(True)['hash_serialized_2'], node0.gettxoutsetinfo(True)['hash_serialized_2'])
+        assert_equal(node1.gettxoutsetinfo()['muhash'], node0.gettxoutsetinfo()['muhash'])
+        assert_raises_rpc_error(-1, "empty chainstate", node1.loadtxoutset, path)
+
+        self.log.info("Sync the blocks above the snapshot base")
+        node1.disconnect_p2ps()
+        network_thread_join()
+        connect_nodes_bi(self.nodes, 0, 1)
+        node0.generatetoaddress(10, ADDRESS)
+        sync_blocks(self.nodes)
+        assert_equal(node1.gettxoutsetinfo(True)['hash_serialized_2'], node0.gettxoutsetinfo(True)['hash_serialized_2'])
+        assert_equal(node1.gettxoutsetinfo()['muhash'], node0.gettxoutsetinfo(True)['muhash'])
+
+        self.log.info("Restart node1")
+        self.restart_node(1)
+        assert_equal(node1.getbestblockhash(), node0.getbestblockhash())
+        connect_nodes_bi(self.nodes, 0, 1)
+        node0.generatetoaddress(1, ADDRESS)
+        sync_blocks(self.nodes)
+
+if __name__ == '__main__':
+    UTXOSnapshotTest().main()
@@ -164,7 +164,7 @@ class BlockchainTest(BitcoinTestFramework):
 
     def _test_gettxoutsetinfo(self):
         node = self.nodes[0]
-        res = node.gettxoutsetinfo()
+        res = node.gettxoutsetinfo(True)
 
         assert_equal(res['total_amount'], Decimal('8725.00000000'))
         assert_equal(res['transactions'], 200)
@@ -178,11 +178,19 @@ class BlockchainTest(BitcoinTestFramework):
         assert_equal(len(res['bestblock']), 64)
         assert_equal(len(res['hash_serialized_2']), 64)
 
+        self.log.info("Test that the rolling statistics match a full scan")
+        rolling = node.gettxoutsetinfo()
+        assert 'transactions' not in rolling
+        assert 'hash_serialized_2' not in rolling
+        for key in ['total_amount', 'height', 'txouts', 'bogosize', 'bestblock', 'muhash']:
+            assert_equal(rolling[key], res[key])
+
         self.log.info("Test that gettxoutsetinfo() works for blockchain with just the genesis block")
         b1hash = node.getblockhash(1)
         node.invalidateblock(b1hash)
 
-        res2 = node.gettxoutsetinfo()
+        res2 = node.gettxoutsetinfo(True)
+        assert_equal(res2['muhash'], node.gettxoutsetinfo()['muhash'])
         assert_equal(res2['transactions'], 0)
         assert_equal(res2['total_amount'], Decimal('0'))
         assert_equal(res2['height'], 0)
@@ -194,7 +202,8 @@ class BlockchainTest(BitcoinTestFramework):
         self.log.info("Test that gettxoutsetinfo() returns the same result after invalidate/reconsider block")
         node.reconsiderblock(b1hash)
 
-        res3 = node.gettxoutsetinfo()
+        res3 = node.gettxoutsetinfo(True)
+        assert_equal(res3['muhash'], res['muhash'])
         assert_equal(res['total_amount'], res3['total_amount'])
         assert_equal(res['transactions'], res3['transactions'])
         assert_equal(res['height'], res3['height'])
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the sendrawtransactions batch RPC.
+
+- Submit a chain of transactions children first and check all of them are
+  accepted, reported in the order given and relayed to the other node.
+- Check per-transaction rejects (a losing replacement, missing inputs,
+  non-standard, already in the chain, an in-batch double spend) leave the
+  rest of the batch alone, and a resent transaction is reported as accepted.
+- Check malformed arguments and oversized batches are rejected.
+"""
+from decimal import Decimal
+
+from test_framework.address import script_to_p2sh
+from test_framework.messages import COIN, COutPoint, CTransaction, CTxIn, CTxOut, ToHex
+from test_framework.script import CScript, OP_EQUAL, OP_HASH160, OP_TRUE, hash160
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    sync_mempools,
+)
+
+REDEEM_SCRIPT = CScript([OP_TRUE])
+P2SH = CScript([OP_HASH160, hash160(REDEEM_SCRIPT), OP_EQUAL])
+FEE = Decimal("0.001")
+
+def spend(prevouts, num_outputs, fee=FEE):
+    """Spend (txid, n, value) prevouts paying to P2SH; returns (tx, value per output)."""
+    tx = CTransaction()
+    for txid, n, _ in prevouts:
+        tx.vin.append(CTxIn(COutPoint(int(txid, 16), n), CScript([REDEEM_SCRIPT])))
+    value = (sum(v for _, _, v in prevouts) - fee) / num_outputs
+    value = value.quantize(Decimal("0.00000001"), rounding="ROUND_DOWN")
+    for _ in range(num_outputs):
+        tx.vout.append(CTxOut(int(value * COIN), P2SH))
+    tx.rehash()
+    return tx, value
+
+class SendRawTransactionsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        # Script check threads, so the batch is also verified on them, and
+        # standardness rules, so the policy checks in front of them apply
+        self.extra_args = [["-par=2", "-acceptnonstdtxn=0"], []]
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generatetoaddress(101, script_to_p2sh(REDEEM_SCRIPT))
+        self.sync_all()
+
+        coinbase = node.getblock(node.getblockhash(1), 2)['tx'][0]
+        n = [o['scriptPubKey']['hex'] for o in coinbase['vout']].index(P2SH.hex())
+        utxo = (coinbase['txid'], n, coinbase['vout'][n]['value'])
+
+        self.log.info("Submit a chain of transactions children first")
+        parent, value = spend([utxo], 2)
+        child, child_value = spend([(parent.hash, 0, value)], 1)
+        grandchild, _ = spend([(child.hash, 0, child_value)], 1)
+        sibling, _ = spend([(parent.hash, 1, value)], 1)
+        batch = [grandchild, sibling, child, parent]
+        result = node.sendrawtransactions([ToHex(tx) for tx in batch])
+        assert_equal([r['txid'] for r in result], [tx.hash for tx in batch])
+        assert all(r['accepted'] and 'reject-reason' not in r for r in result)
+        assert_equal(sorted(node.getrawmempool()), sorted(tx.hash for tx in batch))
+        sync_mempools(self.nodes)
+
+        self.log.info("Rejects are reported per transaction")
+        conflict, _ = spend([(parent.hash, 1, value)], 1, FEE / 2)
+        orphan, _ = spend([("ff" * 32, 0, value)], 1)
+        in_chain_coinbase = node.getblock(node.getblockhash(2), 2)['tx'][0]
+        fresh_utxo = (in_chain_coinbase['txid'], n, in_chain_coinbase['vout'][n]['value'])
+        fresh, fresh_value = spend([fresh_utxo], 1)
+        dust, _ = spend([(fresh.hash, 0, fresh_value)], 1)
+        dust.vout.append(CTxOut(1, P2SH))
+        dust.rehash()
+        result = node.sendrawtransactions([ToHex(conflict), ToHex(parent), ToHex(orphan), ToHex(fresh), ToHex(dust)])
+        assert_equal(result[0], {'txid': conflict.hash, 'accepted': False, 'reject-reason': '66: insufficient fee'})
+        assert_equal(result[1], {'txid': parent.hash, 'accepted': True})
+        assert_equal(result[2], {'txid': orphan.hash, 'accepted': False, 'reject-reason': 'missing-inputs'})
+        assert_equal(result[3], {'txid': fresh.hash, 'accepted': True})
+        assert_equal(result[4], {'txid': dust.hash, 'accepted': False, 'reject-reason': '64: dust'})
+        sync_mempools(self.nodes)
+
+        node.generatetoaddress(1, script_to_p2sh(REDEEM_SCRIPT))
+        self.sync_all()
+        assert_equal(node.getrawmempool(), [])
+        result = node.sendrawtransactions([ToHex(fresh)])
+        assert_equal(result, [{'txid': fresh.hash, 'accepted': False, 'reject-reason': '18: txn-already-known'}])
+        assert_equal(node.sendrawtransactions([]), [])
+
+        self.log.info("Of two transactions spending the same coin only the first is accepted")
+        coinbase = node.getblock(node.getblockhash(3), 2)['tx'][0]
+        utxo = (coinbase['txid'], n, coinbase['vout'][n]['value'])
+        first, _ = spend([utxo], 1)
+        second, _ = spend([utxo], 2)
+        result = node.sendrawtransactions([ToHex(first), ToHex(second)])
+        assert_equal(result[0], {'txid': first.hash, 'accepted': True})
+        assert_equal(result[1], {'txid': second.hash, 'accepted': False, 'reject-reason': '66: insufficient fee'})
+
+        self.log.info("Malformed arguments and oversized batches are rejected")
+        assert_raises_rpc_error(-3, "Expected type array, got string", node.sendrawtransactions, ToHex(parent))
+        assert_raises_rpc_error(-22, "TX decode failed for transaction 1", node.sendrawtransactions, [ToHex(parent), "ff00"])
+        assert_raises_rpc_error(-8, "Array must contain at most 1000 raw transactions", node.sendrawtransactions, [ToHex(parent)] * 1001)
+
+if __name__ == '__main__':
+    SendRawTransactionsTest().main()
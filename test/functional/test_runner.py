@@ -81,8 +81,10 @@ BASE_SCRIPTS = [
     'wallet_abandonconflict.py',
     'feature_csv_activation.py',
     'rpc_rawtransaction.py',
+    'rpc_sendrawtransactions.py',
     'wallet_address_types.py',
     'feature_reindex.py',
+    'feature_utxo_snapshot.py',
     # vv Tests less than 30s vv
     'wallet_keypool_topup.py',
     'interface_zmq.py',